@@ -374,7 +374,7 @@ void Stratum::CoinbaseBuilder::build(int64_t height,
                                      bool segwitEnabled,
                                      const xmstream &witnessCommitment,
                                      CoinbaseTx &legacy,
-                                     CoinbaseTx &witness)
+                                     CoinbaseTx &witness) const
 {
   BTC::Proto::Transaction coinbaseTx;
 
@@ -456,6 +456,10 @@ void Stratum::CoinbaseBuilder::build(int64_t height,
   coinbaseTx.lockTime = 0;
   BTC::Io<typename Proto::Transaction>::serialize(legacy.Data, coinbaseTx, false);
   BTC::Io<typename Proto::Transaction>::serialize(witness.Data, coinbaseTx, true);
+
+  // Data before extra nonce not changes between shares, hash it once
+  SHA256_Init(&legacy.PrefixCtx);
+  SHA256_Update(&legacy.PrefixCtx, legacy.Data.data(), legacy.ExtraNonceOffset);
 }
 
 void Stratum::Notify::build(CWork *source, typename Proto::BlockHeader &header, uint32_t asicBoostData, CoinbaseTx &legacy, const std::vector<uint256> &merklePath, const MiningConfig &cfg, bool resetPreviousWork, xmstream &notifyMessage)
@@ -539,7 +543,10 @@ bool Stratum::Prepare::prepare(BTC::Proto::BlockHeader &header, uint32_t jobVers
   }
 
   // Calculate merkle root and build header
-  header.hashMerkleRoot = calculateMerkleRoot(legacy.Data.data(), legacy.Data.sizeOf(), merklePath);
+  header.hashMerkleRoot = calculateMerkleRoot(legacy.PrefixCtx,
+                                              legacy.Data.data<uint8_t>() + legacy.ExtraNonceOffset,
+                                              legacy.Data.sizeOf() - legacy.ExtraNonceOffset,
+                                              merklePath);
   header.nTime = msg.Submit.Time;
   header.nNonce = msg.Submit.Nonce;
   if (workerCfg.AsicBoostEnabled)
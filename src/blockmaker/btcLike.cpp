@@ -3,8 +3,45 @@
 #include "poolinstances/stratumMsg.h"
 
 namespace BTC {
+// mining.submit fast path, decodes message without DOM construction and memory allocation
+// (message object is reused by connection)
+static inline bool decodeSubmitFast(const CStratumRawMessage &raw, StratumMessage &msg)
+{
+  const CStratumToken *params = raw.Params;
+  if (!(raw.ParamsNum >= 5 &&
+        params[0].isString() &&
+        params[1].isString() &&
+        params[2].isString() &&
+        params[3].isString() && params[3].Size == 8 &&
+        params[4].isString() && params[4].Size == 8))
+    return false;
+  if (!decodeStratumId(raw.Id, msg.IntegerId, msg.StringId))
+    return false;
+
+  msg.Method = ESubmit;
+  params[0].assign(msg.Submit.WorkerName);
+  params[1].assign(msg.Submit.JobId);
+  msg.Submit.MutableExtraNonce.resize(params[2].Size / 2);
+  hex2bin(params[2].Data, params[2].Size, msg.Submit.MutableExtraNonce.data());
+  msg.Submit.Time = readHexBE<uint32_t>(params[3].Data, 4);
+  msg.Submit.Nonce = readHexBE<uint32_t>(params[4].Data, 4);
+  if (raw.ParamsNum >= 6 && params[5].isString())
+    msg.Submit.VersionBits = readHexBE<uint32_t>(params[5].Data, 4);
+  else
+    msg.Submit.VersionBits.reset();
+  return true;
+}
+
 EStratumDecodeStatusTy StratumMessage::decodeStratumMessage(const char *in, size_t size)
 {
+  {
+    CStratumRawMessage raw;
+    if (raw.scan(in, size) && raw.Method.equal("mining.submit") && decodeSubmitFast(raw, *this))
+      return EStratumStatusOk;
+  }
+
+  // Generic path
+  *this = StratumMessage();
   rapidjson::Document document;
   document.Parse(in, size);
   if (document.HasParseError()) {
@@ -0,0 +1,399 @@
+// DigiByte qubit chain primitives for single 64-byte messages (80-byte header for luffa), compiled with -mavx2 -maes
+// Results are identical to sph_* reference implementations, see dgbHash.cpp
+#if defined(__x86_64__)
+#include <immintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+inline __m256i rotl32x8(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+inline uint32_t readBE32(const uint8_t *p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void writeBE32(uint8_t *p, uint32_t x)
+{
+  p[0] = static_cast<uint8_t>(x >> 24);
+  p[1] = static_cast<uint8_t>(x >> 16);
+  p[2] = static_cast<uint8_t>(x >> 8);
+  p[3] = static_cast<uint8_t>(x);
+}
+
+// Luffa-512
+// State is 8 vectors, vector i holds word i of all 5 sub-permutations (lanes 0-4, lanes 5-7 unused)
+// so Q_j permutations run in parallel, message injection mixes lanes with permutes
+
+alignas(32) const uint32_t LuffaRC0[8][8] = {
+  {0x303994a6, 0xb6de10ed, 0xfc20d9d2, 0xb213afa5, 0xf0d2e9e3, 0, 0, 0},
+  {0xc0e65299, 0x70f47aae, 0x34552e25, 0xc84ebe95, 0xac11d7fa, 0, 0, 0},
+  {0x6cc33a12, 0x0707a3d4, 0x7ad8818f, 0x4e608a22, 0x1bcb66f2, 0, 0, 0},
+  {0xdc56983e, 0x1c1e8f51, 0x8438764a, 0x56d858fe, 0x6f2d9bc9, 0, 0, 0},
+  {0x1e00108f, 0x707a3d45, 0xbb6de032, 0x343b138f, 0x78602649, 0, 0, 0},
+  {0x7800423d, 0xaeb28562, 0xedb780c8, 0xd0ec4e3d, 0x8edae952, 0, 0, 0},
+  {0x8f5b7882, 0xbaca1589, 0xd9847356, 0x2ceb4882, 0x3b6ba548, 0, 0, 0},
+  {0x96e1db12, 0x40a46f3e, 0xa2c78434, 0xb3ad2208, 0xedae9520, 0, 0, 0}
+};
+
+alignas(32) const uint32_t LuffaRC4[8][8] = {
+  {0xe0337818, 0x01685f3d, 0xe25e72c1, 0xe028c9bf, 0x5090d577, 0, 0, 0},
+  {0x441ba90d, 0x05a17cf4, 0xe623bb72, 0x44756f91, 0x2d1925ab, 0, 0, 0},
+  {0x7f34d442, 0xbd09caca, 0x5c58a4a4, 0x7e8fce32, 0xb46496ac, 0, 0, 0},
+  {0x9389217f, 0xf4272b28, 0x1e38e2e7, 0x956548be, 0xd1925ab0, 0, 0, 0},
+  {0xe5a8bce6, 0x144ae5cc, 0x78e38b9d, 0xfe191be2, 0x29131ab6, 0, 0, 0},
+  {0x5274baf4, 0xfaa7ae2b, 0x27586719, 0x3cb226e5, 0x0fc053c3, 0, 0, 0},
+  {0x26889ba7, 0x2e48f1c1, 0x36eda57f, 0x5944a28e, 0x3f014f0c, 0, 0, 0},
+  {0x9a226e9d, 0xb923c704, 0x703aace7, 0xa1c4c355, 0xfc053c31, 0, 0, 0}
+};
+
+inline __m256i bxor(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+inline uint32_t bxor(uint32_t a, uint32_t b) { return a ^ b; }
+
+// Multiplication by 2 in GF(2^256) used by message injection, d can point to s
+template<typename T> inline void luffaM2(T d[8], const T s[8])
+{
+  T tmp = s[7];
+  d[7] = s[6];
+  d[6] = s[5];
+  d[5] = s[4];
+  d[4] = bxor(s[3], tmp);
+  d[3] = bxor(s[2], tmp);
+  d[2] = s[1];
+  d[1] = bxor(s[0], tmp);
+  d[0] = tmp;
+}
+
+// XOR of lanes 0-4 broadcasted to all lanes
+inline __m256i luffaSum(__m256i x)
+{
+  __m128i s = _mm_xor_si128(_mm256_castsi256_si128(x), _mm_blend_epi32(_mm_setzero_si128(), _mm256_extracti128_si256(x, 1), 1));
+  s = _mm_xor_si128(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_xor_si128(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm256_broadcastsi128_si256(s);
+}
+
+inline void luffaSubCrumb(__m256i &a0, __m256i &a1, __m256i &a2, __m256i &a3)
+{
+  __m256i ones = _mm256_set1_epi32(-1);
+  __m256i tmp = a0;
+  a0 = _mm256_or_si256(a0, a1);
+  a2 = _mm256_xor_si256(a2, a3);
+  a1 = _mm256_xor_si256(a1, ones);
+  a0 = _mm256_xor_si256(a0, a3);
+  a3 = _mm256_and_si256(a3, tmp);
+  a1 = _mm256_xor_si256(a1, a3);
+  a3 = _mm256_xor_si256(a3, a2);
+  a2 = _mm256_and_si256(a2, a0);
+  a0 = _mm256_xor_si256(a0, ones);
+  a2 = _mm256_xor_si256(a2, a1);
+  a1 = _mm256_or_si256(a1, a3);
+  tmp = _mm256_xor_si256(tmp, a1);
+  a3 = _mm256_xor_si256(a3, a2);
+  a2 = _mm256_and_si256(a2, a1);
+  a1 = _mm256_xor_si256(a1, a0);
+  a0 = tmp;
+}
+
+inline void luffaMixWord(__m256i &u, __m256i &v)
+{
+  v = _mm256_xor_si256(v, u);
+  u = _mm256_xor_si256(rotl32x8(u, 2), v);
+  v = _mm256_xor_si256(rotl32x8(v, 14), u);
+  u = _mm256_xor_si256(rotl32x8(u, 10), v);
+  v = rotl32x8(v, 1);
+}
+
+void luffaPermute(__m256i w[8])
+{
+  // Tweak: words 4-7 of Q_j rotated by j
+  __m256i tweak = _mm256_setr_epi32(0, 1, 2, 3, 4, 0, 0, 0);
+  __m256i tweakInv = _mm256_sub_epi32(_mm256_set1_epi32(32), tweak);
+  for (unsigned i = 4; i < 8; i++)
+    w[i] = _mm256_or_si256(_mm256_sllv_epi32(w[i], tweak), _mm256_srlv_epi32(w[i], tweakInv));
+
+  for (unsigned r = 0; r < 8; r++) {
+    luffaSubCrumb(w[0], w[1], w[2], w[3]);
+    luffaSubCrumb(w[5], w[6], w[7], w[4]);
+    luffaMixWord(w[0], w[4]);
+    luffaMixWord(w[1], w[5]);
+    luffaMixWord(w[2], w[6]);
+    luffaMixWord(w[3], w[7]);
+    w[0] = _mm256_xor_si256(w[0], _mm256_load_si256(reinterpret_cast<const __m256i*>(LuffaRC0[r])));
+    w[4] = _mm256_xor_si256(w[4], _mm256_load_si256(reinterpret_cast<const __m256i*>(LuffaRC4[r])));
+  }
+}
+
+// Message injection MI5 followed by permutation, block is nullptr for blank rounds
+void luffaRound(__m256i w[8], const uint8_t *block)
+{
+  __m256i a[8];
+  for (unsigned i = 0; i < 8; i++)
+    a[i] = luffaSum(w[i]);
+  luffaM2(a, a);
+  for (unsigned i = 0; i < 8; i++)
+    w[i] = _mm256_xor_si256(w[i], a[i]);
+
+  // V_j = M2(V_j) ^ V_(j+1), then V_j = M2(V_j) ^ V_(j-1), indices modulo 5
+  __m256i next = _mm256_setr_epi32(1, 2, 3, 4, 0, 5, 6, 7);
+  __m256i prev = _mm256_setr_epi32(4, 0, 1, 2, 3, 5, 6, 7);
+  __m256i t[8];
+  luffaM2(t, w);
+  for (unsigned i = 0; i < 8; i++)
+    w[i] = _mm256_xor_si256(t[i], _mm256_permutevar8x32_epi32(w[i], next));
+  luffaM2(t, w);
+  for (unsigned i = 0; i < 8; i++)
+    w[i] = _mm256_xor_si256(t[i], _mm256_permutevar8x32_epi32(w[i], prev));
+
+  if (block) {
+    // Q_j receives M2^j(M)
+    alignas(32) uint32_t m[8][8] = {};
+    uint32_t mj[8];
+    for (unsigned i = 0; i < 8; i++)
+      mj[i] = readBE32(block + 4*i);
+    for (unsigned j = 0; j < 5; j++) {
+      for (unsigned i = 0; i < 8; i++)
+        m[i][j] = mj[i];
+      luffaM2(mj, mj);
+    }
+    for (unsigned i = 0; i < 8; i++)
+      w[i] = _mm256_xor_si256(w[i], _mm256_load_si256(reinterpret_cast<const __m256i*>(m[i])));
+  }
+
+  luffaPermute(w);
+}
+
+void luffaOutput(uint8_t *out, const __m256i w[8])
+{
+  for (unsigned i = 0; i < 8; i++)
+    writeBE32(out + 4*i, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(luffaSum(w[i])))));
+}
+
+// CubeHash16/32-512
+// State x[32] is 4 vectors of 8 words, swaps of round function are vector renames and in-lane shuffles
+
+alignas(32) const uint32_t CubehashIV512[32] = {
+  0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E, 0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+  0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537, 0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+  0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532, 0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+  0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576, 0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+};
+
+inline void cubehashRounds(__m256i &x0, __m256i &x1, __m256i &x2, __m256i &x3, unsigned rounds)
+{
+  for (unsigned r = 0; r < rounds; r++) {
+    // x[1jklm] += x[0jklm], x[0jklm] <<<= 7, swap x[00klm] and x[01klm], x[0jklm] ^= x[1jklm]
+    x2 = _mm256_add_epi32(x0, x2);
+    x3 = _mm256_add_epi32(x1, x3);
+    __m256i y0 = rotl32x8(x1, 7);
+    __m256i y1 = rotl32x8(x0, 7);
+    x0 = _mm256_xor_si256(y0, x2);
+    x1 = _mm256_xor_si256(y1, x3);
+    // swap x[1jk0m] and x[1jk1m], x[1jklm] += x[0jklm], x[0jklm] <<<= 11
+    x2 = _mm256_add_epi32(x0, _mm256_shuffle_epi32(x2, 0x4E));
+    x3 = _mm256_add_epi32(x1, _mm256_shuffle_epi32(x3, 0x4E));
+    // swap x[0j0lm] and x[0j1lm], x[0jklm] ^= x[1jklm], swap x[1jkl0] and x[1jkl1]
+    x0 = _mm256_xor_si256(_mm256_permute4x64_epi64(rotl32x8(x0, 11), 0x4E), x2);
+    x1 = _mm256_xor_si256(_mm256_permute4x64_epi64(rotl32x8(x1, 11), 0x4E), x3);
+    x2 = _mm256_shuffle_epi32(x2, 0xB1);
+    x3 = _mm256_shuffle_epi32(x3, 0xB1);
+  }
+}
+
+// AES helpers for ECHO and SHAvite-3, both use standard AES round with little-endian column order
+
+inline __m128i aesXtime(__m128i x)
+{
+  __m128i carry = _mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x), _mm_set1_epi8(0x1B));
+  return _mm_xor_si128(_mm_add_epi8(x, x), carry);
+}
+
+inline void echoMixColumn(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+{
+  __m128i ab = _mm_xor_si128(a, b);
+  __m128i bc = _mm_xor_si128(b, c);
+  __m128i cd = _mm_xor_si128(c, d);
+  __m128i abx = aesXtime(ab);
+  __m128i bcx = aesXtime(bc);
+  __m128i cdx = aesXtime(cd);
+  __m128i a1 = _mm_xor_si128(abx, _mm_xor_si128(bc, d));
+  __m128i b1 = _mm_xor_si128(bcx, _mm_xor_si128(a, cd));
+  __m128i c1 = _mm_xor_si128(cdx, _mm_xor_si128(ab, d));
+  __m128i d1 = _mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(_mm_xor_si128(cdx, ab), c));
+  a = a1;
+  b = b1;
+  c = c1;
+  d = d1;
+}
+
+// SHAvite-3 512 IV and counter words for 512-bit message
+alignas(16) const uint32_t ShaviteIV512[16] = {
+  0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC, 0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+  0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47, 0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+}
+
+void luffa512TailAVX2(uint8_t *out, const uint32_t chainingValue[5][8], const uint8_t *tail)
+{
+  alignas(32) uint32_t cv[8][8] = {};
+  for (unsigned j = 0; j < 5; j++) {
+    for (unsigned i = 0; i < 8; i++)
+      cv[i][j] = chainingValue[j][i];
+  }
+
+  __m256i w[8];
+  for (unsigned i = 0; i < 8; i++)
+    w[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(cv[i]));
+
+  uint8_t lastBlock[32] = {};
+  memcpy(lastBlock, tail + 32, 16);
+  lastBlock[16] = 0x80;
+
+  luffaRound(w, tail);
+  luffaRound(w, lastBlock);
+  luffaRound(w, nullptr);
+  luffaOutput(out, w);
+  luffaRound(w, nullptr);
+  luffaOutput(out + 32, w);
+}
+
+void cubehash512AVX2(uint8_t *out, const uint8_t *in)
+{
+  __m256i x0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(CubehashIV512));
+  __m256i x1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(CubehashIV512 + 8));
+  __m256i x2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(CubehashIV512 + 16));
+  __m256i x3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(CubehashIV512 + 24));
+
+  x0 = _mm256_xor_si256(x0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in)));
+  cubehashRounds(x0, x1, x2, x3, 16);
+  x0 = _mm256_xor_si256(x0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 32)));
+  cubehashRounds(x0, x1, x2, x3, 16);
+  // Padding block, then finalization: x[31] ^= 1 and 10*16 rounds
+  x0 = _mm256_xor_si256(x0, _mm256_setr_epi32(0x80, 0, 0, 0, 0, 0, 0, 0));
+  cubehashRounds(x0, x1, x2, x3, 16);
+  x3 = _mm256_xor_si256(x3, _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 1));
+  cubehashRounds(x0, x1, x2, x3, 160);
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), x0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), x1);
+}
+
+void shavite512AES(uint8_t *out, const uint8_t *in)
+{
+  // Single padded block: message, 0x80, bit counter (128 bits) at 110, digest size at 126
+  alignas(16) uint8_t block[128] = {};
+  memcpy(block, in, 64);
+  block[64] = 0x80;
+  block[111] = 0x02;
+  block[127] = 0x02;
+
+  // Key schedule, 112 round keys; counter (512, 0, 0, 0) mixed in at keys 8, 41, 79 and 110
+  __m128i rk[112];
+  for (unsigned i = 0; i < 8; i++)
+    rk[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(block + 16*i));
+
+  __m128i zero = _mm_setzero_si128();
+  unsigned i = 8;
+  for (;;) {
+    for (unsigned s = 0; s < 8; s++, i++) {
+      rk[i] = _mm_xor_si128(_mm_aesenc_si128(_mm_shuffle_epi32(rk[i-8], 0x39), zero), rk[i-1]);
+      if (i == 8)
+        rk[i] = _mm_xor_si128(rk[i], _mm_setr_epi32(512, 0, 0, -1));
+      else if (i == 41)
+        rk[i] = _mm_xor_si128(rk[i], _mm_setr_epi32(0, 0, 0, ~512));
+      else if (i == 79)
+        rk[i] = _mm_xor_si128(rk[i], _mm_setr_epi32(0, 0, 512, -1));
+      else if (i == 110)
+        rk[i] = _mm_xor_si128(rk[i], _mm_setr_epi32(0, 512, 0, -1));
+    }
+    if (i == 112)
+      break;
+    for (unsigned s = 0; s < 8; s++, i++)
+      rk[i] = _mm_xor_si128(rk[i-8], _mm_alignr_epi8(rk[i-1], rk[i-2], 4));
+  }
+
+  __m128i h[4];
+  __m128i p[4];
+  for (unsigned j = 0; j < 4; j++)
+    h[j] = p[j] = _mm_load_si128(reinterpret_cast<const __m128i*>(ShaviteIV512 + 4*j));
+
+  const __m128i *k = rk;
+  for (unsigned r = 0; r < 14; r++) {
+    __m128i x = _mm_xor_si128(p[1], k[0]);
+    x = _mm_aesenc_si128(x, k[1]);
+    x = _mm_aesenc_si128(x, k[2]);
+    x = _mm_aesenc_si128(x, k[3]);
+    p[0] = _mm_aesenc_si128(x, p[0]);
+    x = _mm_xor_si128(p[3], k[4]);
+    x = _mm_aesenc_si128(x, k[5]);
+    x = _mm_aesenc_si128(x, k[6]);
+    x = _mm_aesenc_si128(x, k[7]);
+    p[2] = _mm_aesenc_si128(x, p[2]);
+    k += 8;
+
+    __m128i t = p[3];
+    p[3] = p[2];
+    p[2] = p[1];
+    p[1] = p[0];
+    p[0] = t;
+  }
+
+  for (unsigned j = 0; j < 4; j++)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16*j), _mm_xor_si128(h[j], p[j]));
+}
+
+void echo512AES(uint8_t *out, const uint8_t *in)
+{
+  // Single padded block: message, 0x80, digest size at 110, bit counter (128 bits) at 112
+  alignas(16) uint8_t block[128] = {};
+  memcpy(block, in, 64);
+  block[64] = 0x80;
+  block[111] = 0x02;
+  block[113] = 0x02;
+
+  __m128i w[16];
+  __m128i v = _mm_setr_epi32(512, 0, 0, 0);
+  for (unsigned i = 0; i < 8; i++) {
+    w[i] = v;
+    w[i+8] = _mm_load_si128(reinterpret_cast<const __m128i*>(block + 16*i));
+  }
+
+  __m128i zero = _mm_setzero_si128();
+  uint32_t counter = 512;
+  for (unsigned r = 0; r < 10; r++) {
+    // BIG.SubWords: two AES rounds, first keyed by counter
+    for (unsigned i = 0; i < 16; i++)
+      w[i] = _mm_aesenc_si128(_mm_aesenc_si128(w[i], _mm_setr_epi32(static_cast<int>(counter++), 0, 0, 0)), zero);
+
+    // BIG.ShiftRows
+    __m128i t = w[1];
+    w[1] = w[5];
+    w[5] = w[9];
+    w[9] = w[13];
+    w[13] = t;
+    t = w[2];
+    w[2] = w[10];
+    w[10] = t;
+    t = w[6];
+    w[6] = w[14];
+    w[14] = t;
+    t = w[15];
+    w[15] = w[11];
+    w[11] = w[7];
+    w[7] = w[3];
+    w[3] = t;
+
+    // BIG.MixColumns
+    for (unsigned i = 0; i < 16; i += 4)
+      echoMixColumn(w[i], w[i+1], w[i+2], w[i+3]);
+  }
+
+  // BIG.Final, only first 512 bits of chaining value needed
+  for (unsigned i = 0; i < 4; i++) {
+    __m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(block + 16*i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16*i), _mm_xor_si128(_mm_xor_si128(v, m), _mm_xor_si128(w[i], w[i+8])));
+  }
+}
+#endif
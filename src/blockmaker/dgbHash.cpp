@@ -0,0 +1,145 @@
+#include "blockmaker/dgbHash.h"
+#include "blockmaker/sph_luffa.h"
+#include "blockmaker/sph_cubehash.h"
+#include "blockmaker/sph_shavite.h"
+#include "blockmaker/sph_simd.h"
+#include "blockmaker/sph_echo.h"
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace {
+// Reference implementations
+void luffa512TailScalar(uint8_t *out, const uint32_t chainingValue[5][8], const uint8_t *tail)
+{
+  sph_luffa512_context ctx;
+  memcpy(ctx.V, chainingValue, sizeof(ctx.V));
+  ctx.ptr = 0;
+  sph_luffa512(&ctx, tail, 48);
+  sph_luffa512_close(&ctx, out);
+}
+
+void cubehash512Scalar(uint8_t *out, const uint8_t *in)
+{
+  sph_cubehash512_context ctx;
+  sph_cubehash512_init(&ctx);
+  sph_cubehash512(&ctx, in, 64);
+  sph_cubehash512_close(&ctx, out);
+}
+
+void shavite512Scalar(uint8_t *out, const uint8_t *in)
+{
+  sph_shavite512_context ctx;
+  sph_shavite512_init(&ctx);
+  sph_shavite512(&ctx, in, 64);
+  sph_shavite512_close(&ctx, out);
+}
+
+void simd512Scalar(uint8_t *out, const uint8_t *in)
+{
+  sph_simd512_context ctx;
+  sph_simd512_init(&ctx);
+  sph_simd512(&ctx, in, 64);
+  sph_simd512_close(&ctx, out);
+}
+
+void echo512Scalar(uint8_t *out, const uint8_t *in)
+{
+  sph_echo512_context ctx;
+  sph_echo512_init(&ctx);
+  sph_echo512(&ctx, in, 64);
+  sph_echo512_close(&ctx, out);
+}
+}
+
+#if defined(__x86_64__)
+// dgbHash.avx2.cpp
+void luffa512TailAVX2(uint8_t *out, const uint32_t chainingValue[5][8], const uint8_t *tail);
+void cubehash512AVX2(uint8_t *out, const uint8_t *in);
+void shavite512AES(uint8_t *out, const uint8_t *in);
+void echo512AES(uint8_t *out, const uint8_t *in);
+#endif
+
+namespace {
+// Luffa-512 of last 48 header bytes starting from chaining value after first 32 bytes
+using CLuffaTailFunction = void(uint8_t*, const uint32_t[5][8], const uint8_t*);
+// 512-bit hash of 64-byte message
+using CHash64Function = void(uint8_t*, const uint8_t*);
+
+struct CDgbHashImpl {
+  const char *Name = "sph";
+  CLuffaTailFunction *Luffa512Tail = luffa512TailScalar;
+  CHash64Function *Cubehash512 = cubehash512Scalar;
+  CHash64Function *Shavite512 = shavite512Scalar;
+  CHash64Function *Simd512 = simd512Scalar;
+  CHash64Function *Echo512 = echo512Scalar;
+
+  CDgbHashImpl() {
+#if defined(__x86_64__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return;
+    bool hasAES = ecx & bit_AES;
+    bool hasOSXSave = ecx & bit_OSXSAVE;
+
+    unsigned ebx7 = 0;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+      ebx7 = ebx;
+
+    // AVX registers must be enabled by OS
+    uint64_t xcr0 = 0;
+    if (hasOSXSave) {
+      uint32_t lo, hi;
+      __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+      xcr0 = (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+    bool hasAVX2 = (ebx7 & bit_AVX2) && (xcr0 & 0x06) == 0x06;
+
+    // One kernels file compiled with both instruction sets
+    if (hasAVX2 && hasAES) {
+      Name = "avx2 + aes-ni";
+      Luffa512Tail = luffa512TailAVX2;
+      Cubehash512 = cubehash512AVX2;
+      Shavite512 = shavite512AES;
+      Echo512 = echo512AES;
+    }
+#endif
+  }
+};
+
+const CDgbHashImpl &dgbHashImpl()
+{
+  static CDgbHashImpl impl;
+  return impl;
+}
+}
+
+void qubitHash(void *out, CQubitPrefix &prefix, const void *header)
+{
+  const uint8_t *data = static_cast<const uint8_t*>(header);
+  if (!prefix.Initialized || memcmp(prefix.Data, data, sizeof(prefix.Data)) != 0) {
+    sph_luffa512_context ctx;
+    sph_luffa512_init(&ctx);
+    sph_luffa512(&ctx, data, sizeof(prefix.Data));
+    memcpy(prefix.Data, data, sizeof(prefix.Data));
+    memcpy(prefix.Luffa, ctx.V, sizeof(prefix.Luffa));
+    prefix.Initialized = true;
+  }
+
+  const CDgbHashImpl &impl = dgbHashImpl();
+  uint8_t hash1[64];
+  uint8_t hash2[64];
+  impl.Luffa512Tail(hash1, prefix.Luffa, data + sizeof(prefix.Data));
+  impl.Cubehash512(hash2, hash1);
+  impl.Shavite512(hash1, hash2);
+  impl.Simd512(hash2, hash1);
+  impl.Echo512(hash1, hash2);
+  memcpy(out, hash1, 32);
+}
+
+const char *dgbHashImplementation()
+{
+  return dgbHashImpl().Name;
+}
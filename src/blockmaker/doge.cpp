@@ -19,7 +19,7 @@ namespace DOGE {
 Stratum::MergedWork::MergedWork(uint64_t stratumWorkId, CSingleWork *first, CSingleWork *second, MiningConfig &miningCfg) : StratumMergedWork(stratumWorkId, first, second, miningCfg)
 {
   LTCHeader_ = ltcWork()->Header;
-  LTCMerklePath_ = ltcWork()->MerklePath;
+  LTCMerklePath_ = ltcWork()->merklePath();
   DOGEHeader_ = dogeWork()->Header;
 
   // Prepare merged work
@@ -38,7 +38,7 @@ Stratum::MergedWork::MergedWork(uint64_t stratumWorkId, CSingleWork *first, CSin
 
   // Calculate merkle root
   DOGEHeader_.nVersion |= DOGE::Proto::BlockHeader::VERSION_AUXPOW;
-  DOGEHeader_.hashMerkleRoot = calculateMerkleRoot(DOGELegacy_.Data.data(), DOGELegacy_.Data.sizeOf(), dogeWork()->MerklePath);
+  DOGEHeader_.hashMerkleRoot = calculateMerkleRoot(DOGELegacy_.Data.data(), DOGELegacy_.Data.sizeOf(), dogeWork()->merklePath());
 
   // Calculate /reversed/ DOGE header hash
   uint256 hash = DOGEHeader_.GetHash();
@@ -0,0 +1,38 @@
+// AVX2 4-way BLAKE2b for Equihash, compiled with -mavx2
+#if defined(__x86_64__)
+#include "blockmaker/blake2b.lanes.h"
+#include <immintrin.h>
+
+namespace {
+struct CAVX2Ops {
+  using V = __m256i;
+  static constexpr unsigned Lanes = 4;
+  static inline V add(V a, V b) { return _mm256_add_epi64(a, b); }
+  static inline V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+  template<int n> static inline V rotr(V x) {
+    // Byte-aligned rotations done by shuffles
+    if constexpr (n == 32) {
+      return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+    } else if constexpr (n == 24) {
+      return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                                     3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10));
+    } else if constexpr (n == 16) {
+      return _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                                     2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9));
+    } else if constexpr (n == 63) {
+      return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x));
+    } else {
+      return _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - n));
+    }
+  }
+  static inline V set1(uint64_t x) { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+  static inline V load(const uint64_t *p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+  static inline void store(uint64_t *p, V x) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), x); }
+};
+}
+
+void blake2bx4AVX2(uint64_t *out, const uint64_t *h, const uint64_t *m, const uint64_t *m1, uint64_t counter, bool last)
+{
+  CBlake2bLanes<CAVX2Ops>::compress(out, h, m, m1, counter, last);
+}
+#endif
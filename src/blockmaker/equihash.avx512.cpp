@@ -0,0 +1,29 @@
+// AVX-512 8-way BLAKE2b for Equihash, compiled with -mavx512f
+#if defined(__x86_64__)
+#include "blockmaker/blake2b.lanes.h"
+#include <immintrin.h>
+
+// gcc reports _mm512_undefined_epi32 usage inside intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace {
+struct CAVX512Ops {
+  using V = __m512i;
+  static constexpr unsigned Lanes = 8;
+  static inline V add(V a, V b) { return _mm512_add_epi64(a, b); }
+  static inline V bxor(V a, V b) { return _mm512_xor_si512(a, b); }
+  template<int n> static inline V rotr(V x) { return _mm512_ror_epi64(x, n); }
+  static inline V set1(uint64_t x) { return _mm512_set1_epi64(static_cast<long long>(x)); }
+  static inline V load(const uint64_t *p) { return _mm512_load_si512(p); }
+  static inline void store(uint64_t *p, V x) { _mm512_store_si512(p, x); }
+};
+}
+
+void blake2bx8AVX512(uint64_t *out, const uint64_t *h, const uint64_t *m, const uint64_t *m1, uint64_t counter, bool last)
+{
+  CBlake2bLanes<CAVX512Ops>::compress(out, h, m, m1, counter, last);
+}
+#endif
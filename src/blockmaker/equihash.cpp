@@ -0,0 +1,200 @@
+#include "blockmaker/equihash.h"
+#include "blockmaker/blake2b.lanes.h"
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace {
+struct CScalarOps {
+  using V = uint64_t;
+  static constexpr unsigned Lanes = 1;
+  static inline V add(V a, V b) { return a + b; }
+  static inline V bxor(V a, V b) { return a ^ b; }
+  template<int n> static inline V rotr(V x) { return (x >> n) | (x << (64 - n)); }
+  static inline V set1(uint64_t x) { return x; }
+  static inline V load(const uint64_t *p) { return *p; }
+  static inline void store(uint64_t *p, V x) { *p = x; }
+};
+
+void blake2bScalar(uint64_t *out, const uint64_t *h, const uint64_t *m, const uint64_t *m1, uint64_t counter, bool last)
+{
+  CBlake2bLanes<CScalarOps>::compress(out, h, m, m1, counter, last);
+}
+}
+
+#if defined(__x86_64__)
+// equihash.avx2.cpp
+void blake2bx4AVX2(uint64_t *out, const uint64_t *h, const uint64_t *m, const uint64_t *m1, uint64_t counter, bool last);
+// equihash.avx512.cpp
+void blake2bx8AVX512(uint64_t *out, const uint64_t *h, const uint64_t *m, const uint64_t *m1, uint64_t counter, bool last);
+#endif
+
+namespace {
+using CBlake2bFunction = void(uint64_t*, const uint64_t*, const uint64_t*, const uint64_t*, uint64_t, bool);
+
+static constexpr unsigned MaxLanes = 8;
+
+struct CEquihashImpl {
+  const char *Name = "scalar";
+  // Processes Lanes messages, number of solution indices always multiple of it
+  unsigned Lanes = 1;
+  CBlake2bFunction *HashxN = blake2bScalar;
+
+  CEquihashImpl() {
+#if defined(__x86_64__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return;
+    bool hasOSXSave = ecx & bit_OSXSAVE;
+
+    unsigned ebx7 = 0;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+      ebx7 = ebx;
+
+    // AVX registers must be enabled by OS
+    uint64_t xcr0 = 0;
+    if (hasOSXSave) {
+      uint32_t lo, hi;
+      __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+      xcr0 = (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+    bool hasAVX2 = (ebx7 & bit_AVX2) && (xcr0 & 0x06) == 0x06;
+    bool hasAVX512 = (ebx7 & bit_AVX512F) && (xcr0 & 0xE6) == 0xE6;
+
+    if (hasAVX512) {
+      Name = "avx512 8-way";
+      Lanes = 8;
+      HashxN = blake2bx8AVX512;
+    } else if (hasAVX2) {
+      Name = "avx2 4-way";
+      Lanes = 4;
+      HashxN = blake2bx4AVX2;
+    }
+#endif
+  }
+};
+
+const CEquihashImpl &equihashImpl()
+{
+  static CEquihashImpl impl;
+  return impl;
+}
+
+// Reads big-endian bit sequence as numbers of bitLen bits
+template<unsigned bitLen, typename Out>
+inline void expandBits(const uint8_t *in, size_t size, Out *out)
+{
+  static_assert(bitLen >= 8 && bitLen + 7 <= 32, "unsupported bit length");
+  uint32_t mask = (static_cast<uint32_t>(1) << bitLen) - 1;
+  uint32_t acc = 0;
+  unsigned accBits = 0;
+  for (size_t i = 0; i < size; i++) {
+    acc = (acc << 8) | in[i];
+    accBits += 8;
+    if (accBits >= bitLen) {
+      accBits -= bitLen;
+      *out++ = (acc >> accBits) & mask;
+    }
+  }
+}
+
+// Same result as IsValidSolution from ZCash, but without heap allocations:
+//   all indices distinct; at level r each pair of subtrees collides on r-th chunk of XOR of its hashes
+//   and left subtree starts with smaller index; XOR of all hashes is zero
+// All hashes share first BLAKE2b block (140-byte input), last block differs only by hash number
+template<unsigned N, unsigned K>
+bool verify(const CEquihashImpl &impl, const uint8_t *input, const uint8_t *solution, size_t solutionSize)
+{
+  constexpr unsigned IndicesPerHashOutput = 512/N;
+  constexpr unsigned HashOutput = IndicesPerHashOutput*N/8;
+  constexpr unsigned CollisionBitLength = N/(K+1);
+  constexpr unsigned IndicesNum = 1u << K;
+  constexpr size_t SolutionWidth = IndicesNum*(CollisionBitLength+1)/8;
+  static_assert(IndicesNum % MaxLanes == 0, "indices number must be multiple of lanes");
+
+  if (solutionSize != SolutionWidth)
+    return false;
+
+  uint32_t indices[IndicesNum];
+  expandBits<CollisionBitLength+1>(solution, solutionSize, indices);
+
+  {
+    uint32_t sorted[IndicesNum];
+    std::copy(indices, indices + IndicesNum, sorted);
+    std::sort(sorted, sorted + IndicesNum);
+    if (std::adjacent_find(sorted, sorted + IndicesNum) != sorted + IndicesNum)
+      return false;
+  }
+
+  // Parameter block: digest length, fanout = depth = 1, personalization "ZcashPoW" || N || K
+  uint64_t initial[8];
+  std::copy(Blake2bIV, Blake2bIV + 8, initial);
+  initial[0] ^= 0x01010000 ^ HashOutput;
+  initial[6] ^= blake2bReadLE(reinterpret_cast<const uint8_t*>("ZcashPoW"));
+  initial[7] ^= N | (static_cast<uint64_t>(K) << 32);
+
+  uint64_t m[16];
+  for (unsigned i = 0; i < 16; i++)
+    m[i] = blake2bReadLE(input + i*8);
+  uint64_t h[8];
+  blake2bScalar(h, initial, m, &m[1], 128, false);
+
+  // Last block: 12 bytes of input, 4-byte little-endian hash number, zero padding
+  uint8_t tail[16] = {};
+  std::copy(input + 128, input + EquihashInputSize, tail);
+  m[0] = blake2bReadLE(tail);
+  uint64_t m1Base = blake2bReadLE(tail + 8);
+  std::fill(m + 1, m + 16, 0);
+
+  uint32_t rows[IndicesNum][K+1];
+  alignas(64) uint64_t out[8*MaxLanes];
+  uint64_t m1[MaxLanes];
+  unsigned lanes = impl.Lanes;
+  for (unsigned i = 0; i < IndicesNum; i += lanes) {
+    for (unsigned lane = 0; lane < lanes; lane++)
+      m1[lane] = m1Base | (static_cast<uint64_t>(indices[i+lane] / IndicesPerHashOutput) << 32);
+    impl.HashxN(out, h, m, m1, EquihashInputSize + 4, true);
+
+    for (unsigned lane = 0; lane < lanes; lane++) {
+      uint8_t hash[64];
+      for (unsigned w = 0; w < 8; w++)
+        blake2bWriteLE(hash + w*8, out[w*lanes + lane]);
+      expandBits<CollisionBitLength>(hash + (indices[i+lane] % IndicesPerHashOutput)*N/8, N/8, rows[i+lane]);
+    }
+  }
+
+  // Bottom-up merge in place, node j of next level built from nodes 2j and 2j+1
+  for (unsigned r = 0; r < K; r++) {
+    unsigned nodesNum = IndicesNum >> (r+1);
+    for (unsigned j = 0; j < nodesNum; j++) {
+      const uint32_t *left = rows[2*j];
+      const uint32_t *right = rows[2*j+1];
+      if (left[r] != right[r] || indices[2*j] > indices[2*j+1])
+        return false;
+      for (unsigned c = r+1; c <= K; c++)
+        rows[j][c] = left[c] ^ right[c];
+      indices[j] = indices[2*j];
+    }
+  }
+
+  return rows[0][K] == 0;
+}
+}
+
+bool equihashVerify(unsigned n, unsigned k, const uint8_t *input, const uint8_t *solution, size_t solutionSize)
+{
+  const CEquihashImpl &impl = equihashImpl();
+  if (n == 200 && k == 9)
+    return verify<200, 9>(impl, input, solution, solutionSize);
+  else if (n == 48 && k == 5)
+    return verify<48, 5>(impl, input, solution, solutionSize);
+  else
+    return false;
+}
+
+const char *equihashImplementation()
+{
+  return equihashImpl().Name;
+}
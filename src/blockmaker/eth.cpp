@@ -22,8 +22,37 @@ static inline double getDifficulty(uint32_t bits)
 }
 
 namespace ETH {
+// mining.submit fast path, decodes message without DOM construction and memory allocation
+// (message object is reused by connection)
+static inline bool decodeSubmitFast(const CStratumRawMessage &raw, Stratum::StratumMessage &msg)
+{
+  const CStratumToken *params = raw.Params;
+  if (!(raw.ParamsNum == 3 &&
+        params[0].isString() &&
+        params[1].isString() &&
+        params[2].isString()))
+    return false;
+  if (!decodeStratumId(raw.Id, msg.IntegerId, msg.StringId))
+    return false;
+
+  msg.Method = ESubmit;
+  params[0].assign(msg.Submit.WorkerName);
+  params[1].assign(msg.Submit.JobId);
+  // Token is terminated by quote character
+  msg.Submit.Nonce = strtoul(params[2].Data, nullptr, 16);
+  return true;
+}
+
 EStratumDecodeStatusTy Stratum::StratumMessage::decodeStratumMessage(const char *in, size_t size)
 {
+  {
+    CStratumRawMessage raw;
+    if (raw.scan(in, size) && raw.Method.equal("mining.submit") && decodeSubmitFast(raw, *this))
+      return EStratumStatusOk;
+  }
+
+  // Generic path
+  *this = StratumMessage();
   rapidjson::Document document;
   document.Parse(in, size);
   if (document.HasParseError()) {
@@ -113,11 +142,11 @@ void Stratum::WorkerConfig::onSubscribe(MiningConfig &miningCfg, StratumMessage
   subscribeInfo = std::to_string(ExtraNonceFixed);
 }
 
-bool Stratum::Work::loadFromTemplate(CBlockTemplate &blockTemplate, const std::string &ticker, std::string &error)
+CPreparedWork *Stratum::Work::prepare(CBlockTemplate &blockTemplate, const std::string&, const MiningConfig&, const std::vector<uint8_t>&, const std::string&, std::string &error)
 {
   if (!blockTemplate.Document.HasMember("result") || !blockTemplate.Document["result"].IsArray()) {
     error = "no result";
-    return false;
+    return nullptr;
   }
 
   rapidjson::Value::Array resultValue = blockTemplate.Document["result"].GetArray();
@@ -127,32 +156,31 @@ bool Stratum::Work::loadFromTemplate(CBlockTemplate &blockTemplate, const std::s
       !resultValue[2].IsString() || resultValue[2].GetStringLength() != 66 ||
       !resultValue[3].IsString()) {
     error = "getWork format error";
-    return false;
+    return nullptr;
   }
 
-  HeaderHashHex_ = resultValue[0].GetString() + 2;
-  SeedHashHex_ = resultValue[1].GetString() + 2;
-  HeaderHash_.SetHex(HeaderHashHex_);
-  std::reverse(HeaderHash_.begin(), HeaderHash_.end());
-  Target_.SetHex(resultValue[2].GetString() + 2);
-  this->Height_ = strtoul(resultValue[3].GetString()+2, nullptr, 16);
-  // Block reward can't be calculated at this moment
-  this->BlockReward_ = 0;
-
-  // Copy reference to DAG file & check it
-  DagFile_ = blockTemplate.DagFile;
-  if (DagFile_.get() == nullptr) {
+  // Check DAG file
+  if (blockTemplate.DagFile.get() == nullptr) {
     error = "DAG file is empty";
-    return false;
+    return nullptr;
   }
 
-  return true;
+  CPrepared *prepared = new CPrepared;
+  prepared->HeaderHashHex = resultValue[0].GetString() + 2;
+  prepared->SeedHashHex = resultValue[1].GetString() + 2;
+  prepared->HeaderHash.SetHex(prepared->HeaderHashHex);
+  std::reverse(prepared->HeaderHash.begin(), prepared->HeaderHash.end());
+  prepared->Target.SetHex(resultValue[2].GetString() + 2);
+  prepared->Height = strtoul(resultValue[3].GetString()+2, nullptr, 16);
+  prepared->DagFile = blockTemplate.DagFile;
+  return prepared;
 }
 
 bool Stratum::Work::prepareForSubmit(const WorkerConfig &workerCfg, const StratumMessage &msg)
 {
   Nonce_ = (workerCfg.ExtraNonceFixed << (64 - 8*MiningCfg_.FixedExtraNonceSize)) | msg.Submit.Nonce;
-  ethashCalculate(FinalHash_.begin(), MixHash_.begin(), HeaderHash_.begin(), Nonce_, DagFile_.get()->dag());
+  EthashDagWrapper *dagFile = Prepared_.get()->DagFile.get();
+  ethashCalculate(FinalHash_.begin(), MixHash_.begin(), Prepared_.get()->HeaderHash.begin(), Nonce_, dagFile->dag(), dagFile->fullDataset());
   std::reverse(FinalHash_.begin(), FinalHash_.begin()+32);
   return true;
 }
@@ -170,7 +198,7 @@ void Stratum::Work::buildBlock(size_t, xmstream &blockHexData)
   // Header hash
   data->HeaderHash[0] = '0';
   data->HeaderHash[1] = 'x';
-  memcpy(&data->HeaderHash[2], HeaderHashHex_.data(), 64);
+  memcpy(&data->HeaderHash[2], Prepared_.get()->HeaderHashHex.data(), 64);
   data->HeaderHash[64+2] = 0;
   // Mix hash
   data->MixHash[0] = '0';
@@ -184,7 +212,7 @@ CCheckStatus Stratum::Work::checkConsensus(size_t)
   CCheckStatus status;
   // Get difficulty
   status.ShareDiff = getDifficulty(FinalHash_.GetCompact());
-  status.IsBlock = FinalHash_ <= Target_;
+  status.IsBlock = FinalHash_ <= Prepared_.get()->Target;
   status.IsPendingBlock = false;
   return status;
 }
@@ -206,9 +234,9 @@ void Stratum::Work::buildNotifyMessage(bool resetPreviousWork)
         params.addString(buffer);
       }
       // Seed hash
-      params.addString(SeedHashHex_);
+      params.addString(Prepared_.get()->SeedHashHex);
       // Header hash
-      params.addString(HeaderHashHex_);
+      params.addString(Prepared_.get()->HeaderHashHex);
 
     }
   }
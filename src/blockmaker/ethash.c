@@ -195,6 +195,25 @@ static void itemFinal(void *out, ItemState *item)
   sha3_final(out, &ctx, 1);
 }
 
+// 1024-bit full dataset item built from light cache
+static void calculateDatasetItem(uint32_t out[32], const EthashDag *context, uint32_t index)
+{
+  const int full_dataset_item_parents = 256;
+  ItemState item0;
+  ItemState item1;
+
+  itemInit(&item0, context, (int64_t)index*2);
+  itemInit(&item1, context, (int64_t)index*2+1);
+
+  for (uint32_t j = 0; j < full_dataset_item_parents; ++j) {
+    itemUpdate(&item0, j);
+    itemUpdate(&item1, j);
+  }
+
+  itemFinal(out, &item0);
+  itemFinal(out+16, &item1);
+}
+
 int ethashGetEpochNumber(void *seed)
 {
   if (memcmp(seed, CachedSeed, 32) == 0)
@@ -244,7 +263,18 @@ EthashDag *ethashCreateDag(int epochNumber, int bigEpoch)
   return dag;
 }
 
-void ethashCalculate(void *finalHash, void *mixHash, const void *headerHash, uint64_t nonce, const EthashDag *context)
+uint64_t ethashGetFullDatasetSize(const EthashDag *context)
+{
+  return (uint64_t)context->FullDatasetItemsNum * 128;
+}
+
+void ethashCalculateDatasetItems(uint32_t *items, const EthashDag *context, uint32_t begin, uint32_t end)
+{
+  for (uint32_t i = begin; i < end; i++)
+    calculateDatasetItem(items + (size_t)(i-begin)*32, context, i);
+}
+
+void ethashCalculate(void *finalHash, void *mixHash, const void *headerHash, uint64_t nonce, const EthashDag *context, const uint32_t *fullDataset)
 {
   const int num_dataset_accesses = 64;
 
@@ -269,24 +299,15 @@ void ethashCalculate(void *finalHash, void *mixHash, const void *headerHash, uin
 
 
   for (uint32_t i = 0; i < num_dataset_accesses; ++i) {
-    uint32_t newData32[32];
+    uint32_t localData32[32];
+    const uint32_t *newData32;
     const uint32_t p = fnv1(i ^ seed_init, mix[i % num_words]) % index_limit;
 
-    {
-      const int full_dataset_item_parents = 256;
-      ItemState item0;
-      ItemState item1;
-
-      itemInit(&item0, context, p*2);
-      itemInit(&item1, context, p*2+1);
-
-      for (uint32_t j = 0; j < full_dataset_item_parents; ++j) {
-        itemUpdate(&item0, j);
-        itemUpdate(&item1, j);
-      }
-
-      itemFinal(newData32, &item0);
-      itemFinal(newData32+16, &item1);
+    if (fullDataset) {
+      newData32 = fullDataset + (size_t)p*32;
+    } else {
+      calculateDatasetItem(localData32, context, p);
+      newData32 = localData32;
     }
 
     for (size_t j = 0; j < num_words; ++j)
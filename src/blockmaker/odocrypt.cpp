@@ -107,18 +107,87 @@ OdoCrypt::OdoCrypt(uint32_t key)
         RoundKey[i] = r.Next(1 << STATE_SIZE);
 }
 
+namespace {
+inline uint64_t RotL(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> ((64 - r) & 63));
+}
+}
+
+// Same transformation as round helpers below, unrolled for STATE_SIZE 10:
+// state kept in local variables, word shuffle replaced by index remapping
 void OdoCrypt::Encrypt(char cipher[DIGEST_SIZE], const char plain[DIGEST_SIZE]) const
 {
+    static_assert(STATE_SIZE == 10 && PBOX_M == 3 && SMALL_SBOX_COUNT == 40, "unrolled encryption requires default parameters");
+
     uint64_t state[STATE_SIZE];
     Unpack(state, plain);
     PreMix(state);
+
+    auto pbox = [](uint64_t s[STATE_SIZE], const Pbox& perm)
+    {
+        #pragma GCC unroll 6
+        for (int i = 0; i < PBOX_SUBROUNDS; i++)
+        {
+            #pragma GCC unroll 5
+            for (int j = 0; j < STATE_SIZE/2; j++)
+            {
+                uint64_t swp = perm.mask[i][j] & (s[2*j] ^ s[2*j+1]);
+                s[2*j] ^= swp;
+                s[2*j+1] ^= swp;
+            }
+            if (i == PBOX_SUBROUNDS-1)
+                break;
+            uint64_t next[STATE_SIZE];
+            #pragma GCC unroll 10
+            for (int j = 0; j < STATE_SIZE; j++)
+                next[PBOX_M*j % STATE_SIZE] = s[j];
+            #pragma GCC unroll 5
+            for (int j = 0; j < STATE_SIZE/2; j++)
+            {
+                s[2*j] = RotL(next[2*j], perm.rotation[i][j]);
+                s[2*j+1] = next[2*j+1];
+            }
+        }
+    };
+
     for (int round = 0; round < ROUNDS; round++)
     {
-        ApplyPbox(state, Permutation[0]);
-        ApplySboxes(state, Sbox1, Sbox2);
-        ApplyPbox(state, Permutation[1]);
-        ApplyRotations(state, Rotations);
-        ApplyRoundKey(state, RoundKey[round]);
+        pbox(state, Permutation[0]);
+
+        // 4 pairs of 6-bit and 10-bit sboxes per word
+        #pragma GCC unroll 10
+        for (int i = 0; i < STATE_SIZE; i++)
+        {
+            uint64_t x = state[i];
+            uint64_t next = 0;
+            #pragma GCC unroll 4
+            for (int j = 0; j < 4; j++)
+            {
+                next |= (uint64_t)Sbox1[4*i+j][(x >> 16*j) & 0x3F] << 16*j;
+                next |= (uint64_t)Sbox2[i][(x >> (16*j+6)) & 0x3FF] << (16*j+6);
+            }
+            state[i] = next;
+        }
+
+        pbox(state, Permutation[1]);
+
+        uint64_t next[STATE_SIZE];
+        #pragma GCC unroll 10
+        for (int i = 0; i < STATE_SIZE; i++)
+        {
+            uint64_t x = state[i];
+            uint64_t acc = state[(i+1) % STATE_SIZE];
+            #pragma GCC unroll 6
+            for (int j = 0; j < ROTATION_COUNT; j++)
+                acc ^= RotL(x, Rotations[j]);
+            next[i] = acc;
+        }
+
+        unsigned roundKey = RoundKey[round];
+        #pragma GCC unroll 10
+        for (int i = 0; i < STATE_SIZE; i++)
+            state[i] = next[i] ^ ((roundKey >> i) & 1);
     }
     Pack(state, cipher);
 }
@@ -27,9 +27,9 @@
  * online backup system.
  */
 
-#if defined(USE_SSE2)
+#include <blockmaker/scrypt.h>
 
-#include <crypto/scrypt.h>
+#if defined(SCRYPT_X86_64)
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -138,4 +138,4 @@ void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchp
 	PBKDF2_SHA256((const uint8_t *)input, 80, B, 128, 1, (uint8_t *)output, 32);
 }
 
-#endif // USE_SSE2
+#endif // SCRYPT_X86_64
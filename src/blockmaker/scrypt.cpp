@@ -34,15 +34,8 @@
 #include <string.h>
 #include <openssl/sha.h>
 
-#if defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)
-#ifdef _MSC_VER
-// MSVC 64bit is unable to use inline asm
-#include <intrin.h>
-#else
-// GCC Linux or i686-w64-mingw32
-#include <cpuid.h>
-#endif
-#endif
+#include <memory>
+
 #ifndef __FreeBSD__
 static inline uint32_t be32dec(const void *pp)
 {
@@ -287,46 +280,14 @@ void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scrat
 	PBKDF2_SHA256((const uint8_t *)input, 80, B, 128, 1, (uint8_t *)output, 32);
 }
 
-#if defined(USE_SSE2)
-// By default, set to generic scrypt function. This will prevent crash in case when scrypt_detect_sse2() wasn't called
-void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output, char *scratchpad) = &scrypt_1024_1_1_256_sp_generic;
-
-std::string scrypt_detect_sse2()
-{
-    std::string ret;
-#if defined(USE_SSE2_ALWAYS)
-    ret = "scrypt: using scrypt-sse2 as built.";
-#else // USE_SSE2_ALWAYS
-    // 32bit x86 Linux or Windows, detect cpuid features
-    unsigned int cpuid_edx=0;
-#if defined(_MSC_VER)
-    // MSVC
-    int x86cpuid[4];
-    __cpuid(x86cpuid, 1);
-    cpuid_edx = (unsigned int)buffer[3];
-#else // _MSC_VER
-    // Linux or i686-w64-mingw32 (gcc-4.6.3)
-    unsigned int eax, ebx, ecx;
-    __get_cpuid(1, &eax, &ebx, &ecx, &cpuid_edx);
-#endif // _MSC_VER
-
-    if (cpuid_edx & 1<<26)
-    {
-        scrypt_1024_1_1_256_sp_detected = &scrypt_1024_1_1_256_sp_sse2;
-        ret = "scrypt: using scrypt-sse2 as detected";
-    }
-    else
-    {
-        scrypt_1024_1_1_256_sp_detected = &scrypt_1024_1_1_256_sp_generic;
-        ret = "scrypt: using scrypt-generic, SSE2 unavailable";
-    }
-#endif // USE_SSE2_ALWAYS
-    return ret;
-}
-#endif
-
 void scrypt_1024_1_1_256(const char *input, char *output)
 {
-	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
-    scrypt_1024_1_1_256_sp(input, output, scratchpad);
+	/* 128Kb, too large for stack of coroutines */
+	thread_local std::unique_ptr<char[]> scratchpad(new char[SCRYPT_SCRATCHPAD_SIZE]);
+#if defined(SCRYPT_X86_64)
+	/* SSE2 is part of x86_64 */
+	scrypt_1024_1_1_256_sp_sse2(input, output, scratchpad.get());
+#else
+	scrypt_1024_1_1_256_sp_generic(input, output, scratchpad.get());
+#endif
 }
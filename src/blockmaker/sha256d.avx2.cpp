@@ -0,0 +1,24 @@
+// AVX2 8-way double SHA256, compiled with -mavx2
+#if defined(__x86_64__)
+#include "blockmaker/sha256d.lanes.h"
+#include <immintrin.h>
+
+namespace {
+struct CAVX2Ops {
+  using V = __m256i;
+  static constexpr unsigned Lanes = 8;
+  static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+  static inline V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static inline V band(V a, V b) { return _mm256_and_si256(a, b); }
+  static inline V bor(V a, V b) { return _mm256_or_si256(a, b); }
+  template<int n> static inline V rotr(V x) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+  template<int n> static inline V shr(V x) { return _mm256_srli_epi32(x, n); }
+  static inline V set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+  static inline V load(const uint32_t *p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+  static inline void store(uint32_t *p, V x) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), x); }
+};
+}
+
+void sha256d64x8AVX2(uint8_t *out, const uint8_t *in) { CSha256Lanes<CAVX2Ops>::hash(out, in, 64); }
+void sha256d80x8AVX2(uint8_t *out, const uint8_t *in) { CSha256Lanes<CAVX2Ops>::hash(out, in, 80); }
+#endif
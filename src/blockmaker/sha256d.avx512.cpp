@@ -0,0 +1,30 @@
+// AVX-512 16-way double SHA256, compiled with -mavx512f
+#if defined(__x86_64__)
+#include "blockmaker/sha256d.lanes.h"
+#include <immintrin.h>
+
+// gcc reports _mm512_undefined_epi32 usage inside intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace {
+struct CAVX512Ops {
+  using V = __m512i;
+  static constexpr unsigned Lanes = 16;
+  static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+  static inline V bxor(V a, V b) { return _mm512_xor_si512(a, b); }
+  static inline V band(V a, V b) { return _mm512_and_si512(a, b); }
+  static inline V bor(V a, V b) { return _mm512_or_si512(a, b); }
+  template<int n> static inline V rotr(V x) { return _mm512_ror_epi32(x, n); }
+  template<int n> static inline V shr(V x) { return _mm512_srli_epi32(x, n); }
+  static inline V set1(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+  static inline V load(const uint32_t *p) { return _mm512_load_si512(p); }
+  static inline void store(uint32_t *p, V x) { _mm512_store_si512(p, x); }
+};
+}
+
+void sha256d64x16AVX512(uint8_t *out, const uint8_t *in) { CSha256Lanes<CAVX512Ops>::hash(out, in, 64); }
+void sha256d80x16AVX512(uint8_t *out, const uint8_t *in) { CSha256Lanes<CAVX512Ops>::hash(out, in, 80); }
+#endif
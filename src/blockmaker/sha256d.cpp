@@ -0,0 +1,141 @@
+#include "blockmaker/sha256d.h"
+#include "blockmaker/sha256d.lanes.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace {
+struct CScalarOps {
+  using V = uint32_t;
+  static constexpr unsigned Lanes = 1;
+  static inline V add(V a, V b) { return a + b; }
+  static inline V bxor(V a, V b) { return a ^ b; }
+  static inline V band(V a, V b) { return a & b; }
+  static inline V bor(V a, V b) { return a | b; }
+  template<int n> static inline V rotr(V x) { return (x >> n) | (x << (32 - n)); }
+  template<int n> static inline V shr(V x) { return x >> n; }
+  static inline V set1(uint32_t x) { return x; }
+  static inline V load(const uint32_t *p) { return *p; }
+  static inline void store(uint32_t *p, V x) { *p = x; }
+};
+
+void sha256d64Scalar(uint8_t *out, const uint8_t *in) { CSha256Lanes<CScalarOps>::hash(out, in, 64); }
+void sha256d80Scalar(uint8_t *out, const uint8_t *in) { CSha256Lanes<CScalarOps>::hash(out, in, 80); }
+}
+
+#if defined(__x86_64__)
+// sha256d.sse41.cpp
+void sha256d64x4SSE41(uint8_t *out, const uint8_t *in);
+void sha256d80x4SSE41(uint8_t *out, const uint8_t *in);
+// sha256d.avx2.cpp
+void sha256d64x8AVX2(uint8_t *out, const uint8_t *in);
+void sha256d80x8AVX2(uint8_t *out, const uint8_t *in);
+// sha256d.avx512.cpp
+void sha256d64x16AVX512(uint8_t *out, const uint8_t *in);
+void sha256d80x16AVX512(uint8_t *out, const uint8_t *in);
+// sha256d.shani.cpp
+void sha256d64SHANI(uint8_t *out, const uint8_t *in);
+void sha256d80SHANI(uint8_t *out, const uint8_t *in);
+#endif
+
+namespace {
+using CSha256dFunction = void(uint8_t*, const uint8_t*);
+
+struct CSha256dImpl {
+  const char *Name = "scalar";
+  // Multi-buffer functions, processes Lanes messages
+  unsigned Lanes = 0;
+  CSha256dFunction *Hash64xN = nullptr;
+  CSha256dFunction *Hash80xN = nullptr;
+  // Single message functions
+  CSha256dFunction *Hash64 = sha256d64Scalar;
+  CSha256dFunction *Hash80 = sha256d80Scalar;
+
+  CSha256dImpl() {
+#if defined(__x86_64__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return;
+    bool hasSSE41 = ecx & bit_SSE4_1;
+    bool hasOSXSave = ecx & bit_OSXSAVE;
+
+    unsigned ebx7 = 0;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+      ebx7 = ebx;
+
+    // AVX registers must be enabled by OS
+    uint64_t xcr0 = 0;
+    if (hasOSXSave) {
+      uint32_t lo, hi;
+      __asm__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+      xcr0 = (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+    bool hasAVX2 = (ebx7 & bit_AVX2) && (xcr0 & 0x06) == 0x06;
+    bool hasAVX512 = (ebx7 & bit_AVX512F) && (xcr0 & 0xE6) == 0xE6;
+    bool hasSHA = (ebx7 & bit_SHA) && hasSSE41;
+
+    // Single messages and batch tails
+    if (hasSHA) {
+      Hash64 = sha256d64SHANI;
+      Hash80 = sha256d80SHANI;
+    }
+
+    // Multi-buffer, AVX2 and SSE4.1 not faster than SHA-NI
+    if (hasAVX512) {
+      Name = hasSHA ? "avx512 16-way + sha-ni" : "avx512 16-way";
+      Lanes = 16;
+      Hash64xN = sha256d64x16AVX512;
+      Hash80xN = sha256d80x16AVX512;
+    } else if (hasSHA) {
+      Name = "sha-ni";
+    } else if (hasAVX2) {
+      Name = "avx2 8-way";
+      Lanes = 8;
+      Hash64xN = sha256d64x8AVX2;
+      Hash80xN = sha256d80x8AVX2;
+    } else if (hasSSE41) {
+      Name = "sse4.1 4-way";
+      Lanes = 4;
+      Hash64xN = sha256d64x4SSE41;
+      Hash80xN = sha256d80x4SSE41;
+    }
+#endif
+  }
+};
+
+const CSha256dImpl &sha256dImpl()
+{
+  static CSha256dImpl impl;
+  return impl;
+}
+
+void sha256dBatch(uint8_t *out, const uint8_t *in, size_t count, size_t msgSize, CSha256dFunction *hashxN, CSha256dFunction *hash, unsigned lanes)
+{
+  size_t i = 0;
+  if (hashxN) {
+    for (; i + lanes <= count; i += lanes)
+      hashxN(out + i*32, in + i*msgSize);
+  }
+
+  for (; i < count; i++)
+    hash(out + i*32, in + i*msgSize);
+}
+}
+
+void sha256d64(void *out, const void *in, size_t count)
+{
+  const CSha256dImpl &impl = sha256dImpl();
+  sha256dBatch(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), count, 64, impl.Hash64xN, impl.Hash64, impl.Lanes);
+}
+
+void sha256d80(void *out, const void *in, size_t count)
+{
+  const CSha256dImpl &impl = sha256dImpl();
+  sha256dBatch(static_cast<uint8_t*>(out), static_cast<const uint8_t*>(in), count, 80, impl.Hash80xN, impl.Hash80, impl.Lanes);
+}
+
+const char *sha256dImplementation()
+{
+  return sha256dImpl().Name;
+}
@@ -0,0 +1,48 @@
+// SHA-NI double SHA256, compiled with -msse4.1 -msha
+#if defined(__x86_64__)
+#include "blockmaker/sha256.cpu.h"
+#include "blockmaker/sha256d.lanes.h"
+
+namespace {
+inline void sha256dSHANI(uint8_t *out, const uint8_t *in, size_t msgSize)
+{
+  alignas(16) uint32_t w[16];
+  alignas(16) uint32_t state32[8];
+  __m128i state[2];
+
+  // First block
+  for (unsigned j = 0; j < 16; j++)
+    w[j] = sha256ReadBE(in + j*4);
+  sha256InitSHANI(state);
+  sha256TransformSHANI(state, reinterpret_cast<const __m128i*>(w));
+
+  // Second block: message tail & padding
+  unsigned tailWords = static_cast<unsigned>((msgSize - 64) / 4);
+  for (unsigned j = 0; j < tailWords; j++)
+    w[j] = sha256ReadBE(in + 64 + j*4);
+  w[tailWords] = 0x80000000;
+  for (unsigned j = tailWords + 1; j < 15; j++)
+    w[j] = 0;
+  w[15] = static_cast<uint32_t>(msgSize * 8);
+  sha256TransformSHANI(state, reinterpret_cast<const __m128i*>(w));
+  sha256FinalSHANI(state, state32);
+
+  // Second hash
+  for (unsigned j = 0; j < 8; j++)
+    w[j] = state32[j];
+  w[8] = 0x80000000;
+  for (unsigned j = 9; j < 15; j++)
+    w[j] = 0;
+  w[15] = 32*8;
+  sha256InitSHANI(state);
+  sha256TransformSHANI(state, reinterpret_cast<const __m128i*>(w));
+  sha256FinalSHANI(state, state32);
+
+  for (unsigned j = 0; j < 8; j++)
+    sha256WriteBE(out + j*4, state32[j]);
+}
+}
+
+void sha256d64SHANI(uint8_t *out, const uint8_t *in) { sha256dSHANI(out, in, 64); }
+void sha256d80SHANI(uint8_t *out, const uint8_t *in) { sha256dSHANI(out, in, 80); }
+#endif
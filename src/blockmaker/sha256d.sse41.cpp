@@ -0,0 +1,24 @@
+// SSE4.1 4-way double SHA256, compiled with -msse4.1
+#if defined(__x86_64__)
+#include "blockmaker/sha256d.lanes.h"
+#include <immintrin.h>
+
+namespace {
+struct CSSE41Ops {
+  using V = __m128i;
+  static constexpr unsigned Lanes = 4;
+  static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+  static inline V bxor(V a, V b) { return _mm_xor_si128(a, b); }
+  static inline V band(V a, V b) { return _mm_and_si128(a, b); }
+  static inline V bor(V a, V b) { return _mm_or_si128(a, b); }
+  template<int n> static inline V rotr(V x) { return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+  template<int n> static inline V shr(V x) { return _mm_srli_epi32(x, n); }
+  static inline V set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+  static inline V load(const uint32_t *p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+  static inline void store(uint32_t *p, V x) { _mm_store_si128(reinterpret_cast<__m128i*>(p), x); }
+};
+}
+
+void sha256d64x4SSE41(uint8_t *out, const uint8_t *in) { CSha256Lanes<CSSE41Ops>::hash(out, in, 64); }
+void sha256d80x4SSE41(uint8_t *out, const uint8_t *in) { CSha256Lanes<CSSE41Ops>::hash(out, in, 80); }
+#endif
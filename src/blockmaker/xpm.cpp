@@ -195,8 +195,33 @@ static bool EulerLagrangeLifchitzPrimalityTest(XPM::Proto::CheckConsensusCtx &ct
   return passedTest;
 }
 
+/// Loads ctx.bn into Montgomery Fermat tester, returns false for even or too long numbers
+static inline bool loadFermatTester(XPM::Proto::CheckConsensusCtx &ctx)
+{
+  return ctx.Fermat.setModulus(ctx.bn->_mp_d, static_cast<unsigned>(ctx.bn->_mp_size));
+}
+
 static unsigned primeChainLength(XPM::Proto::CheckConsensusCtx &ctx, bool isSophieGermain)
 {
+  if (loadFermatTester(ctx)) {
+    CFermatTester &tester = ctx.Fermat;
+    if (!tester.fermatTest())
+      return tester.fractionalPart(nFractionalBits);
+
+    uint32_t rationalPart = 0;
+    while (tester.next(isSophieGermain)) {
+      rationalPart++;
+      bool EulerTestPassed = tester.eulerLagrangeLifchitzTest(isSophieGermain);
+      bool FermatTestPassed = tester.fermatResultIsOne();
+      if (EulerTestPassed != FermatTestPassed)
+        return 0;
+      if (!EulerTestPassed)
+        return (rationalPart << nFractionalBits) | tester.fractionalPart(nFractionalBits);
+    }
+
+    // Chain outgrown tester limit, ctx.bn not changed, check it again with gmp
+  }
+
   if (!FermatProbablePrimalityTest(ctx))
     return fractionalPart(ctx);
 
@@ -225,6 +250,15 @@ static unsigned primeChainLength(XPM::Proto::CheckConsensusCtx &ctx, bool isSoph
   }
 }
 
+/// Length of chain with ctx.bn added before its first number
+static inline uint32_t extendedChainLength(XPM::Proto::CheckConsensusCtx &ctx, uint32_t length)
+{
+  if (loadFermatTester(ctx))
+    return ctx.Fermat.fermatTest() ? length + (1 << nFractionalBits) : ctx.Fermat.fractionalPart(nFractionalBits);
+  else
+    return FermatProbablePrimalityTest(ctx) ? length + (1 << nFractionalBits) : fractionalPart(ctx);
+}
+
 /// Get length of chain type 1 / Sophie Germain (n, 2n+1, ...)
 static inline uint32_t c1Length(XPM::Proto::CheckConsensusCtx &ctx)
 {
@@ -468,9 +502,9 @@ bool Proto::checkConsensus(const Proto::BlockHeader &header,
 
      // Calculate extended C1, C2 & bitwin chain lengths
      mpz_sub_ui(ctx.bn, ctx.bnPrimeChainOrigin, 1);
-     uint32_t l1Extended = FermatProbablePrimalityTest(ctx) ? l1 + (1 << nFractionalBits) : fractionalPart(ctx);
+     uint32_t l1Extended = extendedChainLength(ctx, l1);
      mpz_add_ui(ctx.bn, ctx.bnPrimeChainOrigin, 1);
-     uint32_t l2Extended = FermatProbablePrimalityTest(ctx) ? l2 + (1 << nFractionalBits) : fractionalPart(ctx);
+     uint32_t l2Extended = extendedChainLength(ctx, l2);
      uint32_t lbitwinExtended = bitwinLength(l1Extended, l2Extended);
      if (l1Extended > chainLength || l2Extended > chainLength || lbitwinExtended > chainLength)
        return false;
@@ -0,0 +1,103 @@
+#pragma once
+
+// Multi-buffer BLAKE2b compression function, processes Ops::Lanes messages simultaneously
+// Messages share chaining value and all block words except m[1] (Equihash index)
+// Included by equihash*.cpp files, each compiled with own instruction set flags
+// Everything here have internal linkage, so different instantiations never merged by linker
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace {
+
+constexpr uint64_t Blake2bIV[8] = {
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+constexpr uint8_t Blake2bSigma[12][16] = {
+  { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+  {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3},
+  {11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4},
+  { 7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8},
+  { 9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13},
+  { 2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9},
+  {12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11},
+  {13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10},
+  { 6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5},
+  {10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0},
+  { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+  {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3}
+};
+
+inline uint64_t blake2bReadLE(const uint8_t *p)
+{
+  uint64_t x = 0;
+  for (unsigned i = 0; i < 8; i++)
+    x |= static_cast<uint64_t>(p[i]) << (8*i);
+  return x;
+}
+
+inline void blake2bWriteLE(uint8_t *p, uint64_t x)
+{
+  for (unsigned i = 0; i < 8; i++)
+    p[i] = static_cast<uint8_t>(x >> (8*i));
+}
+
+// Ops interface:
+//   V: vector of Lanes 64-bit words
+//   add, bxor, rotr<n>, set1, load, store (aligned)
+template<typename Ops>
+struct CBlake2bLanes {
+  using V = typename Ops::V;
+
+  static inline void g(V &a, V &b, V &c, V &d, V x, V y) {
+    a = Ops::add(Ops::add(a, b), x);
+    d = Ops::template rotr<32>(Ops::bxor(d, a));
+    c = Ops::add(c, d);
+    b = Ops::template rotr<24>(Ops::bxor(b, c));
+    a = Ops::add(Ops::add(a, b), y);
+    d = Ops::template rotr<16>(Ops::bxor(d, a));
+    c = Ops::add(c, d);
+    b = Ops::template rotr<63>(Ops::bxor(b, c));
+  }
+
+  // h: chaining value; m: block words (m[1] ignored); m1: Lanes values of m[1]
+  // counter: message length including this block (up to 2^64); last: final block flag
+  // out: 8 words for each lane, word-major (out[i*Lanes + lane]), aligned as Ops::store requires
+  static void compress(uint64_t *out, const uint64_t h[8], const uint64_t m[16], const uint64_t *m1, uint64_t counter, bool last) {
+    alignas(64) uint64_t m1Words[Ops::Lanes];
+    for (unsigned i = 0; i < Ops::Lanes; i++)
+      m1Words[i] = m1[i];
+
+    V mv[16];
+    for (unsigned i = 0; i < 16; i++)
+      mv[i] = Ops::set1(m[i]);
+    mv[1] = Ops::load(m1Words);
+
+    V v[16];
+    for (unsigned i = 0; i < 8; i++) {
+      v[i] = Ops::set1(h[i]);
+      v[i+8] = Ops::set1(Blake2bIV[i]);
+    }
+    v[12] = Ops::set1(Blake2bIV[4] ^ counter);
+    v[14] = Ops::set1(last ? ~Blake2bIV[6] : Blake2bIV[6]);
+
+    for (unsigned r = 0; r < 12; r++) {
+      const uint8_t *s = Blake2bSigma[r];
+      g(v[0], v[4], v[8],  v[12], mv[s[0]],  mv[s[1]]);
+      g(v[1], v[5], v[9],  v[13], mv[s[2]],  mv[s[3]]);
+      g(v[2], v[6], v[10], v[14], mv[s[4]],  mv[s[5]]);
+      g(v[3], v[7], v[11], v[15], mv[s[6]],  mv[s[7]]);
+      g(v[0], v[5], v[10], v[15], mv[s[8]],  mv[s[9]]);
+      g(v[1], v[6], v[11], v[12], mv[s[10]], mv[s[11]]);
+      g(v[2], v[7], v[8],  v[13], mv[s[12]], mv[s[13]]);
+      g(v[3], v[4], v[9],  v[14], mv[s[14]], mv[s[15]]);
+    }
+
+    for (unsigned i = 0; i < 8; i++)
+      Ops::store(out + i*Ops::Lanes, Ops::bxor(Ops::set1(h[i]), Ops::bxor(v[i], v[i+8])));
+  }
+};
+
+}
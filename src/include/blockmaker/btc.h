@@ -45,19 +45,14 @@ public:
 
     BlockHashTy GetHash() const {
       uint256 result;
-      SHA256_CTX sha256;
-      SHA256_Init(&sha256);
-      SHA256_Update(&sha256, this, sizeof(*this));
-      SHA256_Final(result.begin(), &sha256);
-
-      SHA256_Init(&sha256);
-      SHA256_Update(&sha256, result.begin(), sizeof(result));
-      SHA256_Final(result.begin(), &sha256);
+      sha256d80(result.begin(), this, 1);
       return result;
     }
   };
 #pragma pack(pop)
 
+  static_assert(sizeof(BlockHeader) == 80, "invalid BTC block header size");
+
   struct TxIn {
     uint256 previousOutputHash;
     uint32_t previousOutputIndex;
@@ -248,7 +243,7 @@ public:
                bool segwitEnabled,
                const xmstream &witnessCommitment,
                BTC::CoinbaseTx &legacy,
-               BTC::CoinbaseTx &witness);
+               BTC::CoinbaseTx &witness) const;
 
   private:
     int64_t DevFee = 0;
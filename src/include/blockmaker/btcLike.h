@@ -6,6 +6,7 @@
 #include "serialize.h"
 #include "loguru.hpp"
 #include <openssl/rand.h>
+#include <memory>
 #include <unordered_map>
 
 namespace BTC {
@@ -141,6 +142,8 @@ struct CoinbaseTx {
   xmstream Data;
   unsigned ExtraDataOffset;
   unsigned ExtraNonceOffset;
+  // SHA256 state after processing transaction data before extra nonce
+  SHA256_CTX PrefixCtx;
 };
 
 struct TxData {
@@ -243,12 +246,41 @@ bool transactionFilter(rapidjson::Value::Array transactions, size_t txNumLimit,
 template<typename Proto, typename HeaderBuilderTy, typename CoinbaseBuilderTy, typename NotifyTy, typename PrepareForSubmitTy, typename MiningConfigTy, typename WorkerConfigTy, typename StratumMessageTy>
 class WorkTy : public StratumSingleWork<typename Proto::BlockHashTy, MiningConfigTy, WorkerConfigTy, StratumMessageTy> {
 public:
-  WorkTy(int64_t stratumWorkId, uint64_t uniqueWorkId, PoolBackend *backend, size_t backendIdx, const MiningConfigTy &miningCfg, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMessage) :
+  // Block template data, immutable after preparing
+  struct CPrepared : public CPreparedWork {
+    uint64_t Height = 0;
+    size_t TxNum = 0;
+    int64_t BlockReward = 0;
+    // Header
+    typename Proto::BlockHeader Header;
+    // ASIC boost data
+    uint32_t JobVersion;
+    // Various block template data
+    bool SegwitEnabled = false;
+    std::vector<uint256> MerklePath;
+    // Coinbase data
+    typename Proto::AddressTy MiningAddress;
+    std::string CoinbaseMessage;
+    CoinbaseBuilderTy CoinbaseBuilder;
+    xmstream WitnessCommitment;
+    CoinbaseTx CBTxLegacy;
+    CoinbaseTx CBTxWitness;
+    // Transaction data
+    xmstream TxHexData;
+    // mweb data
+    xmstream MimbleWimbleData;
+    // PoW check context
+    typename Proto::CheckConsensusCtx ConsensusCtx;
+
+    void buildCoinbaseTx(void *coinbaseData, size_t coinbaseSize, const MiningConfig &miningCfg, CoinbaseTx &legacy, CoinbaseTx &witness) const {
+      CoinbaseBuilder.build(Height, BlockReward, coinbaseData, coinbaseSize, CoinbaseMessage, MiningAddress, miningCfg, SegwitEnabled, WitnessCommitment, legacy, witness);
+    }
+  };
+
+public:
+  WorkTy(int64_t stratumWorkId, uint64_t uniqueWorkId, PoolBackend *backend, size_t backendIdx, const MiningConfigTy &miningCfg, const std::vector<uint8_t> &miningAddress, const std::string&) :
     StratumSingleWork<typename Proto::BlockHashTy, MiningConfigTy, WorkerConfigTy, StratumMessageTy>(stratumWorkId, uniqueWorkId, backend, backendIdx, miningCfg) {
-    CoinbaseMessage_ = coinbaseMessage;
     this->Initialized_ = miningAddress.size() == sizeof(typename Proto::AddressTy);
-    if (this->Initialized_)
-      memcpy(MiningAddress_.begin(), &miningAddress[0], miningAddress.size());
   }
   virtual typename Proto::BlockHashTy shareHash() override { return Header.GetHash(); }
   virtual std::string blockHash(size_t) override { return Header.GetHash().ToString(); }
@@ -259,7 +291,7 @@ public:
 
   virtual void mutate() override {
     Header.nTime = static_cast<uint32_t>(time(nullptr));
-    buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, MerklePath, this->MiningCfg_, true, this->NotifyMessage_);
+    buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, merklePath(), this->MiningCfg_, true, this->NotifyMessage_);
   }
 
   virtual CCheckStatus checkConsensus(size_t) override { return checkConsensusImpl(Header, ConsensusCtx_); }
@@ -267,17 +299,22 @@ public:
   virtual bool hasRtt(size_t) override { return ConsensusCtx_.hasRtt(); }
 
   virtual void buildNotifyMessage(bool resetPreviousWork) override {
-    buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, MerklePath, this->MiningCfg_, resetPreviousWork, this->NotifyMessage_);
+    buildNotifyMessageImpl(this, Header, JobVersion, CBTxLegacy_, merklePath(), this->MiningCfg_, resetPreviousWork, this->NotifyMessage_);
   }
 
   virtual bool prepareForSubmit(const WorkerConfigTy &workerCfg, const StratumMessageTy &msg) override {
-    return prepareForSubmitImpl(Header, JobVersion, CBTxLegacy_, CBTxWitness_, MerklePath, workerCfg, this->MiningCfg_, msg);
+    return prepareForSubmitImpl(Header, JobVersion, CBTxLegacy_, CBTxWitness_, merklePath(), workerCfg, this->MiningCfg_, msg);
   }
 
-  virtual bool loadFromTemplate(CBlockTemplate &blockTemplate, const std::string &ticker, std::string &error) override {
+  static CPreparedWork *prepare(CBlockTemplate &blockTemplate, const std::string &ticker, const MiningConfigTy &miningCfg, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMessage, std::string &error) {
+    if (miningAddress.size() != sizeof(typename Proto::AddressTy)) {
+      error = "invalid mining address";
+      return nullptr;
+    }
+
     if (!blockTemplate.Document.HasMember("result") || !blockTemplate.Document["result"].IsObject()) {
       error = "no result";
-      return false;
+      return nullptr;
     }
 
     rapidjson::Value &resultValue = blockTemplate.Document["result"];
@@ -288,69 +325,86 @@ public:
     if (!resultValue.HasMember("height") ||
         !resultValue.HasMember("transactions") || !resultValue["transactions"].IsArray()) {
       error = "missing data";
-      return false;
+      return nullptr;
     }
 
     rapidjson::Value &height = resultValue["height"];
     rapidjson::Value::Array transactions = resultValue["transactions"].GetArray();
     if (!height.IsUint64()) {
       error = "missing height";
-      return false;
+      return nullptr;
     }
 
-    this->Height_ = height.GetUint64();
+    std::unique_ptr<CPrepared> prepared(new CPrepared);
+    memcpy(prepared->MiningAddress.begin(), &miningAddress[0], miningAddress.size());
+    prepared->CoinbaseMessage = coinbaseMessage;
+    prepared->Height = height.GetUint64();
 
     // Check segwit enabled (compare txid and hash for all transactions)
-    SegwitEnabled = isSegwitEnabled(transactions);
+    prepared->SegwitEnabled = isSegwitEnabled(transactions);
 
     // Checking/filtering transactions
     int64_t blockRewardDelta = 0;
-    bool txFilter = this->MiningCfg_.TxNumLimit && transactions.Size() > this->MiningCfg_.TxNumLimit;
+    bool txFilter = miningCfg.TxNumLimit && transactions.Size() > miningCfg.TxNumLimit;
     std::vector<TxData> processedTransactions;
     bool needSortByHash = (ticker == "BCHN" || ticker == "BCHABC");
 
     bool transactionCheckResult;
     if (txFilter)
-      transactionCheckResult = transactionFilter<Proto>(transactions, this->MiningCfg_.TxNumLimit, processedTransactions, &blockRewardDelta, needSortByHash);
+      transactionCheckResult = transactionFilter<Proto>(transactions, miningCfg.TxNumLimit, processedTransactions, &blockRewardDelta, needSortByHash);
     else
       transactionCheckResult = transactionChecker(transactions, processedTransactions);
     if (!transactionCheckResult) {
       error = "template contains invalid transactions";
-      return false;
+      return nullptr;
     }
 
-    CoinbaseBuilder_.prepare(&this->BlockReward_, resultValue);
+    prepared->CoinbaseBuilder.prepare(&prepared->BlockReward, resultValue);
 
-    this->BlockReward_ -= blockRewardDelta;
+    prepared->BlockReward -= blockRewardDelta;
 
     if (txFilter)
-      LOG_F(INFO, " * [txfilter] transactions num %zu -> %zu; coinbase value %" PRIi64 " -> %" PRIi64 "", static_cast<size_t>(transactions.Size()), processedTransactions.size(), this->BlockReward_+blockRewardDelta, this->BlockReward_);
+      LOG_F(INFO, " * [txfilter] transactions num %zu -> %zu; coinbase value %" PRIi64 " -> %" PRIi64 "", static_cast<size_t>(transactions.Size()), processedTransactions.size(), prepared->BlockReward+blockRewardDelta, prepared->BlockReward);
 
     // Calculate witness commitment
-    if (SegwitEnabled) {
-      if (!calculateWitnessCommitment(resultValue, txFilter, processedTransactions, WitnessCommitment, error))
-        return false;
+    if (prepared->SegwitEnabled) {
+      if (!calculateWitnessCommitment(resultValue, txFilter, processedTransactions, prepared->WitnessCommitment, error))
+        return nullptr;
     }
 
     // Coinbase
-    buildCoinbaseTx(nullptr, 0, this->MiningCfg_, CBTxLegacy_, CBTxWitness_);
+    prepared->buildCoinbaseTx(nullptr, 0, miningCfg, prepared->CBTxLegacy, prepared->CBTxWitness);
 
     // Transactions
-    collectTransactions(processedTransactions, TxHexData, MerklePath, this->TxNum_);
+    collectTransactions(processedTransactions, prepared->TxHexData, prepared->MerklePath, prepared->TxNum);
 
     // Mimble wimble data
-    MimbleWimbleData.reset();
     if (resultValue.HasMember("mweb") && resultValue["mweb"].IsString())
-      MimbleWimbleData.write(resultValue["mweb"].GetString(), resultValue["mweb"].GetStringLength());
+      prepared->MimbleWimbleData.write(resultValue["mweb"].GetString(), resultValue["mweb"].GetStringLength());
 
     // Fill header
-    if (!HeaderBuilderTy::build(Header, &JobVersion, CBTxLegacy_, MerklePath, resultValue)) {
+    if (!HeaderBuilderTy::build(prepared->Header, &prepared->JobVersion, prepared->CBTxLegacy, prepared->MerklePath, resultValue)) {
       error = "missing header data";
-      return false;
+      return nullptr;
     }
 
-    ConsensusCtx_.initialize(blockTemplate, ticker);
-    return true;
+    prepared->ConsensusCtx.initialize(blockTemplate, ticker);
+    return prepared.release();
+  }
+
+  virtual void loadFromPrepared(const intrusive_ptr<CPreparedWork> &prepared) override {
+    Prepared_ = intrusive_ptr<CPrepared>(static_cast<CPrepared*>(prepared.get()));
+    const CPrepared *data = Prepared_.get();
+    this->Height_ = data->Height;
+    this->TxNum_ = data->TxNum;
+    this->BlockReward_ = data->BlockReward;
+
+    // Mutable copies: header and coinbase transaction modified by every share
+    Header = data->Header;
+    JobVersion = data->JobVersion;
+    copyCoinbaseTx(CBTxLegacy_, data->CBTxLegacy);
+    copyCoinbaseTx(CBTxWitness_, data->CBTxWitness);
+    ConsensusCtx_ = data->ConsensusCtx;
   }
 
   virtual double getAbstractProfitValue(size_t, double price, double coeff) override {
@@ -359,9 +413,19 @@ public:
 
 public:
   // Implementation
+  const std::vector<uint256> &merklePath() const { return Prepared_.get()->MerklePath; }
+
   /// Build & serialize custom coinbase transaction
   void buildCoinbaseTx(void *coinbaseData, size_t coinbaseSize, const MiningConfig &miningCfg, CoinbaseTx &legacy, CoinbaseTx &witness) {
-    CoinbaseBuilder_.build(this->Height_, this->BlockReward_, coinbaseData, coinbaseSize, this->CoinbaseMessage_, this->MiningAddress_, miningCfg, SegwitEnabled, WitnessCommitment, legacy, witness);
+    Prepared_.get()->buildCoinbaseTx(coinbaseData, coinbaseSize, miningCfg, legacy, witness);
+  }
+
+  static void copyCoinbaseTx(CoinbaseTx &dst, const CoinbaseTx &src) {
+    dst.Data.reset();
+    dst.Data.write(src.Data.data(), src.Data.sizeOf());
+    dst.ExtraDataOffset = src.ExtraDataOffset;
+    dst.ExtraNonceOffset = src.ExtraNonceOffset;
+    dst.PrefixCtx = src.PrefixCtx;
   }
 
   static CCheckStatus checkConsensusImpl(const typename Proto::BlockHeader &header, typename Proto::CheckConsensusCtx &consensusCtx) {
@@ -378,6 +442,7 @@ public:
   }
 
   void buildBlockImpl(typename Proto::BlockHeader &header, CoinbaseTx &witness, xmstream &blockHexData) {
+    const CPrepared *data = Prepared_.get();
     blockHexData.reset();
     {
       // Header
@@ -395,12 +460,12 @@ public:
     bin2hexLowerCase(witness.Data.data(), blockHexData.reserve<char>(witness.Data.sizeOf()*2), witness.Data.sizeOf());
 
     // Transactions
-    blockHexData.write(TxHexData.data(), TxHexData.sizeOf());
+    blockHexData.write(data->TxHexData.data(), data->TxHexData.sizeOf());
 
     // Mimble wimble
-    if (MimbleWimbleData.sizeOf()) {
+    if (data->MimbleWimbleData.sizeOf()) {
       blockHexData.write("01");
-      blockHexData.write(MimbleWimbleData.data(), MimbleWimbleData.sizeOf());
+      blockHexData.write(data->MimbleWimbleData.data(), data->MimbleWimbleData.sizeOf());
     }
   }
 
@@ -409,22 +474,13 @@ public:
   typename Proto::BlockHeader Header;
   // ASIC boost data
   uint32_t JobVersion;
-  // Various block template data
-  bool SegwitEnabled = false;
-  std::vector<uint256> MerklePath;
   // Coinbase data
-  typename Proto::AddressTy MiningAddress_;
-  std::string CoinbaseMessage_;
-  CoinbaseBuilderTy CoinbaseBuilder_;
-  xmstream WitnessCommitment;
   CoinbaseTx CBTxLegacy_;
   CoinbaseTx CBTxWitness_;
-  // Transaction data
-  xmstream TxHexData;
-  // mweb data
-  xmstream MimbleWimbleData;
   // PoW check context
   typename Proto::CheckConsensusCtx ConsensusCtx_;
+  // Shared block template data
+  intrusive_ptr<CPrepared> Prepared_;
 };
 
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "btc.h"
+#include "dgbHash.h"
+#include <memory>
+
+class OdoCrypt;
 
 namespace DGB {
 enum class Algo {
@@ -39,6 +43,11 @@ public:
     bool hasRtt() { return false; }
 
     uint32_t OdoShapechangeInterval;
+    // Per-work hash caches, filled by checkConsensus
+    CQubitPrefix QubitPrefix;
+    // Odo cipher for OdoCryptKey, its construction costs more than one encryption
+    std::shared_ptr<const OdoCrypt> Odo;
+    uint32_t OdoCryptKey = 0;
   };
 
   using ChainParams = BTC::Proto::ChainParams;
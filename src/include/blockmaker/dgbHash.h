@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// DigiByte multi-algo proof of work hashes of 80-byte block headers
+// Chained primitives (AVX2 and AES-NI or sph reference code) selected at runtime by CPU features
+
+/// Luffa-512 chaining value after first 32 bytes of header (version and beginning of previous block hash)
+/// These bytes are the same for all shares of one work, so first compression is done once per work
+struct CQubitPrefix {
+  bool Initialized = false;
+  uint8_t Data[32];
+  uint32_t Luffa[5][8];
+};
+
+/// luffa512 -> cubehash512 -> shavite512 -> simd512 -> echo512, first 32 bytes of result
+/// Recalculates prefix if header does not start with prefix data
+void qubitHash(void *out, CQubitPrefix &prefix, const void *header);
+
+/// Name of selected implementation
+const char *dgbHashImplementation();
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Equihash solution verification (ZCash BLAKE2b personalization "ZcashPoW")
+// BLAKE2b implementation (AVX-512 8-way, AVX2 4-way or scalar) selected at runtime by CPU features
+// Supported parameters: 200,9 and 48,5
+
+/// Size of header part hashed before solution: version, prev block, merkle root, reserved, time, bits, nonce
+static constexpr size_t EquihashInputSize = 140;
+
+/// Returns false for invalid solution and for unsupported parameters
+bool equihashVerify(unsigned n, unsigned k, const uint8_t *input, const uint8_t *solution, size_t solutionSize);
+
+/// Name of selected BLAKE2b implementation
+const char *equihashImplementation();
@@ -102,6 +102,17 @@ public:
   using CSingleWork = StratumSingleWork<Proto::BlockHashTy, MiningConfig, WorkerConfig, StratumMessage>;
 
   class Work : public CSingleWork {
+  public:
+    // Block template data, immutable after preparing
+    struct CPrepared : public CPreparedWork {
+      std::string HeaderHashHex;
+      std::string SeedHashHex;
+      uint256 HeaderHash;
+      arith_uint256 Target;
+      uint64_t Height = 0;
+      intrusive_ptr<EthashDagWrapper> DagFile;
+    };
+
   public:
     Work(int64_t stratumWorkId, uint64_t uniqueWorkId, PoolBackend *backend, size_t backendIdx, const MiningConfig &miningCfg, const std::vector<uint8_t>&, const std::string&) :
       CSingleWork(stratumWorkId, uniqueWorkId, backend, backendIdx, miningCfg) {
@@ -139,7 +150,14 @@ public:
 
     virtual void buildNotifyMessage(bool resetPreviousWork) override;
 
-    virtual bool loadFromTemplate(CBlockTemplate &blockTemplate, const std::string &ticker, std::string &error) override;
+    static CPreparedWork *prepare(CBlockTemplate &blockTemplate, const std::string &ticker, const MiningConfig &miningCfg, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMessage, std::string &error);
+
+    virtual void loadFromPrepared(const intrusive_ptr<CPreparedWork> &prepared) override {
+      Prepared_ = intrusive_ptr<CPrepared>(static_cast<CPrepared*>(prepared.get()));
+      Height_ = Prepared_.get()->Height;
+      // Block reward can't be calculated at this moment
+      BlockReward_ = 0;
+    }
 
     virtual bool prepareForSubmit(const WorkerConfig&workerCfg, const StratumMessage&msg) override;
 
@@ -149,14 +167,10 @@ public:
     }
 
   private:
-    std::string HeaderHashHex_;
-    std::string SeedHashHex_;
-    uint256 HeaderHash_;
-    arith_uint256 Target_;
+    intrusive_ptr<CPrepared> Prepared_;
     uint64_t Nonce_ = 0;
     arith_uint256 FinalHash_;
     uint256 MixHash_;
-    intrusive_ptr<EthashDagWrapper> DagFile_;
   };
 
   static constexpr bool MergedMiningSupport = false;
@@ -11,4 +11,8 @@ typedef struct EthashDag {
 
 int ethashGetEpochNumber(void *seed);
 EthashDag *ethashCreateDag(int epochNumber, int bigEpoch);
-void ethashCalculate(void *finalHash, void *mixHash, const void *headerHash, uint64_t nonce, const EthashDag *context);
+uint64_t ethashGetFullDatasetSize(const EthashDag *context);
+// Calculates full dataset items [begin, end), 'items' must have space for (end-begin)*128 bytes
+void ethashCalculateDatasetItems(uint32_t *items, const EthashDag *context, uint32_t begin, uint32_t end);
+// Uses precalculated full dataset if 'fullDataset' is not null, light cache otherwise
+void ethashCalculate(void *finalHash, void *mixHash, const void *headerHash, uint64_t nonce, const EthashDag *context, const uint32_t *fullDataset);
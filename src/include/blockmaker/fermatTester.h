@@ -0,0 +1,297 @@
+#pragma once
+
+#include <stdint.h>
+
+// Base 2 Fermat and Euler-Lagrange-Lifchitz tests for prime chain numbers
+// Works with odd numbers up to MaxLimbs*64 bits (256-bit header hash with multiplier), without heap allocations:
+//   Montgomery squaring on fixed-size arrays, loops length known at compile time
+//   multiplication by base 2 replaced by modular doubling
+// Longer numbers should be checked with gmp, its assembly kernels are faster there
+// Chain members tested one after another with same modulus buffer, next() builds next chain member in place
+class CFermatTester {
+public:
+  static constexpr unsigned MaxLimbs = 7;
+
+public:
+  // Returns false for even or too long number, test can't be done in this case
+  template<typename Limb> bool setModulus(const Limb *limbs, unsigned limbsNum) {
+    static_assert(sizeof(Limb) == sizeof(uint64_t), "64-bit limbs required");
+    while (limbsNum && !limbs[limbsNum-1])
+      limbsNum--;
+
+    Limbs_ = 0;
+    if (limbsNum == 0 || limbsNum > MaxLimbs || !(limbs[0] & 1))
+      return false;
+
+    for (unsigned i = 0; i < limbsNum; i++)
+      N_[i] = limbs[i];
+    Limbs_ = limbsNum;
+    return true;
+  }
+
+  /// Next number in Cunningham chain: 1CC (Sophie Germain) n = 2n + 1, 2CC n = 2n - 1
+  /// Returns false if result does not fit into MaxLimbs
+  bool next(bool isSophieGermain) {
+    uint64_t carry = 0;
+    for (unsigned i = 0; i < Limbs_; i++) {
+      uint64_t limb = N_[i];
+      N_[i] = (limb << 1) | carry;
+      carry = limb >> 63;
+    }
+
+    if (carry) {
+      if (Limbs_ == MaxLimbs) {
+        Limbs_ = 0;
+        return false;
+      }
+      N_[Limbs_++] = carry;
+    }
+
+    if (isSophieGermain) {
+      N_[0] |= 1;
+    } else {
+      for (unsigned i = 0; i < Limbs_ && N_[i]-- == 0; i++)
+        continue;
+      if (N_[Limbs_-1] == 0)
+        Limbs_--;
+    }
+
+    return true;
+  }
+
+  /// FermatResult = 2^(n-1) mod n
+  bool fermatTest() {
+    exponentiate(false);
+    return fermatResultIsOne();
+  }
+
+  /// EulerResult = 2^((n-1)/2) mod n, FermatResult = (EulerResult ^ 2) mod n
+  bool eulerLagrangeLifchitzTest(bool isSophieGermain) {
+    exponentiate(true);
+    unsigned mod8 = N_[0] % 8;
+    if (isSophieGermain && mod8 == 7)
+      return isOne(EulerResult_);
+    else if (isSophieGermain && mod8 == 3)
+      return isMinusOne(EulerResult_);
+    else if (!isSophieGermain && mod8 == 5)
+      return isMinusOne(EulerResult_);
+    else if (!isSophieGermain && mod8 == 1)
+      return isOne(EulerResult_);
+    else
+      return false;
+  }
+
+  bool fermatResultIsOne() const { return isOne(FermatResult_); }
+
+  /// ((n - FermatResult) << bits) / n, quotient calculated by binary long division
+  uint32_t fractionalPart(unsigned bits) const {
+    uint64_t remainder[MaxLimbs];
+    sub(remainder, N_, FermatResult_, Limbs_);
+
+    uint32_t quotient = 0;
+    for (unsigned i = 0; i < bits; i++) {
+      uint64_t carry = 0;
+      for (unsigned j = 0; j < Limbs_; j++) {
+        uint64_t limb = remainder[j];
+        remainder[j] = (limb << 1) | carry;
+        carry = limb >> 63;
+      }
+
+      quotient <<= 1;
+      if (carry || !less(remainder, N_, Limbs_)) {
+        sub(remainder, remainder, N_, Limbs_);
+        quotient |= 1;
+      }
+    }
+
+    return quotient & ((1u << bits) - 1);
+  }
+
+private:
+  static bool less(const uint64_t *a, const uint64_t *b, unsigned limbsNum) {
+    for (unsigned i = limbsNum; i-- > 0;) {
+      if (a[i] != b[i])
+        return a[i] < b[i];
+    }
+    return false;
+  }
+
+  static uint64_t sub(uint64_t *r, const uint64_t *a, const uint64_t *b, unsigned limbsNum) {
+    uint64_t borrow = 0;
+    for (unsigned i = 0; i < limbsNum; i++) {
+      unsigned __int128 diff = (unsigned __int128)a[i] - b[i] - borrow;
+      r[i] = static_cast<uint64_t>(diff);
+      borrow = static_cast<uint64_t>(diff >> 64) & 1;
+    }
+    return borrow;
+  }
+
+  bool isOne(const uint64_t *x) const {
+    if (x[0] != 1)
+      return false;
+    for (unsigned i = 1; i < Limbs_; i++) {
+      if (x[i])
+        return false;
+    }
+    return true;
+  }
+
+  // x == n - 1, n is odd
+  bool isMinusOne(const uint64_t *x) const {
+    if (x[0] != N_[0] - 1)
+      return false;
+    for (unsigned i = 1; i < Limbs_; i++) {
+      if (x[i] != N_[i])
+        return false;
+    }
+    return true;
+  }
+
+  // x = 2x mod n
+  template<unsigned LimbsNum> void modDouble(uint64_t *x) const {
+    uint64_t carry = 0;
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      uint64_t limb = x[i];
+      x[i] = (limb << 1) | carry;
+      carry = limb >> 63;
+    }
+    if (carry || !less(x, N_, LimbsNum))
+      sub(x, x, N_, LimbsNum);
+  }
+
+  // x = x*x/R mod n, R = 2^(64*LimbsNum)
+  // Full square (symmetric products calculated once) with following Montgomery reduction
+  template<unsigned LimbsNum> void montSqr(uint64_t *x, uint64_t nInv) const {
+    uint64_t t[2*LimbsNum] = {};
+
+    // Off-diagonal products
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      uint64_t carry = 0;
+      for (unsigned j = i+1; j < LimbsNum; j++) {
+        unsigned __int128 acc = (unsigned __int128)x[i] * x[j] + t[i+j] + carry;
+        t[i+j] = static_cast<uint64_t>(acc);
+        carry = static_cast<uint64_t>(acc >> 64);
+      }
+      t[i+LimbsNum] = carry;
+    }
+
+    // Double and add diagonal
+    uint64_t shifted = 0;
+    uint64_t carry = 0;
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      unsigned __int128 square = (unsigned __int128)x[i] * x[i];
+      uint64_t lo = (t[2*i] << 1) | shifted;
+      uint64_t hi = (t[2*i+1] << 1) | (t[2*i] >> 63);
+      shifted = t[2*i+1] >> 63;
+      unsigned __int128 acc = (unsigned __int128)lo + static_cast<uint64_t>(square) + carry;
+      t[2*i] = static_cast<uint64_t>(acc);
+      acc = (unsigned __int128)hi + static_cast<uint64_t>(square >> 64) + static_cast<uint64_t>(acc >> 64);
+      t[2*i+1] = static_cast<uint64_t>(acc);
+      carry = static_cast<uint64_t>(acc >> 64);
+    }
+
+    // Reduction, upper half of t holds result
+    uint64_t topCarry = 0;
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      uint64_t m = t[i] * nInv;
+      uint64_t carry = 0;
+      for (unsigned j = 0; j < LimbsNum; j++) {
+        unsigned __int128 acc = (unsigned __int128)m * N_[j] + t[i+j] + carry;
+        t[i+j] = static_cast<uint64_t>(acc);
+        carry = static_cast<uint64_t>(acc >> 64);
+      }
+      unsigned __int128 acc = (unsigned __int128)t[i+LimbsNum] + carry + topCarry;
+      t[i+LimbsNum] = static_cast<uint64_t>(acc);
+      topCarry = static_cast<uint64_t>(acc >> 64);
+    }
+
+    uint64_t *result = t + LimbsNum;
+    if (topCarry || !less(result, N_, LimbsNum))
+      sub(result, result, N_, LimbsNum);
+    for (unsigned i = 0; i < LimbsNum; i++)
+      x[i] = result[i];
+  }
+
+  // x = x/R mod n, conversion from Montgomery form
+  template<unsigned LimbsNum> void montReduce(uint64_t *r, const uint64_t *x, uint64_t nInv) const {
+    uint64_t t[2*LimbsNum];
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      t[i] = x[i];
+      t[i+LimbsNum] = 0;
+    }
+
+    for (unsigned i = 0; i < LimbsNum; i++) {
+      uint64_t m = t[i] * nInv;
+      uint64_t carry = 0;
+      for (unsigned j = 0; j < LimbsNum; j++) {
+        unsigned __int128 acc = (unsigned __int128)m * N_[j] + t[i+j] + carry;
+        t[i+j] = static_cast<uint64_t>(acc);
+        carry = static_cast<uint64_t>(acc >> 64);
+      }
+      t[i+LimbsNum] = carry;
+    }
+
+    // x < n, so result < n
+    for (unsigned i = 0; i < LimbsNum; i++)
+      r[i] = t[i+LimbsNum];
+  }
+
+  template<unsigned LimbsNum> void exponentiate(bool euler) {
+    // -n^-1 mod 2^64, Newton iterations double number of correct bits starting from 3
+    uint64_t inv = N_[0];
+    for (unsigned i = 0; i < 5; i++)
+      inv *= 2 - N_[0]*inv;
+    inv = 0 - inv;
+
+    unsigned topBit = 63 - __builtin_clzll(N_[LimbsNum-1]);
+    unsigned bitsNum = (LimbsNum-1)*64 + topBit + 1;
+
+    // Montgomery form of 1: R mod n, doubling of highest power of 2 less than n
+    uint64_t x[MaxLimbs] = {};
+    x[LimbsNum-1] = static_cast<uint64_t>(1) << topBit;
+    for (unsigned i = bitsNum - 1; i < LimbsNum*64; i++)
+      modDouble<LimbsNum>(x);
+
+    // Exponent: n - 1 for Fermat test, (n - 1) / 2 for Euler test
+    uint64_t exponent[MaxLimbs];
+    for (unsigned i = 0; i < LimbsNum; i++)
+      exponent[i] = N_[i];
+    exponent[0] &= ~static_cast<uint64_t>(1);
+    unsigned exponentBits = bitsNum;
+    if (euler) {
+      for (unsigned i = 0; i < LimbsNum; i++)
+        exponent[i] = (exponent[i] >> 1) | (i+1 < LimbsNum ? exponent[i+1] << 63 : 0);
+      exponentBits--;
+    }
+
+    for (unsigned i = exponentBits; i-- > 0;) {
+      montSqr<LimbsNum>(x, inv);
+      if ((exponent[i/64] >> (i%64)) & 1)
+        modDouble<LimbsNum>(x);
+    }
+
+    if (euler) {
+      montReduce<LimbsNum>(EulerResult_, x, inv);
+      montSqr<LimbsNum>(x, inv);
+    }
+    montReduce<LimbsNum>(FermatResult_, x, inv);
+  }
+
+  void exponentiate(bool euler) {
+    switch (Limbs_) {
+      case 1 : exponentiate<1>(euler); break;
+      case 2 : exponentiate<2>(euler); break;
+      case 3 : exponentiate<3>(euler); break;
+      case 4 : exponentiate<4>(euler); break;
+      case 5 : exponentiate<5>(euler); break;
+      case 6 : exponentiate<6>(euler); break;
+      case 7 : exponentiate<7>(euler); break;
+    }
+  }
+
+private:
+  unsigned Limbs_ = 0;
+  uint64_t N_[MaxLimbs];
+  uint64_t FermatResult_[MaxLimbs];
+  uint64_t EulerResult_[MaxLimbs];
+};
@@ -5,31 +5,33 @@
 
 #pragma once
 
+#include "blockmaker/sha256d.h"
 #include "blockmaker/xvector.h"
 #include "poolcommon/uint256.h"
 #include "openssl/sha.h"
 #include <memory>
 
+/// Hash pairs of merkle tree level in place, returns size of next level
+static inline size_t merkleTreeNextLevel(uint256 *hashes, size_t txNum)
+{
+  // Pairs are adjacent in memory, hash all full pairs with one batch
+  size_t pairsNum = txNum / 2;
+  sha256d64(hashes[0].begin(), hashes[0].begin(), pairsNum);
+  if (txNum % 2) {
+    // Last hash without pair, concatenate with itself
+    uint256 pair[2] = {hashes[txNum-1], hashes[txNum-1]};
+    sha256d64(hashes[pairsNum].begin(), pair[0].begin(), 1);
+  }
+
+  return pairsNum + (txNum % 2);
+}
+
 static inline uint256 calculateMerkleRoot(uint256 *hashes, size_t size)
 {
   if (size) {
     size_t txNum = size;
-    SHA256_CTX sha256;
-    while (txNum > 1) {
-      size_t iterNum = (txNum / 2) + (txNum % 2);
-      for (size_t i = 0; i < iterNum; i++) {
-        SHA256_Init(&sha256);
-        SHA256_Update(&sha256, hashes[i*2].begin(), sizeof(uint256));
-        SHA256_Update(&sha256, hashes[i*2+1 < txNum ? i*2+1 : i*2].begin(), sizeof(uint256));
-        SHA256_Final(hashes[i].begin(), &sha256);
-
-        SHA256_Init(&sha256);
-        SHA256_Update(&sha256, hashes[i].begin(), sizeof(uint256));
-        SHA256_Final(hashes[i].begin(), &sha256);
-      }
-
-      txNum = iterNum;
-    }
+    while (txNum > 1)
+      txNum = merkleTreeNextLevel(hashes, txNum);
 
     return hashes[0];
   } else {
@@ -42,21 +44,15 @@ static inline uint256 calculateMerkleRoot(uint256 *hashes, size_t size)
 
 static inline uint256 calculateMerkleRoot(uint256 hash, const uint256 *begin, size_t size)
 {
-  SHA256_CTX sha256;
-  uint256 result(hash);
+  uint256 pair[2];
+  pair[0] = hash;
 
   for (size_t i = 0; i != size; ++i) {
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, result.begin(), result.size());
-    SHA256_Update(&sha256, begin[i].begin(), begin[i].size());
-    SHA256_Final(result.begin(), &sha256);
-
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, result.begin(), result.size());
-    SHA256_Final(result.begin(), &sha256);
+    pair[1] = begin[i];
+    sha256d64(pair[0].begin(), pair[0].begin(), 1);
   }
 
-  return result;
+  return pair[0];
 }
 
 static inline uint256 calculateMerkleRoot(const void *data, size_t size, const std::vector<uint256> &merklePath)
@@ -72,6 +68,20 @@ static inline uint256 calculateMerkleRoot(const void *data, size_t size, const s
   return calculateMerkleRoot(result, &merklePath[0], merklePath.size());
 }
 
+/// Merkle root for transaction with already hashed prefix
+/// prefixCtx: SHA256 state after processing prefix, not modified
+static inline uint256 calculateMerkleRoot(const SHA256_CTX &prefixCtx, const void *suffix, size_t suffixSize, const std::vector<uint256> &merklePath)
+{
+  uint256 result;
+  SHA256_CTX sha256 = prefixCtx;
+  SHA256_Update(&sha256, suffix, suffixSize);
+  SHA256_Final(result.begin(), &sha256);
+  SHA256_Init(&sha256);
+  SHA256_Update(&sha256, result.begin(), result.size());
+  SHA256_Final(result.begin(), &sha256);
+  return calculateMerkleRoot(result, merklePath.data(), merklePath.size());
+}
+
 static inline void dumpMerkleTree(std::vector<uint256> &hashes, std::vector<uint256> &out)
 {
   out.clear();
@@ -79,23 +89,9 @@ static inline void dumpMerkleTree(std::vector<uint256> &hashes, std::vector<uint
     return;
 
   size_t txNum = hashes.size();
-
-  SHA256_CTX sha256;
   while (txNum > 1) {
-    size_t iterNum = (txNum / 2) + (txNum % 2);
     // dump second hash
     out.push_back(hashes[1]);
-    for (size_t i = 0; i < iterNum; i++) {
-      SHA256_Init(&sha256);
-      SHA256_Update(&sha256, hashes[i*2].begin(), sizeof(uint256));
-      SHA256_Update(&sha256, hashes[i*2+1 < txNum ? i*2+1 : i*2].begin(), sizeof(uint256));
-      SHA256_Final(hashes[i].begin(), &sha256);
-
-      SHA256_Init(&sha256);
-      SHA256_Update(&sha256, hashes[i].begin(), sizeof(uint256));
-      SHA256_Final(hashes[i].begin(), &sha256);
-    }
-
-    txNum = iterNum;
+    txNum = merkleTreeNextLevel(hashes.data(), txNum);
   }
 }
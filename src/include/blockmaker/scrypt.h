@@ -35,23 +35,14 @@
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
+/* SSE2 kernel on x86_64, generic otherwise */
 void scrypt_1024_1_1_256(const char *input, char *output);
-void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
-#if defined(USE_SSE2)
-#include <string>
-#if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
-#define USE_SSE2_ALWAYS 1
-#define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_sse2((input), (output), (scratchpad))
-#else
-#define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_detected((input), (output), (scratchpad))
-#endif
+void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
-std::string scrypt_detect_sse2();
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCRYPT_X86_64 1
 void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchpad);
-extern void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output, char *scratchpad);
-#else
-#define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_generic((input), (output), (scratchpad))
 #endif
 
 void
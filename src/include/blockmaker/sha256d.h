@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Double SHA256 for batches of fixed size messages
+// Implementation (SHA-NI, AVX-512, AVX2, SSE4.1 or scalar) selected at runtime by CPU features
+// Results written with 32 bytes stride; out can point to in, i-th result written after reading i-th message
+
+/// 64-byte messages (merkle tree nodes)
+void sha256d64(void *out, const void *in, size_t count);
+/// 80-byte messages (block headers)
+void sha256d80(void *out, const void *in, size_t count);
+
+/// Name of selected implementation
+const char *sha256dImplementation();
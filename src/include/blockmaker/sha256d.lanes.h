@@ -0,0 +1,148 @@
+#pragma once
+
+// Multi-buffer double SHA256 kernel, processes Ops::Lanes messages simultaneously
+// Included by sha256d*.cpp files, each compiled with own instruction set flags
+// Everything here have internal linkage, so different instantiations never merged by linker
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace {
+
+constexpr uint32_t Sha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+constexpr uint32_t Sha256H[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t sha256ReadBE(const uint8_t *p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void sha256WriteBE(uint8_t *p, uint32_t x)
+{
+  p[0] = static_cast<uint8_t>(x >> 24);
+  p[1] = static_cast<uint8_t>(x >> 16);
+  p[2] = static_cast<uint8_t>(x >> 8);
+  p[3] = static_cast<uint8_t>(x);
+}
+
+// Ops interface:
+//   V, Lanes
+//   add, bxor, band, bor, rotr<n>, shr<n>, set1
+//   load (Lanes words from aligned array), store
+template<typename Ops>
+class CSha256Lanes {
+public:
+  using V = typename Ops::V;
+  static constexpr unsigned Lanes = Ops::Lanes;
+
+  /// Double SHA256 of Lanes messages with size 64 or 80 bytes
+  static void hash(uint8_t *out, const uint8_t *in, size_t msgSize) {
+    alignas(64) uint32_t tmp[Lanes];
+    V w[16];
+    V s[8];
+
+    // First block
+    for (unsigned j = 0; j < 16; j++)
+      w[j] = loadWord(tmp, in, msgSize, j*4);
+    init(s);
+    transform(s, w);
+
+    // Second block: message tail & padding
+    if (msgSize == 80) {
+      for (unsigned j = 0; j < 4; j++)
+        w[j] = loadWord(tmp, in, msgSize, 64 + j*4);
+      w[4] = Ops::set1(0x80000000);
+      for (unsigned j = 5; j < 15; j++)
+        w[j] = Ops::set1(0);
+      w[15] = Ops::set1(80*8);
+    } else {
+      w[0] = Ops::set1(0x80000000);
+      for (unsigned j = 1; j < 15; j++)
+        w[j] = Ops::set1(0);
+      w[15] = Ops::set1(64*8);
+    }
+    transform(s, w);
+
+    // Second hash
+    for (unsigned j = 0; j < 8; j++)
+      w[j] = s[j];
+    w[8] = Ops::set1(0x80000000);
+    for (unsigned j = 9; j < 15; j++)
+      w[j] = Ops::set1(0);
+    w[15] = Ops::set1(32*8);
+    init(s);
+    transform(s, w);
+
+    for (unsigned j = 0; j < 8; j++) {
+      Ops::store(tmp, s[j]);
+      for (unsigned i = 0; i < Lanes; i++)
+        sha256WriteBE(out + i*32 + j*4, tmp[i]);
+    }
+  }
+
+private:
+  static inline V loadWord(uint32_t *tmp, const uint8_t *in, size_t msgSize, size_t offset) {
+    for (unsigned i = 0; i < Lanes; i++)
+      tmp[i] = sha256ReadBE(in + i*msgSize + offset);
+    return Ops::load(tmp);
+  }
+
+  static inline void init(V s[8]) {
+    for (unsigned i = 0; i < 8; i++)
+      s[i] = Ops::set1(Sha256H[i]);
+  }
+
+  static inline V ch(V x, V y, V z) { return Ops::bxor(z, Ops::band(x, Ops::bxor(y, z))); }
+  static inline V maj(V x, V y, V z) { return Ops::bor(Ops::band(x, y), Ops::band(z, Ops::bor(x, y))); }
+  static inline V ep0(V x) { return Ops::bxor(Ops::bxor(Ops::template rotr<2>(x), Ops::template rotr<13>(x)), Ops::template rotr<22>(x)); }
+  static inline V ep1(V x) { return Ops::bxor(Ops::bxor(Ops::template rotr<6>(x), Ops::template rotr<11>(x)), Ops::template rotr<25>(x)); }
+  static inline V sig0(V x) { return Ops::bxor(Ops::bxor(Ops::template rotr<7>(x), Ops::template rotr<18>(x)), Ops::template shr<3>(x)); }
+  static inline V sig1(V x) { return Ops::bxor(Ops::bxor(Ops::template rotr<17>(x), Ops::template rotr<19>(x)), Ops::template shr<10>(x)); }
+
+  static inline void transform(V s[8], V w[16]) {
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (unsigned i = 0; i < 64; i++) {
+      V x;
+      if (i < 16) {
+        x = w[i];
+      } else {
+        x = Ops::add(Ops::add(sig1(w[(i-2) & 15]), w[(i-7) & 15]), Ops::add(sig0(w[(i-15) & 15]), w[i & 15]));
+        w[i & 15] = x;
+      }
+
+      V t1 = Ops::add(Ops::add(Ops::add(h, ep1(e)), Ops::add(ch(e, f, g), Ops::set1(Sha256K[i]))), x);
+      V t2 = Ops::add(ep0(a), maj(a, b, c));
+      h = g;
+      g = f;
+      f = e;
+      e = Ops::add(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = Ops::add(t1, t2);
+    }
+
+    s[0] = Ops::add(s[0], a);
+    s[1] = Ops::add(s[1], b);
+    s[2] = Ops::add(s[2], c);
+    s[3] = Ops::add(s[3], d);
+    s[4] = Ops::add(s[4], e);
+    s[5] = Ops::add(s[5], f);
+    s[6] = Ops::add(s[6], g);
+    s[7] = Ops::add(s[7], h);
+  }
+};
+
+}
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "poolcore/blockTemplate.h"
+#include "poolcommon/intrusive_ptr.h"
 #include "p2putils/xmstream.h"
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -22,6 +24,18 @@ struct CCheckStatus {
 
 };
 
+/// Immutable data extracted from block template
+/// Built once per template on one thread and shared by works of all stratum threads
+class CPreparedWork {
+public:
+  virtual ~CPreparedWork() {}
+  uintptr_t ref_fetch_add(uintptr_t count) const { return Refs_.fetch_add(count); }
+  uintptr_t ref_fetch_sub(uintptr_t count) const { return Refs_.fetch_sub(count); }
+
+private:
+  mutable std::atomic<uintptr_t> Refs_ = 0;
+};
+
 template<typename BlockHashTy, typename MiningConfig, typename WorkerConfig, typename StratumMessage>
 class StratumMergedWork;
 class PoolBackend;
@@ -75,7 +89,9 @@ public:
   virtual size_t txNum(size_t) final { return TxNum_; }
   virtual int64_t blockReward(size_t) final { return BlockReward_; }
 
-  virtual bool loadFromTemplate(CBlockTemplate &blockTemplate, const std::string &ticker, std::string &error) = 0;
+  // Derived classes also implement static function for building shared work data:
+  // static CPreparedWork *prepare(CBlockTemplate&, const std::string &ticker, const MiningConfig&, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMessage, std::string &error);
+  virtual void loadFromPrepared(const intrusive_ptr<CPreparedWork> &prepared) = 0;
 
   virtual ~StratumSingleWork() {
     for (auto work: LinkedWorks_)
@@ -155,6 +171,10 @@ public:
                          const MiningConfig &miningCfg,
                          const std::vector<uint8_t>&,
                          const std::string&) : StratumSingleWork<BlockHashTy, MiningConfig, WorkerConfig, StratumMessage>(stratumWorkId, uniqueWorkId, backend, backendId, miningCfg) {}
+  static CPreparedWork *prepare(CBlockTemplate&, const std::string&, const MiningConfig&, const std::vector<uint8_t>&, const std::string&, std::string &error) {
+    error = "work type not supports block templates";
+    return nullptr;
+  }
   virtual BlockHashTy shareHash() final { return BlockHashTy(); }
   virtual std::string blockHash(size_t) final { return std::string(); }
   virtual double expectedWork(size_t) final { return 0.0; }
@@ -164,7 +184,7 @@ public:
   virtual CCheckStatus checkConsensus(size_t) final { return CCheckStatus(); }
   virtual void buildNotifyMessage(bool) final {}
   virtual bool prepareForSubmit(const WorkerConfig&, const StratumMessage&) final { return false; }
-  virtual bool loadFromTemplate(CBlockTemplate&, const std::string&, std::string&) final { return false; }
+  virtual void loadFromPrepared(const intrusive_ptr<CPreparedWork>&) final {}
   virtual double getAbstractProfitValue(size_t, double, double) final { return 0.0; }
   virtual bool resetNotRecommended() final { return false; }
   virtual bool hasRtt(size_t) final { return false; }
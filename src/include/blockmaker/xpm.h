@@ -7,6 +7,7 @@
 
 #include "blockmaker/btc.h"
 #include "blockmaker/divisionChecker.h"
+#include "blockmaker/fermatTester.h"
 #include "poolcommon/bigNum.h"
 #include "poolinstances/protocol.pb.h"
 #include <deque>
@@ -80,6 +81,7 @@ public:
     mpz_t EulerResult;
     mpz_t FermatResult;
     mpz_t two;
+    CFermatTester Fermat;
   };
 
   struct ChainParams {
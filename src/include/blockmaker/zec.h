@@ -322,7 +322,7 @@ public:
                bool,
                const xmstream&,
                BTC::CoinbaseTx &legacy,
-               BTC::CoinbaseTx &witness);
+               BTC::CoinbaseTx &witness) const;
 
   private:
     Proto::Transaction CoinbaseTx;
@@ -24,6 +24,9 @@ public:
   ssize_t read(void *data, size_t offset, size_t size);
   ssize_t write(const void *data, size_t size);
   ssize_t write(const void *data, size_t offset, size_t size);
+  // Append without flushing to disk, use sync() for durability
+  ssize_t writeNoSync(const void *data, size_t size);
+  bool sync();
   bool truncate(size_t size);
 
   bool isOpened();
@@ -4,6 +4,7 @@
 #include "poolcommon/serialize.h"
 #include "backendData.h"
 #include "statistics.h"
+#include "pplnsWindow.h"
 #include "usermgr.h"
 #include "poolcommon/file.h"
 #include "poolcommon/multiCall.h"
@@ -16,6 +17,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 class p2pNode;
 class p2pPeer;
@@ -88,7 +90,7 @@ private:
     TaskShare(CShare *share) : Share_(share) {}
     void run(AccountingDb *accounting) final { accounting->addShare(*Share_); }
   private:
-    std::unique_ptr<CShare> Share_;
+    CSharePtr Share_;
   };
 
   class TaskManualPayout : public Task<AccountingDb> {
@@ -129,6 +131,19 @@ private:
     PoolLuckCallback Callback_;
   };
 
+private:
+  struct CLuckPrefix {
+    int64_t Time;
+    double AccumulatedWork;
+    double ExpectedWork;
+  };
+
+  enum EBatchBuildResult {
+    EBatchOk = 0,
+    EBatchFailed,
+    EBatchUnsupported
+  };
+
 private:
   asyncBase *Base_;
   const PoolBackendConfig &_cfg;
@@ -144,9 +159,12 @@ private:
   std::unordered_set<std::string> KnownTransactions_;
 
   int64_t LastBlockTime_ = 0;
+  PoolTotalsRecord Totals_;
+  // Prefix sums of found blocks work ordered by time, luck for any interval is difference of two elements
+  std::vector<CLuckPrefix> LuckPrefix_;
+  uint64_t LuckPrefixHeight_ = 0;
   std::deque<CAccountingFile> AccountingDiskStorage_;
-  std::map<std::string, double> CurrentScores_;
-  std::vector<StatisticDb::CStatsExportData> RecentStats_;
+  CPPLNSWindow PPLNSWindow_;
   CFlushInfo FlushInfo_;
 
   // Debugging only
@@ -162,11 +180,14 @@ private:
   kvdb<rocksdbBase> _foundBlocksDb;
   kvdb<rocksdbBase> _poolBalanceDb;
   kvdb<rocksdbBase> _payoutDb;
+  kvdb<rocksdbBase> _poolTotalsDb;
   
   uint64_t LastKnownShareId_ = 0;
   
   TaskHandlerCoroutine<AccountingDb> TaskHandler_;
   aioUserEvent *FlushTimerEvent_;
+  // Node client can't build transaction with many outputs
+  bool BatchPayoutsUnsupported_ = false;
   bool ShutdownRequested_ = false;
   bool FlushFinished_ = false;
 
@@ -195,11 +216,16 @@ public:
   void replayShare(const CShare &share);
   void initializationFinish(int64_t timeLabel);
   void mergeRound(const Round *round);
+  void loadTotals();
+  void addLuckPrefix(uint64_t height, int64_t time, double accumulatedWork, double expectedWork);
   void checkBlockConfirmations();
   void checkBlockExtraInfo();
+  bool checkPayoutRecipient(const PayoutDbRecord &payout, unsigned index, std::string &recipient);
+  bool correctPayoutValue(PayoutDbRecord &payout, int64_t delta);
   void buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout);
+  EBatchBuildResult buildBatchTransaction(PayoutDbRecord **batch, const std::string *recipients, size_t size);
   bool sendTransaction(PayoutDbRecord &payout);
-  bool checkTxConfirmations(PayoutDbRecord &payout);
+  bool checkTxConfirmations(PayoutDbRecord &payout, const CNetworkClient::GetTxConfirmationsQuery &tx);
   void makePayout();
   void checkBalance();
   
@@ -209,6 +235,12 @@ public:
   kvdb<rocksdbBase> &getPayoutDb() { return _payoutDb; }
   kvdb<rocksdbBase> &getBalanceDb() { return _balanceDb; }
 
+  double getTotalWorkDone() { return Totals_.AccumulatedWork; }
+  uint64_t getTotalBlocksFound() { return Totals_.BlocksFound; }
+  int64_t getTotalPaidOut() { return Totals_.PaidOut; }
+  double getExpectedBlockTime();
+  int getTimeSinceLastBlock();
+
   const std::map<std::string, UserBalanceRecord> &getUserBalanceMap() { return _balanceMap; }
 
   // Asynchronous api
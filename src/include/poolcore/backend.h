@@ -60,7 +60,7 @@ private:
     TaskShare(CShare *share) : Share_(share) {}
     void run(PoolBackend *backend) final { backend->onShare(Share_.get()); }
   private:
-    std::unique_ptr<CShare> Share_;
+    CSharePtr Share_;
   };
 
   class TaskUpdateDag : public Task<PoolBackend> {
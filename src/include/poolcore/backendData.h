@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <limits>
 #include "p2putils/xmstream.h"
 
 std::string partByHeight(uint64_t height);
@@ -16,6 +17,7 @@ typedef bool CheckAddressProcTy(const char*);
 
 struct CShare {
   enum { CurrentRecordVersion = 1 };
+  static constexpr uint32_t UnknownIndex = std::numeric_limits<uint32_t>::max();
   uint64_t UniqueShareId = 0;
   std::string userId;
   std::string workerId;
@@ -28,6 +30,26 @@ struct CShare {
   double ExpectedWork = 0.0;
   uint32_t ChainLength;
   uint32_t PrimePOWTarget;
+  // Interned user & worker identifiers (see CUserWorkerTable), not serialized
+  uint32_t UserIndex = UnknownIndex;
+  uint32_t WorkerIndex = UnknownIndex;
+
+  void reset() {
+    UniqueShareId = 0;
+    userId.clear();
+    workerId.clear();
+    height = 0;
+    WorkValue = 0.0;
+    isBlock = false;
+    hash.clear();
+    generatedCoins = 0;
+    Time = 0;
+    ExpectedWork = 0.0;
+    ChainLength = 0;
+    PrimePOWTarget = 0;
+    UserIndex = UnknownIndex;
+    WorkerIndex = UnknownIndex;
+  }
 };
 
 struct CMiningAddress {
@@ -67,11 +89,17 @@ struct PoolBackendConfig {
   bool isMaster;
   std::filesystem::path dbPath;
   std::chrono::seconds ShareLogFlushInterval = std::chrono::seconds(3);
+  std::chrono::milliseconds ShareLogSyncInterval = std::chrono::seconds(3);
   uint64_t ShareLogFileSizeLimit = 4194304;
+  uint64_t ShareLogBacklogLimit = 16777216;
 
   unsigned RequiredConfirmations;
   int64_t DefaultPayoutThreshold;
   int64_t MinimalAllowedPayout;
+  // Pay up to PayoutBatchMaxOutputs users with one transaction (disabled if less than 2)
+  unsigned PayoutBatchMaxOutputs = 1;
+  // Signed batch transaction size limit, bytes
+  size_t PayoutBatchMaxSize = 100000;
   unsigned KeepRoundTime;
   unsigned KeepStatsTime;
   unsigned ConfirmationsCheckInterval;
@@ -83,6 +111,23 @@ struct PoolBackendConfig {
   std::chrono::minutes StatisticWorkersAggregateTime = std::chrono::minutes(5);
   std::chrono::minutes StatisticPoolAggregateTime = std::chrono::minutes(1);
   std::chrono::hours StatisticKeepWorkerNamesTime = std::chrono::hours(24);
+  // fsync statistic database on every flush; without it records are protected by WAL only
+  bool StatisticSyncWrites = false;
+  // Downsampled workers and pool statistic used by history queries; each interval must be a multiple of previous one,
+  // zero keep time means no retention
+  struct CStatisticRollupTier {
+    std::chrono::seconds Interval;
+    std::chrono::hours KeepTime;
+  };
+  std::vector<CStatisticRollupTier> StatisticRollupTiers = {
+    {std::chrono::minutes(15), std::chrono::hours(24*31)},
+    {std::chrono::hours(1), std::chrono::hours(24*366)},
+    {std::chrono::hours(24), std::chrono::hours(0)}
+  };
+
+  // Ethash: verify shares using full dataset (1GB+ per epoch, cached in dbPath/ethash) instead of light cache
+  bool EthashFullDataset = false;
+  unsigned EthashFullDatasetThreads = 4;
 
   SelectorByWeight<CMiningAddress> MiningAddresses;
   std::string CoinBaseMsg;
@@ -100,7 +145,7 @@ struct UserShareValue {
 };
 
 struct PayoutDbRecord {
-  enum { CurrentRecordVersion = 2 };
+  enum { CurrentRecordVersion = 3 };
   enum EStatus {
     EInitialized = 0,
     ETxCreated,
@@ -117,6 +162,9 @@ struct PayoutDbRecord {
   uint32_t Status = EInitialized;
   // Version 2
   int64_t TxFee = 0;
+  // Version 3
+  // Number of payouts in transaction; batch shares TransactionId, TransactionData stored in first payout only
+  uint32_t BatchSize = 0;
 
   std::string getPartitionId() const { return partByTime(Time); }
   bool deserializeValue(const void *data, size_t size);
@@ -368,6 +416,36 @@ struct PoolBalanceRecord {
   void serializeValue(xmstream &stream) const;
 };
 
+// Pool totals, updated on each found block and confirmed payout
+struct PoolTotalsRecord {
+  enum { CurrentRecordVersion = 1 };
+
+  uint64_t BlocksFound = 0;
+  double AccumulatedWork = 0.0;
+  int64_t PaidOut = 0;
+
+  std::string getPartitionId() const { return "default"; }
+  bool deserializeValue(const void *data, size_t size);
+  void serializeKey(xmstream &stream) const;
+  void serializeValue(xmstream &stream) const;
+};
+
+// Luck prefix sums: work of all found blocks up to and including Height, one record per found block
+struct PoolLuckPrefixRecord {
+  enum { CurrentRecordVersion = 1 };
+
+  uint64_t Index = 0;
+  uint64_t Height = 0;
+  int64_t Time = 0;
+  double AccumulatedWork = 0.0;
+  double ExpectedWork = 0.0;
+
+  std::string getPartitionId() const { return "luck"; }
+  bool deserializeValue(const void *data, size_t size);
+  void serializeKey(xmstream &stream) const;
+  void serializeValue(xmstream &stream) const;
+};
+
 struct StatsRecord {
   enum { CurrentRecordVersion = 1 };
   
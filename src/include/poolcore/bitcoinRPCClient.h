@@ -5,21 +5,28 @@
 #include "asyncio/asyncio.h"
 #include "asyncio/http.h"
 #include "asyncio/socket.h"
+#include "asyncioextras/zmtp.h"
+#include "p2putils/strExtras.h"
 #include <rapidjson/document.h>
 #include <chrono>
+#include <memory>
 #include <vector>
 #include "loguru.hpp"
 
 class CBitcoinRpcClient : public CNetworkClient {
 public:
-  CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const CCoinInfo &coinInfo, const char *address, const char *login, const char *password, bool longPollEnabled);
+  // zmqAddress: node's zmqpubhashblock endpoint (host:port), new block notifications trigger immediate template update
+  // emptyWorkEnabled: on new block send coinbase-only template before full one
+  CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const CCoinInfo &coinInfo, const char *address, const char *login, const char *password, bool longPollEnabled, const char *zmqAddress = "", bool emptyWorkEnabled = false);
 
   virtual CPreparedQuery *prepareBlock(const void *data, size_t size) override;
   virtual bool ioGetBalance(asyncBase *base, GetBalanceResult &result) override;
   virtual bool ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<GetBlockConfirmationsQuery> &query) override;
   virtual EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, BuildTransactionResult &result) override;
+  virtual EOperationStatus ioBuildTransactionBatch(asyncBase *base, const std::vector<BuildTransactionOutput> &outputs, const std::string &changeAddress, BuildBatchTransactionResult &result) override;
   virtual EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string&, std::string &error) override;
   virtual EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error) override;
+  virtual EOperationStatus ioGetTxConfirmationsBatch(asyncBase *base, std::vector<GetTxConfirmationsQuery> &query) override;
   virtual void aioSubmitBlock(asyncBase *base, CPreparedQuery *queryPtr, CSubmitBlockOperation *operation) override;
   virtual EOperationStatus ioListUnspent(asyncBase *base, ListUnspentResult &result) override;
   virtual EOperationStatus ioZSendMany(asyncBase *base, const std::string &source, const std::string &destination, int64_t amount, const std::string &memo, uint64_t minConf, int64_t fee, CNetworkClient::ZSendMoneyResult &result) override;
@@ -39,6 +46,24 @@ private:
     uint64_t WorkId;
     std::chrono::time_point<std::chrono::steady_clock> LastTemplateTime;
     aioUserEvent *TimerEvent;
+    bool Active = false;
+  };
+
+  struct CZmqSubscriber {
+    bool Enabled = false;
+    bool Started = false;
+    HostAddress Address;
+    zmtpSocket *Socket = nullptr;
+    zmtpStream Stream;
+    aioUserEvent *ReconnectEvent = nullptr;
+    std::string LastBlockHash;
+    // One-shot getblocktemplate request after notification
+    HTTPClient *Client = nullptr;
+    HTTPParseDefaultContext ParseCtx;
+    bool FetchInProgress = false;
+    bool FetchPending = false;
+    // longpollid of last template sent after notification, pending long poll returns same template for same block
+    std::string LongPollId;
   };
 
   struct CConnection {
@@ -60,6 +85,25 @@ private:
     HTTPParseDefaultContext ParseCtx;
     std::string LastError;
     int LastErrorCode = 0;
+
+    // Keep-alive support
+    asyncBase *Base = nullptr;
+    bool Reusable = false;
+    std::chrono::time_point<std::chrono::steady_clock> LastUsed;
+  };
+
+  // Returns connection to keep-alive pool of current thread on destruction
+  struct CConnectionReleaser {
+    CBitcoinRpcClient *Client;
+    void operator()(CConnection *connection) const { Client->releaseConnection(connection); }
+  };
+
+  using CConnectionPtr = std::unique_ptr<CConnection, CConnectionReleaser>;
+
+  struct CRpcCall {
+    const char *Method;
+    std::string Params;
+    CRpcCall(const char *method, const std::string &params) : Method(method), Params(params) {}
   };
 
   struct CPreparedSubmitBlock : public CPreparedQuery {
@@ -74,6 +118,7 @@ private:
   std::string buildSendToAddress(const std::string &destination, int64_t amount);
   std::string buildGetTransaction(const std::string &txId);
   EOperationStatus signRawTransaction(CConnection *connection, const std::string &fundedTransaction, std::string &signedTransaction, std::string &error);
+  EOperationStatus decodeTransactionId(CConnection *connection, const std::string &txData, std::string &txId, std::string &error);
 
   void submitBlockRequestCb(CPreparedSubmitBlock *query) {
     std::unique_ptr<CPreparedSubmitBlock> queryHolder(query);
@@ -126,7 +171,11 @@ private:
 
   template<rapidjson::ParseFlag flag = rapidjson::kParseDefaultFlags>
   EOperationStatus ioQueryJson(CConnection &connection, const std::string &query, rapidjson::Document &document, uint64_t timeout) {
+    connection.LastError.clear();
+    connection.LastErrorCode = 0;
     AsyncOpStatus status = ioHttpRequest(connection.Client, query.data(), query.size(), timeout, httpParseDefault, &connection.ParseCtx);
+    // Connection can be used for next request only if response was completely received
+    connection.Reusable = status == aosSuccess;
     if (status != aosSuccess) {
       LOG_F(WARNING, "%s %s: error code: %u", CoinInfo_.Name.c_str(), FullHostName_.c_str(), status);
       return status == aosTimeout ? EStatusTimeout : EStatusNetworkError;
@@ -162,11 +211,67 @@ private:
     return EStatusOk;
   }
 
+  // Sends all calls as one JSON-RPC batch; responses[i] points to response object for calls[i]
+  template<rapidjson::ParseFlag flag = rapidjson::kParseDefaultFlags>
+  EOperationStatus ioQueryBatch(CConnection &connection, const std::vector<CRpcCall> &calls, rapidjson::Document &document, std::vector<rapidjson::Value*> &responses, uint64_t timeout) {
+    std::string query = buildBatchQuery(calls);
+    EOperationStatus status = ioQueryJson<flag>(connection, buildHttpQuery(query), document, timeout);
+    if (status != EStatusOk)
+      return status;
+
+    if (!document.IsArray() || document.GetArray().Size() != calls.size()) {
+      LOG_F(WARNING, "%s %s: batch response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+      return EStatusProtocolError;
+    }
+
+    // Node can reorder responses, use 'id' field
+    responses.assign(calls.size(), nullptr);
+    for (rapidjson::Value &value: document.GetArray()) {
+      size_t id = calls.size();
+      if (value.IsObject() && value.HasMember("id") && value["id"].IsString())
+        id = xatoi<size_t>(value["id"].GetString());
+      if (id >= calls.size()) {
+        LOG_F(WARNING, "%s %s: batch response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+        return EStatusProtocolError;
+      }
+      responses[id] = &value;
+    }
+
+    for (rapidjson::Value *value: responses) {
+      if (!value) {
+        LOG_F(WARNING, "%s %s: batch response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+        return EStatusProtocolError;
+      }
+    }
+
+    return EStatusOk;
+  }
+
+  std::string buildHttpQuery(const std::string &data);
+  std::string buildBatchQuery(const std::vector<CRpcCall> &calls);
+
+  // Returns null if response is not valid block template
+  CBlockTemplate *parseBlockTemplate(HTTPParseDefaultContext &parseCtx, std::string &prevBlockHash, int64_t *height);
+  // Copy of template without transactions, coinbase value reduced by their fees; null if template can't be stripped
+  CBlockTemplate *buildEmptyBlockTemplate(CBlockTemplate &blockTemplate);
+  void sendBlockTemplate(CBlockTemplate *blockTemplate, bool isNewBlock);
+
   void onWorkFetcherConnect(AsyncOpStatus status);
   void onWorkFetcherIncomingData(AsyncOpStatus status);
   void onWorkFetchTimeout();
 
+  void zmqConnect();
+  void onZmqConnect(AsyncOpStatus status);
+  void onZmqMessage(AsyncOpStatus status);
+  void onZmqDisconnect();
+  void zmqFetchTemplate();
+  void onZmqFetcherConnect(AsyncOpStatus status);
+  void onZmqFetcherIncomingData(AsyncOpStatus status);
+
   CConnection *getConnection(asyncBase *base);
+  // Reuses idle keep-alive connection or creates and connects new one
+  CConnectionPtr acquireConnection(asyncBase *base);
+  void releaseConnection(CConnection *connection);
 
 private:
   asyncBase *WorkFetcherBase_;
@@ -179,13 +284,16 @@ private:
   std::string BasicAuth_;
 
   GBTInstance WorkFetcher_;
+  CZmqSubscriber Zmq_;
   bool HasLongPoll_;
+  bool EmptyWorkEnabled_;
   bool HasGetWalletInfo_ = true;
   bool HasGetBlockChainInfo_ = true;
   bool HasSignRawTransactionWithWallet_ = true;
 
   // Queries cache
-  std::string BalanceQuery_;
-  std::string BalanceQueryWithImmatured_;
   std::string GetWalletInfoQuery_;
+
+  // Idle keep-alive connections, one pool per thread
+  std::unique_ptr<std::vector<std::unique_ptr<CConnection>>[]> ConnectionPools_;
 };
@@ -6,22 +6,48 @@ extern "C" {
 #include "poolcommon/intrusive_ptr.h"
 #include "rapidjson/document.h"
 #include <atomic>
+#include <filesystem>
 
 struct alignas(512) EthashDagWrapper {
 public:
-  EthashDagWrapper(unsigned epochNumber, bool bigEpoch) {
+  EthashDagWrapper(unsigned epochNumber, bool bigEpoch) : EpochNumber_(epochNumber), BigEpoch_(bigEpoch) {
     Dag_ = ethashCreateDag(epochNumber, bigEpoch);
   }
 
+  ~EthashDagWrapper();
+
   EthashDag *dag() { return Dag_; }
+  // Full dataset, null until it loaded or generated; light cache used in this case
+  const uint32_t *fullDataset() { return FullDataset_.load(std::memory_order_acquire); }
+
+  // Maps full dataset from cache directory or generates it in background using 'threadsNum' threads
+  // Wrapper must be owned by intrusive pointer: generator holds own reference until it finished
+  void startFullDataset(const std::filesystem::path &cacheDirectory, unsigned threadsNum);
+  // Stops generation, cached file removed when generator finished and last reference released
+  void releaseFullDataset();
 
 public:
   uintptr_t ref_fetch_add(uintptr_t value) { return Refs_.fetch_add(value); }
   uintptr_t ref_fetch_sub(uintptr_t value) { return Refs_.fetch_sub(value); }
 
 private:
+  static std::filesystem::path fullDatasetPath(const std::filesystem::path &cacheDirectory, unsigned epochNumber, bool bigEpoch);
+  void loadFullDataset(unsigned threadsNum);
+  bool mapFullDataset(const std::filesystem::path &path, uint64_t size);
+  bool generateFullDataset(const std::filesystem::path &path, uint64_t size, unsigned threadsNum);
+
+private:
+  unsigned EpochNumber_;
+  bool BigEpoch_;
   EthashDag *Dag_ = nullptr;
   std::atomic<uintptr_t> Refs_ = 0;
+
+  std::atomic<const uint32_t*> FullDataset_ = nullptr;
+  void *MappedData_ = nullptr;
+  uint64_t MappedSize_ = 0;
+  std::filesystem::path CacheDirectory_;
+  std::atomic<bool> Cancel_ = false;
+  std::atomic<bool> RemoveOnRelease_ = false;
 };
 
 class CBlockTemplate {
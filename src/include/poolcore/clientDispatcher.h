@@ -31,9 +31,11 @@ public:
   bool ioGetBlockConfirmations(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockConfirmationsQuery> &query);
   bool ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<CNetworkClient::GetBlockExtraInfoQuery> &query);
   CNetworkClient::EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, CNetworkClient::BuildTransactionResult &result);
+  CNetworkClient::EOperationStatus ioBuildTransactionBatch(asyncBase *base, const std::vector<CNetworkClient::BuildTransactionOutput> &outputs, const std::string &changeAddress, CNetworkClient::BuildBatchTransactionResult &result);
   CNetworkClient::EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error);
   CNetworkClient::EOperationStatus ioWalletService(asyncBase *base, std::string &error);
   CNetworkClient::EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error);
+  CNetworkClient::EOperationStatus ioGetTxConfirmationsBatch(asyncBase *base, std::vector<CNetworkClient::GetTxConfirmationsQuery> &query);
   void aioSubmitBlock(asyncBase *base, const void *data, size_t size, CNetworkClient::SumbitBlockCb callback);
 
   // ZEC specific
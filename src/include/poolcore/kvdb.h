@@ -4,6 +4,8 @@
 #include "p2putils/coreTypes.h"
 #include "p2putils/xmstream.h"
 #include <filesystem>
+#include <map>
+#include <string>
 
 template<typename DbTy>
 class kvdb {
@@ -11,6 +13,44 @@ private:
   DbTy _db;
   
 public:
+  // Collects rows for any number of partitions, one write batch per partition
+  class MultiPartitionBatch {
+  public:
+    MultiPartitionBatch(kvdb &db) : Db_(db) {}
+
+    template<typename D>
+    void put(const D &data) {
+      std::string partitionId = data.getPartitionId();
+      auto It = Batches_.find(partitionId);
+      if (It == Batches_.end())
+        It = Batches_.emplace(partitionId, Db_.batch(partitionId)).first;
+      Db_.put(It->second, data);
+    }
+
+    template<typename D>
+    void deleteRow(const D &data) {
+      std::string partitionId = data.getPartitionId();
+      auto It = Batches_.find(partitionId);
+      if (It == Batches_.end())
+        It = Batches_.emplace(partitionId, Db_.batch(partitionId)).first;
+      Db_.deleteRow(It->second, data);
+    }
+
+    bool empty() const { return Batches_.empty(); }
+
+    bool write(bool sync) {
+      bool result = true;
+      for (auto &batch: Batches_)
+        result &= Db_.writeBatch(batch.second, sync);
+      Batches_.clear();
+      return result;
+    }
+
+  private:
+    kvdb &Db_;
+    std::map<std::string, typename DbTy::PartitionBatchType> Batches_;
+  };
+
   kvdb(const std::filesystem::path &path) : _db(path) {}
   
   template<typename D>
@@ -50,7 +90,7 @@ public:
   
   typename DbTy::IteratorType *iterator() { return _db.iterator(); }
   typename DbTy::PartitionBatchType batch(const std::string partitionId) { return _db.batch(partitionId); }
-  void writeBatch(typename DbTy::PartitionBatchType &batch) { _db.writeBatch(batch); }
+  bool writeBatch(typename DbTy::PartitionBatchType &batch, bool sync = true) { return _db.writeBatch(batch, sync); }
   void clear() { _db.clear(); }
 };
 
@@ -104,6 +104,19 @@ public:
       Hash(hash), Height(height), TxFee(txFee), BlockReward(lastKnownBlockReward) {}
   };
 
+  struct GetTxConfirmationsQuery {
+    // Input
+    std::string TxId;
+    // Output
+    EOperationStatus Status = EStatusUnknownError;
+    int64_t Confirmations = 0;
+    int64_t TxFee = 0;
+    std::string Error;
+
+    GetTxConfirmationsQuery() {}
+    GetTxConfirmationsQuery(const std::string &txId) : TxId(txId) {}
+  };
+
   struct GetBalanceResult {
     int64_t Balance;
     int64_t Immatured;
@@ -123,6 +136,21 @@ public:
     int64_t Fee;
   };
 
+  struct BuildTransactionOutput {
+    std::string Address;
+    int64_t Value;
+  };
+
+  struct BuildBatchTransactionResult {
+    std::string TxId;
+    std::string TxData;
+    std::string Error;
+    // Per output, same order as requested outputs; Values[i] + Fees[i] <= requested value
+    std::vector<int64_t> Values;
+    std::vector<int64_t> Fees;
+    int64_t Fee;
+  };
+
   struct ListUnspentElement {
     std::string Address;
     int64_t Amount;
@@ -160,8 +188,14 @@ public:
   virtual bool ioGetBlockExtraInfo(asyncBase *base, int64_t orphanAgeLimit, std::vector<GetBlockExtraInfoQuery> &query) = 0;
   virtual bool ioGetBalance(asyncBase *base, GetBalanceResult &result) = 0;
   virtual EOperationStatus ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, BuildTransactionResult &result) = 0;
+  // Builds one transaction paying to many recipients, fee is split between outputs
+  // Default implementation supports single output only, returns EStatusMethodNotFound for others
+  virtual EOperationStatus ioBuildTransactionBatch(asyncBase *base, const std::vector<BuildTransactionOutput> &outputs, const std::string &changeAddress, BuildBatchTransactionResult &result);
   virtual EOperationStatus ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error) = 0;
   virtual EOperationStatus ioGetTxConfirmations(asyncBase *base, const std::string &txId, int64_t *confirmations, int64_t *txFee, std::string &error) = 0;
+  // Checks many transactions at once, per-transaction result is in query; returns transport status
+  // Default implementation calls ioGetTxConfirmations for each transaction
+  virtual EOperationStatus ioGetTxConfirmationsBatch(asyncBase *base, std::vector<GetTxConfirmationsQuery> &query);
   virtual EOperationStatus ioListUnspent(asyncBase *base, ListUnspentResult &result) = 0;
   virtual EOperationStatus ioZSendMany(asyncBase *base, const std::string &source, const std::string &destination, int64_t amount, const std::string &memo, uint64_t minConf, int64_t fee, CNetworkClient::ZSendMoneyResult &result) = 0;
   virtual EOperationStatus ioZGetBalance(asyncBase *base, const std::string &address, int64_t *balance) = 0;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "poolcore/backendData.h"
+#include "poolcore/statistics.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// PPLNS scores: shares of current round (since last block) and shares of previous rounds
+// not older than window size. Shares are grouped into time buckets with compact arrays of
+// (user slot, work); per-user sums are updated when bucket added or expired, so block
+// processing is O(active users)
+class CPPLNSWindow {
+public:
+  CPPLNSWindow(int64_t windowSize, int64_t bucketSize) : WindowSize_(windowSize), BucketSize_(bucketSize) {}
+
+  void addShare(const CShare &share);
+  // Returns scores of all users for block found at 'time' and starts new round
+  void closeRound(int64_t time, std::vector<UserShareValue> &scores);
+  void clear();
+
+  double roundWork() const { return RoundWork_; }
+  void exportRound(std::map<std::string, double> &scores) const;
+  // Previous rounds shares, sorted by time in descending order as CStatsExportData::recentShareValue expects
+  void exportRecent(std::vector<StatisticDb::CStatsExportData> &recent) const;
+  // Round shares have no time in saved state, all of them placed at 'timeLabel'
+  void load(const std::vector<StatisticDb::CStatsExportData> &recent, const std::map<std::string, double> &round, int64_t timeLabel);
+
+private:
+  struct CUserScore {
+    std::string UserId;
+    uint32_t Slot = 0;
+    // Current round work
+    double Round = 0.0;
+    // Part of current round work in buckets
+    double RoundInWindow = 0.0;
+    // Previous rounds work in buckets
+    double PreviousRounds = 0.0;
+    // Number of buckets with user's work, slot is released when zero and no round work
+    uint32_t BucketsNum = 0;
+    uint64_t LastBucketSeq = 0;
+    uint32_t LastBucketEntry = 0;
+    bool Used = false;
+  };
+
+  struct CBucket {
+    uint64_t Seq;
+    int64_t BeginTime;
+    // Time of last share
+    int64_t TimeLabel;
+    bool PreviousRound;
+    std::vector<std::pair<uint32_t, double>> Work;
+  };
+
+private:
+  uint32_t userSlot(const std::string &userId);
+  void releaseSlot(uint32_t slot);
+  void addWork(CUserScore &user, double work, int64_t time, bool previousRound);
+  void expire(int64_t time);
+
+private:
+  int64_t WindowSize_;
+  int64_t BucketSize_;
+  std::deque<CUserScore> Users_;
+  std::unordered_map<std::string, uint32_t> UserMap_;
+  std::vector<uint32_t> FreeSlots_;
+  // Users by interned identifier (CShare::UserIndex), must be cleared after slot release
+  std::vector<CUserScore*> UsersCache_;
+  std::deque<CBucket> Buckets_;
+  uint64_t NextBucketSeq_ = 1;
+  double RoundWork_ = 0.0;
+};
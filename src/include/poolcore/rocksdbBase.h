@@ -223,7 +223,8 @@ public:
   IteratorType *iterator();
 
   PartitionBatchType batch(const std::string &partitionId);
-  bool writeBatch(PartitionBatchType &batch);
+  // Non-synced batch survives process crash (it is in WAL), but can be lost on OS crash
+  bool writeBatch(PartitionBatchType &batch, bool sync = true);
 };
 
 #endif //__LEVELDB_BASE_H_
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "backendData.h"
 #include "poolcommon/debug.h"
 #include "poolcommon/file.h"
@@ -18,12 +23,38 @@ struct ShareLogIo {
   static void unserialize(xmstream &in, T &data);
 };
 
+struct CShareLogCheckpoint {
+  uint64_t ShareId;
+  uint64_t Offset;
+};
+
+// Written at the end of completed share log file, followed by index offset and ShareLogIndexMagic
+// Checkpoint is a position of share record, all shares before it have lower id
+struct CShareLogIndex {
+  static constexpr uint32_t CurrentRecordVersion = 1;
+  uint64_t FirstId = 0;
+  uint64_t LastId = 0;
+  std::vector<CShareLogCheckpoint> Checkpoints;
+};
+
 template<>
 struct ShareLogIo<CShare> {
   static void serialize(xmstream &out, const CShare &data);
   static void unserialize(xmstream &in, CShare &data);
 };
 
+template<>
+struct ShareLogIo<CShareLogIndex> {
+  static void serialize(xmstream &out, const CShareLogIndex &data);
+  static void unserialize(xmstream &in, CShareLogIndex &data);
+};
+
+// Shares serialized on backend thread, disk writes and fdatasync calls are done by
+// dedicated writer thread. Backend fills one of two buffers, filled buffer passed
+// to writer through single atomic slot; if writer can't keep up, backend accumulates
+// shares until ShareLogBacklogLimit and then waits until writer frees slot
+// Completed files have index footer; at startup files already reflected in databases
+// (up to lastAggregatedShareId) are skipped, others decoded in parallel and applied in order
 template<typename CConfig>
 class ShareLog {
 private:
@@ -32,26 +63,58 @@ private:
     uint64_t FirstId;
     uint64_t LastId;
     FileDescriptor Fd;
+    // Share records size, index footer excluded
+    size_t DataSize = 0;
+    bool HasIndex = false;
+    std::vector<CShareLogCheckpoint> Checkpoints;
     // TEMPORARY
     bool IsOldFormat = false;
   };
 
+  struct CShareLogBatch {
+    xmstream Data;
+    uint64_t FirstShareId = 0;
+    uint64_t LastShareId = 0;
+    uint64_t AggregatedShareId = 0;
+  };
+
+  struct CReplayTask {
+    CShareLogFile *File;
+    size_t Begin;
+    size_t End;
+    std::vector<CShare> Shares;
+    uint64_t LastId = 0;
+    bool Ready = false;
+  };
+
+  // Writer thread polls handoff slot with this interval if wakeup was missed
+  static constexpr std::chrono::milliseconds WriterPollInterval = std::chrono::milliseconds(100);
+  static constexpr uint64_t ShareLogIndexMagic = 0x3158444e49474c53ULL; // "SLGINDX1"
+  static constexpr size_t ShareLogIndexTrailerSize = 2*sizeof(uint64_t);
+  static constexpr size_t ShareLogCheckpointInterval = 65536;
+  static constexpr unsigned ShareLogReplayThreadsLimit = 8;
+
 public:
   ShareLog() {}
+  ~ShareLog() { stopWriter(); }
+
   void init(const std::filesystem::path &path,
             const std::filesystem::path &oldPath,
             const std::string &backendName,
             asyncBase *base,
             std::chrono::seconds shareLogFlushInterval,
+            std::chrono::milliseconds shareLogSyncInterval,
             int64_t shareLogFileSizeLimit,
+            uint64_t shareLogBacklogLimit,
             const CConfig &config) {
     Path_ = path;
     BackendName_ = backendName;
     Base_ = base;
     ShareLogFlushInterval_ = shareLogFlushInterval;
+    ShareLogSyncInterval_ = shareLogSyncInterval;
     ShareLogFileSizeLimit_ = shareLogFileSizeLimit;
+    ShareLogBacklogLimit_ = shareLogBacklogLimit;
     Config_ = config;
-
     {
       // TEMPORARY: load shares in old format
       // TODO: remove this code
@@ -102,13 +165,13 @@ public:
       LOG_F(WARNING, "%s: share log is empty like at first run", BackendName_.c_str());
 
     uint64_t currentTime = time(nullptr);
-    for (auto &file: ShareLog_)
-      replayShares(file);
+    uint64_t lastShareId = replayShareLog(Config_.lastAggregatedShareId());
 
     Config_.initializationFinish(currentTime);
-    CurrentShareId_ = Config_.lastKnownShareId() + 1;
+    CurrentShareId_ = std::max(Config_.lastKnownShareId(), lastShareId) + 1;
 
-    if (!ShareLog_.empty()) {
+    // Completed file can be last if process stopped before next file created, don't append after its index
+    if (!ShareLog_.empty() && !ShareLog_.back().HasIndex) {
       CShareLogFile &lastFile = ShareLog_.back();
       if (lastFile.Fd.open(lastFile.Path)) {
         lastFile.Fd.seekSet(lastFile.Fd.size());
@@ -117,77 +180,127 @@ public:
         ShareLoggingEnabled_ = false;
       }
     } else {
-      startNewShareLogFile();
+      startNewShareLogFile(CurrentShareId_);
     }
   }
 
   void start() {
+    WriterThread_ = std::thread([](ShareLog *shareLog) { shareLog->writerMain(); }, this);
     coroutineCall(coroutineNew([](void *arg) { static_cast<ShareLog*>(arg)->shareLogFlushHandler(); }, this, 0x100000));
   }
 
+  // Call after backend thread finished: stops writer thread and writes all remaining shares
+  void stop() {
+    stopWriter();
+    if (CShareLogBatch *batch = Pending_.exchange(nullptr))
+      writeBatch(*batch);
+    prepareBatch();
+    writeBatch(*Active_);
+    if (ShareLoggingEnabled_ && !ShareLog_.empty())
+      ShareLog_.back().Fd.sync();
+  }
+
   void addShare(CShare &share) {
     share.UniqueShareId = CurrentShareId_++;
+    if (Active_->Data.sizeOf() == 0)
+      Active_->FirstShareId = share.UniqueShareId;
     // Serialize share to stream
-    ShareLogIo<CShare>::serialize(ShareLogInMemory_, share);
+    ShareLogIo<CShare>::serialize(Active_->Data, share);
+    // Back-pressure: don't grow backlog if writer is stalled
+    if (Active_->Data.sizeOf() >= ShareLogBacklogLimit_)
+      flush(true);
   }
 
-  void flush() {
-    if (!ShareLoggingEnabled_ || ShareLog_.empty()) {
-      ShareLogInMemory_.reset();
-      return;
+  // Pass accumulated shares to writer thread
+  // If writer is busy, shares are kept in memory until next flush, unless wait is requested
+  void flush(bool wait = false) {
+    if (Pending_.load(std::memory_order_acquire)) {
+      if (!wait)
+        return;
+      LOG_F(WARNING, "%s: share log writer is behind, backlog is %zu bytes", BackendName_.c_str(), Active_->Data.sizeOf());
+      std::unique_lock<std::mutex> lock(WriterMutex_);
+      DrainedCV_.wait(lock, [this]() { return !Pending_.load(std::memory_order_acquire); });
     }
 
-    // Flush memory buffer to disk
-    ShareLog_.back().Fd.write(ShareLogInMemory_.data(), ShareLogInMemory_.sizeOf());
-    ShareLogInMemory_.reset();
-
-    // Check share log file size limit
-    if (ShareLog_.back().Fd.size() >= ShareLogFileSizeLimit_) {
-      ShareLog_.back().Fd.close();
-      startNewShareLogFile();
-
-      // Check status of shares in previous log files
-      uint64_t aggregatedShareId = Config_.lastAggregatedShareId();
-      if (isDebugBackend() && !ShareLog_.empty()) {
-        LOG_F(1, "Last aggregated share id: %" PRIu64 "; first file range is [%" PRIu64": %" PRIu64 "]", aggregatedShareId, ShareLog_.front().FirstId, ShareLog_.front().LastId);
-      }
+    prepareBatch();
+    {
+      // Notify under mutex: writer can't miss wakeup between predicate check and wait
+      std::lock_guard<std::mutex> lock(WriterMutex_);
+      Pending_.store(Active_, std::memory_order_release);
+      WriterCV_.notify_one();
+    }
+    Active_ = Active_ == &Buffers_[0] ? &Buffers_[1] : &Buffers_[0];
+  }
 
+private:
+  // Reads index footer of completed file, returns false if file can't be opened
+  bool loadIndex(CShareLogFile &file) {
+    FileDescriptor fd;
+    if (!fd.open(file.Path)) {
+      LOG_F(ERROR, "%s: can't open file %s", BackendName_.c_str(), file.Path.u8string().c_str());
+      return false;
+    }
 
-      while (ShareLog_.size() > 1 && ShareLog_.front().LastId < aggregatedShareId) {
-        LOG_F(INFO, "remove old share log file %s", ShareLog_.front().Path.u8string().c_str());
-        std::filesystem::remove(ShareLog_.front().Path);
-        ShareLog_.pop_front();
-      }
+    size_t fileSize = fd.size();
+    file.DataSize = fileSize;
+    file.HasIndex = false;
+    if (file.IsOldFormat || fileSize < ShareLogIndexTrailerSize)
+      return true;
+
+    uint64_t trailer[2];
+    if (fd.read(trailer, fileSize - ShareLogIndexTrailerSize, ShareLogIndexTrailerSize) != static_cast<ssize_t>(ShareLogIndexTrailerSize))
+      return true;
+
+    xmstream trailerStream(trailer, sizeof(trailer));
+    uint64_t indexOffset = trailerStream.readle<uint64_t>();
+    uint64_t magic = trailerStream.readle<uint64_t>();
+    if (magic != ShareLogIndexMagic || indexOffset >= fileSize - ShareLogIndexTrailerSize)
+      return true;
+
+    size_t indexSize = fileSize - ShareLogIndexTrailerSize - indexOffset;
+    xmstream stream(indexSize);
+    if (fd.read(stream.reserve(indexSize), indexOffset, indexSize) != static_cast<ssize_t>(indexSize))
+      return true;
+
+    CShareLogIndex index;
+    stream.seekSet(0);
+    ShareLogIo<CShareLogIndex>::unserialize(stream, index);
+    if (stream.eof() || index.FirstId != file.FirstId) {
+      LOG_F(WARNING, "%s: invalid index in share log %s, full replay", BackendName_.c_str(), file.Path.u8string().c_str());
+      return true;
     }
+
+    file.LastId = index.LastId;
+    file.DataSize = indexOffset;
+    file.HasIndex = true;
+    file.Checkpoints = std::move(index.Checkpoints);
+    return true;
   }
 
-private:
-  void replayShares(CShareLogFile &file) {
+  // Worker thread side
+  void decodeShares(CReplayTask &task) {
+    const CShareLogFile &file = *task.File;
     if (isDebugBackend())
       LOG_F(1, "%s: Replaying shares from file %s", BackendName_.c_str(), file.Path.u8string().c_str());
 
     FileDescriptor fd;
-    if (!fd.open(file.Path.u8string().c_str())) {
-      LOG_F(ERROR, "StatisticDb: can't open file %s", file.Path.u8string().c_str());
+    if (!fd.open(file.Path)) {
+      LOG_F(ERROR, "%s: can't open file %s", BackendName_.c_str(), file.Path.u8string().c_str());
       return;
     }
 
-    size_t fileSize = fd.size();
-    xmstream stream(fileSize);
-    size_t bytesRead = fd.read(stream.reserve(fileSize), 0, fileSize);
+    size_t size = task.End - task.Begin;
+    xmstream stream(size);
+    size_t bytesRead = fd.read(stream.reserve(size), task.Begin, size);
     fd.close();
-    if (bytesRead != fileSize) {
-      LOG_F(ERROR, "StatisticDb: can't read file %s", file.Path.u8string().c_str());
+    if (bytesRead != size) {
+      LOG_F(ERROR, "%s: can't read file %s", BackendName_.c_str(), file.Path.u8string().c_str());
       return;
     }
 
-    uint64_t id = 0;
-    uint64_t counter = 0;
-    uint64_t minShareId = std::numeric_limits<uint64_t>::max();
-    uint64_t maxShareId = 0;
     stream.seekSet(0);
     while (stream.remaining()) {
-      CShare share;
+      CShare &share = task.Shares.emplace_back();
       if (file.IsOldFormat) {
         // TEMPORARY
         // TODO: Remove this code
@@ -201,32 +314,136 @@ private:
       }
       if (stream.eof()) {
         LOG_F(ERROR, "Corrupted file %s", file.Path.u8string().c_str());
+        task.Shares.pop_back();
         break;
       }
 
-      if (isDebugBackend()) {
-        counter++;
-        minShareId = std::min(minShareId, share.UniqueShareId);
-        maxShareId = std::max(maxShareId, share.UniqueShareId);
+      task.LastId = share.UniqueShareId;
+    }
+  }
+
+  // Returns last share id found in share log
+  uint64_t replayShareLog(uint64_t aggregatedShareId) {
+    uint64_t lastShareId = 0;
+    size_t skippedFiles = 0;
+    std::deque<CReplayTask> tasks;
+    for (auto &file: ShareLog_) {
+      if (!loadIndex(file))
+        continue;
+
+      if (file.HasIndex && file.LastId <= aggregatedShareId) {
+        lastShareId = std::max(lastShareId, file.LastId);
+        skippedFiles++;
+        continue;
+      }
+
+      // Start decoding from last checkpoint not later than first unaggregated share
+      size_t begin = 0;
+      for (const auto &checkpoint: file.Checkpoints) {
+        if (checkpoint.ShareId > aggregatedShareId + 1)
+          break;
+        begin = checkpoint.Offset;
       }
 
-      Config_.replayShare(share);
-      id = share.UniqueShareId;
+      CReplayTask &task = tasks.emplace_back();
+      task.File = &file;
+      task.Begin = std::min(begin, file.DataSize);
+      task.End = file.DataSize;
     }
 
-    file.LastId = id;
+    unsigned threadsNum = static_cast<unsigned>(std::min<size_t>({std::max(std::thread::hardware_concurrency(), 1u), ShareLogReplayThreadsLimit, tasks.size()}));
+    LOG_F(INFO, "%s: share log replay: %zu files skipped, %zu files to replay using %u threads", BackendName_.c_str(), skippedFiles, tasks.size(), threadsNum);
+
+    // Workers decode files ahead of serial apply step, not more than window size
+    size_t window = 2*threadsNum;
+    size_t appliedTasks = 0;
+    std::atomic<size_t> nextTask = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threadsNum; i++) {
+      workers.emplace_back([&]() {
+        for (;;) {
+          size_t index = nextTask.fetch_add(1);
+          if (index >= tasks.size())
+            break;
+
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return index < appliedTasks + window; });
+          }
 
-    if (isDebugBackend())
-      LOG_F(1, "%s: Replayed %" PRIu64 " shares from %" PRIu64 " to %" PRIu64 "", BackendName_.c_str(), counter, minShareId, maxShareId);
+          decodeShares(tasks[index]);
+
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks[index].Ready = true;
+          }
+          cv.notify_all();
+        }
+      });
+    }
+
+    for (auto &task: tasks) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&task]() { return task.Ready; });
+      }
+
+      uint64_t minShareId = std::numeric_limits<uint64_t>::max();
+      uint64_t maxShareId = 0;
+      for (const CShare &share: task.Shares) {
+        Config_.replayShare(share);
+        if (isDebugBackend()) {
+          minShareId = std::min(minShareId, share.UniqueShareId);
+          maxShareId = std::max(maxShareId, share.UniqueShareId);
+        }
+      }
+
+      if (isDebugBackend())
+        LOG_F(1, "%s: Replayed %zu shares from %" PRIu64 " to %" PRIu64 "", BackendName_.c_str(), task.Shares.size(), minShareId, maxShareId);
+
+      if (!task.File->HasIndex)
+        task.File->LastId = task.LastId;
+      lastShareId = std::max(lastShareId, task.File->LastId);
+      std::vector<CShare>().swap(task.Shares);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        appliedTasks++;
+      }
+      cv.notify_all();
+    }
+
+    for (auto &worker: workers)
+      worker.join();
+    return lastShareId;
+  }
+
+  // Writer thread side
+  void writeIndex(CShareLogFile &file) {
+    CShareLogIndex index;
+    index.FirstId = file.FirstId;
+    index.LastId = file.LastId;
+    index.Checkpoints = std::move(file.Checkpoints);
+
+    xmstream stream;
+    uint64_t indexOffset = file.Fd.size();
+    ShareLogIo<CShareLogIndex>::serialize(stream, index);
+    stream.writele<uint64_t>(indexOffset);
+    stream.writele<uint64_t>(ShareLogIndexMagic);
+    if (file.Fd.writeNoSync(stream.data(), stream.sizeOf()) != static_cast<ssize_t>(stream.sizeOf()))
+      LOG_F(ERROR, "%s: can't write index to share log %s", BackendName_.c_str(), file.Path.u8string().c_str());
+    file.HasIndex = true;
   }
 
-  void startNewShareLogFile() {
+  void startNewShareLogFile(uint64_t firstId) {
     if (!ShareLog_.empty())
-      ShareLog_.back().LastId = CurrentShareId_ - 1;
+      ShareLog_.back().LastId = firstId - 1;
 
     auto &file = ShareLog_.emplace_back();
-    file.Path = Path_ / (std::to_string(CurrentShareId_) + ".dat");
-    file.FirstId = CurrentShareId_;
+    file.Path = Path_ / (std::to_string(firstId) + ".dat");
+    file.FirstId = firstId;
     file.LastId = 0;
     if (!file.Fd.open(file.Path)) {
       LOG_F(ERROR, "PoolBackend: can't write to share log %s", file.Path.u8string().c_str());
@@ -236,6 +453,96 @@ private:
     }
   }
 
+  void prepareBatch() {
+    Active_->LastShareId = CurrentShareId_ - 1;
+    Active_->AggregatedShareId = Config_.lastAggregatedShareId();
+  }
+
+  // Writer thread side; returns true if unsynced data remains in current file
+  bool writeBatch(CShareLogBatch &batch) {
+    if (!ShareLoggingEnabled_ || ShareLog_.empty()) {
+      batch.Data.reset();
+      return false;
+    }
+
+    CShareLogFile &current = ShareLog_.back();
+    bool hasData = batch.Data.sizeOf() != 0;
+    if (hasData) {
+      size_t offset = current.Fd.size();
+      if (current.Checkpoints.empty() || offset - current.Checkpoints.back().Offset >= ShareLogCheckpointInterval)
+        current.Checkpoints.push_back({batch.FirstShareId, offset});
+    }
+
+    if (hasData && current.Fd.writeNoSync(batch.Data.data(), batch.Data.sizeOf()) != static_cast<ssize_t>(batch.Data.sizeOf()))
+      LOG_F(ERROR, "%s: can't write to share log %s", BackendName_.c_str(), current.Path.u8string().c_str());
+    batch.Data.reset();
+
+    // Check share log file size limit
+    if (current.Fd.size() >= ShareLogFileSizeLimit_) {
+      current.LastId = batch.LastShareId;
+      writeIndex(current);
+      current.Fd.sync();
+      current.Fd.close();
+      startNewShareLogFile(batch.LastShareId + 1);
+
+      // Check status of shares in previous log files
+      if (isDebugBackend() && !ShareLog_.empty()) {
+        LOG_F(1, "Last aggregated share id: %" PRIu64 "; first file range is [%" PRIu64": %" PRIu64 "]", batch.AggregatedShareId, ShareLog_.front().FirstId, ShareLog_.front().LastId);
+      }
+
+      while (ShareLog_.size() > 1 && ShareLog_.front().LastId < batch.AggregatedShareId) {
+        LOG_F(INFO, "remove old share log file %s", ShareLog_.front().Path.u8string().c_str());
+        std::filesystem::remove(ShareLog_.front().Path);
+        ShareLog_.pop_front();
+      }
+
+      return false;
+    }
+
+    return hasData;
+  }
+
+  void writerMain() {
+    loguru::set_thread_name((BackendName_ + ".sharelog").c_str());
+    auto lastSyncTime = std::chrono::steady_clock::now();
+    bool unsynced = false;
+    for (;;) {
+      if (CShareLogBatch *batch = Pending_.load(std::memory_order_acquire)) {
+        unsynced |= writeBatch(*batch);
+        std::lock_guard<std::mutex> lock(WriterMutex_);
+        Pending_.store(nullptr, std::memory_order_release);
+        DrainedCV_.notify_one();
+      } else if (WriterShutdown_.load(std::memory_order_acquire)) {
+        break;
+      } else {
+        std::unique_lock<std::mutex> lock(WriterMutex_);
+        WriterCV_.wait_for(lock, WriterPollInterval, [this]() { return Pending_.load(std::memory_order_acquire) || WriterShutdown_.load(std::memory_order_acquire); });
+      }
+
+      // Group commit: one fdatasync for all batches written during sync interval
+      auto now = std::chrono::steady_clock::now();
+      if (unsynced && now - lastSyncTime >= ShareLogSyncInterval_) {
+        ShareLog_.back().Fd.sync();
+        lastSyncTime = now;
+        unsynced = false;
+      }
+    }
+
+    if (unsynced)
+      ShareLog_.back().Fd.sync();
+  }
+
+  void stopWriter() {
+    if (!WriterThread_.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(WriterMutex_);
+      WriterShutdown_.store(true, std::memory_order_release);
+      WriterCV_.notify_one();
+    }
+    WriterThread_.join();
+  }
+
   void shareLogFlushHandler() {
     aioUserEvent *timerEvent = newUserEvent(Base_, 0, nullptr, nullptr);
     for (;;) {
@@ -249,11 +556,26 @@ private:
   std::string BackendName_;
   asyncBase *Base_;
   std::chrono::seconds ShareLogFlushInterval_;
+  std::chrono::milliseconds ShareLogSyncInterval_;
   uint64_t ShareLogFileSizeLimit_;
+  uint64_t ShareLogBacklogLimit_;
   CConfig Config_;
 
-  xmstream ShareLogInMemory_;
-  std::deque<CShareLogFile> ShareLog_;
+  // Backend thread side
+  CShareLogBatch Buffers_[2];
+  CShareLogBatch *Active_ = &Buffers_[0];
   uint64_t CurrentShareId_ = 0;
+
+  // Handoff between backend and writer threads
+  std::atomic<CShareLogBatch*> Pending_ = nullptr;
+  std::atomic<bool> WriterShutdown_ = false;
+  std::mutex WriterMutex_;
+  std::condition_variable WriterCV_;
+  // Signaled by writer when handoff slot becomes free, back-pressure waits on it
+  std::condition_variable DrainedCV_;
+  std::thread WriterThread_;
+
+  // Owned by writer thread after start()
+  std::deque<CShareLogFile> ShareLog_;
   bool ShareLoggingEnabled_ = true;
 };
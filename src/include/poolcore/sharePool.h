@@ -0,0 +1,51 @@
+#pragma once
+
+#include "poolcore/backendData.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Shares are created by stratum threads and destroyed by backend threads after processing;
+// pool keeps released objects (with allocated string buffers) in per-thread free lists and moves
+// them between threads with batches
+class CSharePool {
+public:
+  static CShare *alloc();
+  static void release(CShare *share);
+};
+
+struct CShareDeleter {
+  void operator()(CShare *share) const { CSharePool::release(share); }
+};
+
+using CSharePtr = std::unique_ptr<CShare, CShareDeleter>;
+
+// Global table of compact user & worker identifiers, filled at authorize time
+// Accumulators use them as indexes of lookup caches instead of string hashing
+class CUserWorkerTable {
+public:
+  // Table size limit, names above it processed with CShare::UnknownIndex
+  static constexpr uint32_t MaxSize = 1u << 22;
+
+  struct CIdentity {
+    uint32_t User = CShare::UnknownIndex;
+    uint32_t Worker = CShare::UnknownIndex;
+  };
+
+  static CIdentity intern(const std::string &user, const std::string &worker);
+};
+
+// Lookup with cache indexed by interned identifier; cached pointers must be invalidated (cache cleared)
+// after removing elements from source container
+template<typename T, typename Lookup>
+static inline T &lookupByIndex(std::vector<T*> &cache, uint32_t index, Lookup lookup)
+{
+  if (index == CShare::UnknownIndex)
+    return lookup();
+  if (index >= cache.size())
+    cache.resize(index + 1, nullptr);
+  T *&element = cache[index];
+  if (!element)
+    element = &lookup();
+  return *element;
+}
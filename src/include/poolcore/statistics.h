@@ -6,13 +6,19 @@
 #include "poolcore/poolCore.h"
 #include "poolcore/rocksdbBase.h"
 #include "poolcore/shareLog.h"
+#include "poolcore/sharePool.h"
 #include "poolcore/usermgr.h"
 #include "poolcommon/multiCall.h"
 #include "poolcommon/serialize.h"
 #include "poolcommon/taskHandler.h"
 #include "asyncio/asyncio.h"
 #include <tbb/concurrent_queue.h>
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_set>
 
 struct CShare;
 
@@ -76,6 +82,8 @@ public:
     std::deque<CStatsElement> Recent;
     CStatsElement Current;
     int64_t LastShareTime = 0;
+    // Has shares not applied to users statistic index yet
+    bool IndexChanged = false;
 
     void addShare(double workValue, int64_t time, unsigned primeChainLength, unsigned primePOWTarget, bool isPrimePOW) {
       Current.SharesNum++;
@@ -156,6 +164,39 @@ private:
     int64_t Time;
   };
 
+  // Statistic records aggregated by fixed time windows, record time is a window begin
+  struct CRollupTier {
+    int64_t Interval;
+    int64_t KeepTime;
+    // Begin of first complete window, zero if no windows written yet
+    std::atomic<int64_t> StartTime = 0;
+    std::filesystem::path StatePath;
+    std::unique_ptr<kvdb<rocksdbBase>> Db;
+    // (login, worker) pairs having source records in current window, including expired workers
+    std::set<std::pair<std::string, std::string>> Keys;
+  };
+
+  struct CUserStatsValue {
+    uint32_t WorkersNum = 0;
+    uint64_t AveragePower = 0;
+    double SharesPerSecond = 0.0;
+    int64_t LastShareTime = 0;
+  };
+
+  // Users statistic ordered by each sortable column, updated only for users changed since previous update
+  struct CUserStatsIndex {
+    std::unordered_map<std::string, CUserStatsValue> Users;
+    // (value, login) pairs in ascending order
+    std::set<std::pair<uint32_t, std::string>> WorkersNum;
+    std::set<std::pair<uint64_t, std::string>> AveragePower;
+    std::set<std::pair<double, std::string>> SharesPerSecond;
+    std::set<std::pair<int64_t, std::string>> LastShareTime;
+    // Users with shares in power calculate interval, their values change with time
+    std::unordered_set<std::string> Active;
+    // Users with new shares
+    std::vector<std::string> Changed;
+  };
+
   class TaskQueryPoolStats : public Task<StatisticDb> {
   public:
     TaskQueryPoolStats(QueryPoolStatsCallback callback) : Callback_(callback) {}
@@ -204,12 +245,21 @@ private:
   // Worker stats
   std::unordered_map<std::string, std::unordered_map<std::string, CStatsAccumulator>> LastWorkerStats_;
   std::unordered_map<std::string, CStatsAccumulator> LastUserStats_;
+  // Accumulators by interned worker & user identifiers
+  std::vector<CStatsAccumulator*> WorkerStatsCache_;
+  std::vector<CStatsAccumulator*> UserStatsCache_;
+  CUserStatsIndex UserStatsIndex_;
   CFlushInfo WorkersFlushInfo_;
+  // Time of last raw statistic records, rollup windows before its aligned value are closed
+  std::atomic<int64_t> WorkersUpdateTime_ = 0;
+  std::atomic<int64_t> PoolUpdateTime_ = 0;
 
   kvdb<rocksdbBase> WorkerStatsDb_;
   kvdb<rocksdbBase> PoolStatsDb_;
   std::deque<CStatsFile> PoolStatsCache_;
   std::deque<CStatsFile> WorkersStatsCache_;
+  std::deque<CRollupTier> WorkerRollups_;
+  std::deque<CRollupTier> PoolRollups_;
 
   TaskHandlerCoroutine<StatisticDb> TaskHandler_;
   aioUserEvent *WorkerStatsUpdaterEvent_;
@@ -229,9 +279,14 @@ private:
   bool parseStatsCacheFile(CStatsFile &file);
 
   void enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, bool isOldFormat);
-  void updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData);
+  void updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData, kvdb<rocksdbBase>::MultiPartitionBatch &batch);
   void calcAverageMetrics(const StatisticDb::CStatsAccumulator &acc, std::chrono::seconds calculateInterval, std::chrono::seconds aggregateTime, CStats &result);
-  void writeStatsToDb(const std::string &loginId, const std::string &workerId, const CStatsElement &element);
+  void updateUserStatsIndex(bool recalculateActive);
+  void initRollups(std::deque<CRollupTier> &tiers, const char *name);
+  void updateRollups(kvdb<rocksdbBase> &db, std::deque<CRollupTier> &tiers, int64_t previousTime, int64_t currentTime, bool isPoolStats);
+  void cleanupRollup(CRollupTier &tier, int64_t currentTime);
+  void accumulateHistory(kvdb<rocksdbBase> &db, const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, int64_t firstTimeLabel, std::vector<CStatsElement> &stats);
+  void writeStatsToDb(kvdb<rocksdbBase>::MultiPartitionBatch &batch, const std::string &loginId, const std::string &workerId, const CStatsElement &element);
   void writeStatsToCache(const std::string &loginId, const std::string &workerId, const CStatsElement &element, int64_t lastShareTime, xmstream &statsFileData);
 
   void updateStatsDiskCache(const char *name, std::deque<CStatsFile> &cache, int64_t timeLabel, uint64_t lastShareId, const void *data, size_t size);
@@ -263,10 +318,6 @@ public:
   const CStats &getPoolStats() { return PoolStatsCached_; }
   void getUserStats(const std::string &user, CStats &aggregate, std::vector<CStats> &workerStats, size_t offset, size_t size, EStatsColumn sortBy, bool sortDescending);
 
-  /// Return recent statistic for users
-  /// result - sorted by UserId
-  void exportRecentStats(std::vector<CStatsExportData> &result);
-
   // Synchronous api
   void getHistory(const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, std::vector<CStats> &history);
 
@@ -413,7 +464,7 @@ private:
     TaskShare(CShare *share) : Share_(share) {}
     void run(StatisticServer *backend) final { backend->onShare(Share_.get()); }
   private:
-    std::unique_ptr<CShare> Share_;
+    CSharePtr Share_;
   };
 
 private:
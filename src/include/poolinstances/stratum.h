@@ -3,6 +3,7 @@
 #include "common.h"
 #include "stratumMsg.h"
 #include "stratumWorkStorage.h"
+#include "vardiff.h"
 #include "poolcommon/arith_uint256.h"
 #include "poolcommon/debug.h"
 #include "poolcommon/jsonSerializer.h"
@@ -10,6 +11,7 @@
 #include "poolcore/blockTemplate.h"
 #include "poolcore/poolCore.h"
 #include "poolcore/poolInstance.h"
+#include "poolcore/sharePool.h"
 #include <openssl/rand.h>
 #include <rapidjson/writer.h>
 #include <unordered_map>
@@ -96,17 +98,42 @@ public:
 
     // Share diff
     if (config.HasMember("shareDiff")) {
-      if (config["shareDiff"].IsUint64()) {
-        ConstantShareDiff_ = static_cast<double>(config["shareDiff"].GetUint64());
-      } else if (config["shareDiff"].IsFloat()) {
-        ConstantShareDiff_ = config["shareDiff"].GetFloat();
-      } else {
-        LOG_F(ERROR, "%s: 'shareDiff' must be an integer", Name_.c_str());
+      if (!readDifficulty(config, "shareDiff", &InitialShareDiff_)) {
+        LOG_F(ERROR, "%s: 'shareDiff' must be a number", Name_.c_str());
         exit(1);
       }
     } else if (config.HasMember("varDiffTarget") && config.HasMember("minShareDiff")) {
-      LOG_F(ERROR, "%s: Vardiff not supported now", Name_.c_str());
-      exit(1);
+      // Variable difficulty
+      // varDiffTarget: target shares per minute for one connection
+      // varDiffWindow: share rate measurement window in seconds (optional)
+      // maxShareDiff, startShareDiff: optional
+      VarDiffCfg_.Enabled = true;
+      if (!readDifficulty(config, "varDiffTarget", &VarDiffCfg_.TargetSharesPerMinute) || VarDiffCfg_.TargetSharesPerMinute <= 0.0) {
+        LOG_F(ERROR, "%s: 'varDiffTarget' must be a positive number", Name_.c_str());
+        exit(1);
+      }
+      if (!readDifficulty(config, "minShareDiff", &VarDiffCfg_.MinDifficulty) || VarDiffCfg_.MinDifficulty <= 0.0) {
+        LOG_F(ERROR, "%s: 'minShareDiff' must be a positive number", Name_.c_str());
+        exit(1);
+      }
+      if (config.HasMember("maxShareDiff") && (!readDifficulty(config, "maxShareDiff", &VarDiffCfg_.MaxDifficulty) || VarDiffCfg_.MaxDifficulty < VarDiffCfg_.MinDifficulty)) {
+        LOG_F(ERROR, "%s: 'maxShareDiff' must be a number not less than 'minShareDiff'", Name_.c_str());
+        exit(1);
+      }
+      VarDiffCfg_.StartDifficulty = VarDiffCfg_.MinDifficulty;
+      if (config.HasMember("startShareDiff") && !readDifficulty(config, "startShareDiff", &VarDiffCfg_.StartDifficulty)) {
+        LOG_F(ERROR, "%s: 'startShareDiff' must be a number", Name_.c_str());
+        exit(1);
+      }
+      if (config.HasMember("varDiffWindow")) {
+        if (!config["varDiffWindow"].IsUint() || config["varDiffWindow"].GetUint() == 0) {
+          LOG_F(ERROR, "%s: 'varDiffWindow' must be a positive integer (seconds)", Name_.c_str());
+          exit(1);
+        }
+        VarDiffCfg_.RetargetWindow = config["varDiffWindow"].GetUint() * 1000000ULL;
+      }
+
+      InitialShareDiff_ = VarDiffCfg_.clamp(VarDiffCfg_.StartDifficulty, 0.0);
     } else {
       LOG_F(ERROR, "instance %s: no share difficulty config (expected 'shareDiff' for constant difficulty or 'varDiffTarget' and 'minShareDiff' for variable diff", Name_.c_str());
       exit(1);
@@ -132,15 +159,23 @@ public:
   }
 
   virtual void checkNewBlockTemplate(CBlockTemplate *blockTemplate, PoolBackend *backend) override {
-    for (unsigned i = 0; i < ThreadPool_.threadsNum(); i++)
-      ThreadPool_.startAsyncTask(i, new AcceptWork(*this, blockTemplate, backend));
+    // Templates of one backend always prepared by same thread, it keeps order of works
+    unsigned prepareThreadId = 0;
+    for (size_t i = 0, ie = LinkedBackends_.size(); i != ie; ++i) {
+      if (LinkedBackends_[i] == backend) {
+        prepareThreadId = i % ThreadPool_.threadsNum();
+        break;
+      }
+    }
+
+    ThreadPool_.startAsyncTask(prepareThreadId, new PrepareWork(*this, blockTemplate, backend));
     if (MiningStats_)
       MiningStats_->onWork(blockTemplate->Difficulty, backend);
   }
 
   virtual void stopWork() override {
     for (unsigned i = 0; i < ThreadPool_.threadsNum(); i++)
-      ThreadPool_.startAsyncTask(i, new AcceptWork(*this, nullptr, nullptr));
+      ThreadPool_.startAsyncTask(i, new AcceptWork(*this, nullptr, 0, nullptr, std::vector<uint8_t>()));
   }
 
   void acceptConnection(unsigned workerId, socketTy socketFd, HostAddress address) {
@@ -156,16 +191,14 @@ public:
       LOG_F(1, "%s: new connection from %s", Name_.c_str(), connection->AddressHr.c_str());
 
     // Initialize share difficulty
-    connection->ShareDifficulty = ConstantShareDiff_;
+    connection->ShareDifficulty = InitialShareDiff_;
+    if (VarDiffCfg_.Enabled)
+      connection->VarDiff.reset(CVarDiff::now());
 
     aioRead(connection->Socket, connection->Buffer, sizeof(connection->Buffer), afNone, 3000000, reinterpret_cast<aioCb*>(readCb), connection);
   }
 
-  void acceptWork(CBlockTemplate *blockTemplate, PoolBackend *backend) {
-    if (!blockTemplate) {
-      return;
-    }
-
+  void prepareWork(CBlockTemplate *blockTemplate, PoolBackend *backend) {
     ThreadData &data = Data_[GetLocalThreadId()];
     typename X::Proto::AddressTy miningAddress;
     auto &backendConfig = backend->getConfig();
@@ -176,9 +209,34 @@ public:
       return;
     }
 
-    bool isNewBlock = false;
+    // Parse block template once, all threads use same prepared data
+    std::string error;
     std::vector<uint8_t> miningAddressData(miningAddress.begin(), miningAddress.end());
-    if (!data.WorkStorage.createWork(*blockTemplate, backend, coinInfo.Name, miningAddressData, backendConfig.CoinBaseMsg, MiningCfg_, Name_, &isNewBlock))
+    intrusive_ptr<CPreparedWork> prepared(data.WorkStorage.prepareWork(*blockTemplate, backend, coinInfo.Name, miningAddressData, backendConfig.CoinBaseMsg, MiningCfg_, error));
+    if (!prepared.get()) {
+      LOG_F(ERROR, "%s: can't process block template; error: %s", Name_.c_str(), error.c_str());
+      return;
+    }
+
+    for (unsigned i = 0; i < ThreadPool_.threadsNum(); i++) {
+      if (i != GetLocalThreadId())
+        ThreadPool_.startAsyncTask(i, new AcceptWork(*this, prepared.get(), blockTemplate->UniqueWorkId, backend, miningAddressData));
+    }
+
+    acceptWork(prepared, blockTemplate->UniqueWorkId, backend, miningAddressData);
+  }
+
+  void acceptWork(const intrusive_ptr<CPreparedWork> &prepared, uint64_t uniqueWorkId, PoolBackend *backend, const std::vector<uint8_t> &miningAddress) {
+    if (!prepared.get()) {
+      return;
+    }
+
+    ThreadData &data = Data_[GetLocalThreadId()];
+    auto &backendConfig = backend->getConfig();
+    auto &coinInfo = backend->getCoinInfo();
+
+    bool isNewBlock = false;
+    if (!data.WorkStorage.createWork(prepared, uniqueWorkId, backend, coinInfo.Name, miningAddress, backendConfig.CoinBaseMsg, MiningCfg_, Name_, &isNewBlock))
       return;
 
     CWork *work = nullptr;
@@ -247,19 +305,40 @@ public:
       // If previous work has been updated (new block came), we need send 'true' as a last field of stratum.notify
       bool resetPreviousWork = isNewBlock && !X::Stratum::keepOldWorkForBackend(coinInfo.Name);
 
+      // Notify message built once and shared by all connections of thread
       work->buildNotifyMessage(resetPreviousWork);
+      const xmstream &notifyMessage = work->notifyMessage();
       int64_t currentTime = time(nullptr);
+      int64_t varDiffTime = CVarDiff::now();
+
+      // Connections with higher share difficulty (and hashrate) receive new job first
+      data.BroadcastQueue.assign(data.Connections_.begin(), data.Connections_.end());
+      std::sort(data.BroadcastQueue.begin(), data.BroadcastQueue.end(), [](const Connection *l, const Connection *r) { return l->ShareDifficulty > r->ShareDifficulty; });
+
       unsigned counter = 0;
-      for (auto &connection: data.Connections_) {
+      for (Connection *connection: data.BroadcastQueue) {
         connection->ResendCount = 0;
-        stratumSendWork(connection, work, currentTime);
+        connection->LastUpdateTime = currentTime;
+        // Lower difficulty for connections without shares before sending new job
+        // New target and job sent with one write
+        if (VarDiffCfg_.Enabled && varDiffUpdate(connection, varDiffTime, false)) {
+          data.SendBuffer.reset();
+          X::Stratum::buildSendTargetMessage(data.SendBuffer, connection->ShareDifficulty);
+          data.SendBuffer.write('\n');
+          data.SendBuffer.write(notifyMessage.data(), notifyMessage.sizeOf());
+          send(connection, data.SendBuffer);
+        } else {
+          send(connection, notifyMessage);
+        }
         counter++;
       }
 
       auto endPt = std::chrono::steady_clock::now();
-      auto timeDiff = std::chrono::duration_cast<std::chrono::milliseconds>(endPt - beginPt).count();
+      auto timeDiff = std::chrono::duration_cast<std::chrono::microseconds>(endPt - beginPt).count();
       if (GetLocalThreadId() == 0)
-        LOG_F(INFO, "[t=0] %s: Broadcast %s work %" PRIi64 "(reset=%s) & send to %u clients in %.3lf seconds", Name_.c_str(), workName(work).c_str(), work->stratumId(), resetPreviousWork ? "yes" : "no", counter, static_cast<double>(timeDiff)/1000.0);
+        LOG_F(INFO, "[t=0] %s: Broadcast %s work %" PRIi64 "(reset=%s) & send to %u clients in %.3lf seconds", Name_.c_str(), workName(work).c_str(), work->stratumId(), resetPreviousWork ? "yes" : "no", counter, static_cast<double>(timeDiff)/1000000.0);
+      else
+        LOG_F(1, "[t=%u] %s: send work %" PRIi64 " to %u clients in %.3lf seconds", static_cast<unsigned>(GetLocalThreadId()), Name_.c_str(), work->stratumId(), counter, static_cast<double>(timeDiff)/1000000.0);
     }
   }
 
@@ -274,19 +353,33 @@ private:
     HostAddress Address_;
   };
 
-  class AcceptWork : public CThreadPool::Task {
+  class PrepareWork : public CThreadPool::Task {
   public:
-    AcceptWork(StratumInstance &instance, CBlockTemplate *blockTemplate, PoolBackend *backend) : Instance_(instance), BlockTemplate_(blockTemplate), Backend_(backend) {}
-    void run(unsigned) final { Instance_.acceptWork(BlockTemplate_.get(), Backend_); }
+    PrepareWork(StratumInstance &instance, CBlockTemplate *blockTemplate, PoolBackend *backend) : Instance_(instance), BlockTemplate_(blockTemplate), Backend_(backend) {}
+    void run(unsigned) final { Instance_.prepareWork(BlockTemplate_.get(), Backend_); }
   private:
     StratumInstance &Instance_;
     intrusive_ptr<CBlockTemplate> BlockTemplate_;
     PoolBackend *Backend_;
   };
 
+  class AcceptWork : public CThreadPool::Task {
+  public:
+    AcceptWork(StratumInstance &instance, CPreparedWork *prepared, uint64_t uniqueWorkId, PoolBackend *backend, const std::vector<uint8_t> &miningAddress) :
+      Instance_(instance), Prepared_(prepared), UniqueWorkId_(uniqueWorkId), Backend_(backend), MiningAddress_(miningAddress) {}
+    void run(unsigned) final { Instance_.acceptWork(Prepared_, UniqueWorkId_, Backend_, MiningAddress_); }
+  private:
+    StratumInstance &Instance_;
+    intrusive_ptr<CPreparedWork> Prepared_;
+    uint64_t UniqueWorkId_;
+    PoolBackend *Backend_;
+    std::vector<uint8_t> MiningAddress_;
+  };
+
   struct Worker {
     std::string User;
     std::string WorkerName;
+    CUserWorkerTable::CIdentity Identity;
   };
 
   struct Connection {
@@ -326,10 +419,15 @@ private:
     // Stratum protocol decoding
     char Buffer[12288];
     size_t MsgTailSize = 0;
+    // Decoded message, reused for keeping string buffers allocated between shares
+    typename X::Stratum::StratumMessage Msg;
     // Mining info
     typename X::Stratum::WorkerConfig WorkerConfig;
     // Current share difficulty (one for all workers on connection)
     double ShareDifficulty;
+    // Lower bound of share difficulty for this connection (NiceHash requirements)
+    double MinShareDifficulty = 0.0;
+    CVarDiff VarDiff;
     // Workers
     std::unordered_map<std::string, Worker> Workers;
     // Share statistic
@@ -348,6 +446,9 @@ private:
     asyncBase *WorkerBase;
     ThreadConfig ThreadCfg;
     std::set<Connection*> Connections_;
+    // Reusable buffers for work broadcasting
+    std::vector<Connection*> BroadcastQueue;
+    xmstream SendBuffer;
     StratumWorkStorage<X> WorkStorage;
     aioUserEvent *Timer;
   };
@@ -378,12 +479,13 @@ private:
     if (msg.Subscribe.minerUserAgent.find("NiceHash") != std::string::npos) {
       connection->IsNiceHash = true;
       if (AlgoMetaStatistic_->coinInfo().Name == "sha256") {
-        connection->ShareDifficulty = std::max(500000.0, connection->ShareDifficulty);
+        connection->MinShareDifficulty = 500000.0;
       } else if (AlgoMetaStatistic_->coinInfo().Name == "scrypt") {
-        connection->ShareDifficulty = std::max(10.0, connection->ShareDifficulty);
+        connection->MinShareDifficulty = 10.0;
       } else if (AlgoMetaStatistic_->coinInfo().Name == "equihash.200.9") {
-        connection->ShareDifficulty = std::max(131072.0, connection->ShareDifficulty);
+        connection->MinShareDifficulty = 131072.0;
       }
+      connection->ShareDifficulty = std::max(connection->MinShareDifficulty, connection->ShareDifficulty);
     }
 
     std::string subscribeInfo;
@@ -404,6 +506,7 @@ private:
       Worker worker;
       worker.User.assign(msg.Authorize.login.begin(), msg.Authorize.login.begin() + dotPos);
       worker.WorkerName.assign(msg.Authorize.login.begin() + dotPos + 1, msg.Authorize.login.end());
+      worker.Identity = CUserWorkerTable::intern(worker.User, worker.WorkerName);
       connection->Workers.insert(std::make_pair(msg.Authorize.login, worker));
       authSuccess = UserMgr_.checkUser(worker.User);
     } else {
@@ -550,7 +653,7 @@ private:
           LOG_F(INFO, "* block %s (%" PRIu64 ") accepted by %s", blockHash.c_str(), height, hostName.c_str());
           if (successNum == 1) {
             // Send share with block to backend
-            CShare *backendShare = new CShare;
+            CShare *backendShare = CSharePool::alloc();
             backendShare->Time = time(nullptr);
             backendShare->userId = userName;
             backendShare->workerId = workerName;
@@ -629,6 +732,8 @@ private:
 
     // Loop over all affected backends (usually 1 or 2 with enabled merged mining)
     bool shareAccepted = false;
+    double shareDifficulty = connection->ShareDifficulty;
+    int64_t varDiffTime = VarDiffCfg_.Enabled ? CVarDiff::now() : 0;
     for (size_t i = 0, ie = work->backendsNum(); i != ie; ++i) {
       PoolBackend *backend = work->backend(i);
       if (!backend) {
@@ -642,7 +747,9 @@ private:
       height = work->height(i);
       checkStatus = work->checkConsensus(i);
 
-      if (checkStatus.ShareDiff < connection->ShareDifficulty) {
+      double acceptedDifficulty = connection->ShareDifficulty;
+      if (checkStatus.ShareDiff < acceptedDifficulty &&
+          !(VarDiffCfg_.Enabled && connection->VarDiff.acceptPrevious(checkStatus.ShareDiff, varDiffTime, &acceptedDifficulty))) {
         if (isDebugInstanceStratumRejects())
           LOG_F(1,
                 "%s(%s) %s/%s sub-reject(%s): invalid share difficulty %lg (%lg required)",
@@ -657,6 +764,7 @@ private:
       }
 
       shareAccepted = true;
+      shareDifficulty = acceptedDifficulty;
       if (checkStatus.IsBlock) {
         LOG_F(INFO, "%s: new proof of work for %s found; hash: %s; transactions: %zu", Name_.c_str(), backend->getCoinInfo().Name.c_str(), blockHash.c_str(), work->txNum(i));
 
@@ -665,7 +773,6 @@ private:
         work->buildBlock(i, blockHexData);
 
         int64_t generatedCoins = work->blockReward(i);
-        double shareDifficulty = connection->ShareDifficulty;
         double expectedWork = work->expectedWork(i);
         CNetworkClientDispatcher &dispatcher = backend->getClientDispatcher();
         dispatcher.aioSubmitBlock(data.WorkerBase, blockHexData.data(), blockHexData.sizeOf(), [height, blockHash, generatedCoins, expectedWork, backend, shareDifficulty, worker](bool success, uint32_t successNum, const std::string &hostName, const std::string &error) {
@@ -673,10 +780,12 @@ private:
             LOG_F(INFO, "* block %s (%" PRIu64 ") accepted by %s", blockHash.c_str(), height, hostName.c_str());
             if (successNum == 1) {
               // Send share with block to backend
-              CShare *backendShare = new CShare;
+              CShare *backendShare = CSharePool::alloc();
               backendShare->Time = time(nullptr);
               backendShare->userId = worker.User;
               backendShare->workerId = worker.WorkerName;
+              backendShare->UserIndex = worker.Identity.User;
+              backendShare->WorkerIndex = worker.Identity.Worker;
               backendShare->height = height;
               backendShare->WorkValue = shareDifficulty;
               backendShare->isBlock = true;
@@ -697,17 +806,19 @@ private:
           }
         }
       } else {
-        CShare *backendShare = new CShare;
+        CShare *backendShare = CSharePool::alloc();
         backendShare->Time = time(nullptr);
         backendShare->userId = worker.User;
         backendShare->workerId = worker.WorkerName;
+        backendShare->UserIndex = worker.Identity.User;
+        backendShare->WorkerIndex = worker.Identity.Worker;
         backendShare->height = height;
-        backendShare->WorkValue = connection->ShareDifficulty;
+        backendShare->WorkValue = shareDifficulty;
         backendShare->isBlock = false;
         backend->sendShare(backendShare);
 
         if (checkStatus.IsPendingBlock) {
-          if (data.WorkStorage.updatePending(i, worker.User, worker.WorkerName, checkStatus.ShareDiff, connection->ShareDifficulty, xatoi<uint64_t>(msg.Submit.JobId.c_str()), connection->WorkerConfig, msg))
+          if (data.WorkStorage.updatePending(i, worker.User, worker.WorkerName, checkStatus.ShareDiff, shareDifficulty, xatoi<uint64_t>(msg.Submit.JobId.c_str()), connection->WorkerConfig, msg))
             LOG_F(INFO, "%s: new pending block %s found; hash: %s", Name_.c_str(), backend->getCoinInfo().Name.c_str(), blockHash.c_str());
         }
       }
@@ -716,22 +827,25 @@ private:
     if (!shareAccepted)
       errorCode = StratumErrorInvalidShare;
 
-    if (shareAccepted && (AlgoMetaStatistic_ || true)) {
-      CShare *backendShare = new CShare;
-      backendShare->Time = time(nullptr);
-      backendShare->userId = worker.User;
-      backendShare->workerId = worker.WorkerName;
-      backendShare->height = height;
-      backendShare->WorkValue = connection->ShareDifficulty;
-      backendShare->isBlock = false;
-      if (AlgoMetaStatistic_)
+    if (shareAccepted) {
+      if (AlgoMetaStatistic_) {
+        CShare *backendShare = CSharePool::alloc();
+        backendShare->Time = time(nullptr);
+        backendShare->userId = worker.User;
+        backendShare->workerId = worker.WorkerName;
+        backendShare->UserIndex = worker.Identity.User;
+        backendShare->WorkerIndex = worker.Identity.Worker;
+        backendShare->height = height;
+        backendShare->WorkValue = shareDifficulty;
+        backendShare->isBlock = false;
         AlgoMetaStatistic_->sendShare(backendShare);
+      }
 
       // Share
       // All affected coins by this share
       // Difficulty of all affected coins
       if (MiningStats_)
-        MiningStats_->onShare(checkStatus.ShareDiff, connection->ShareDifficulty, LinkedBackends_, foundBlockMask, shareHash);
+        MiningStats_->onShare(checkStatus.ShareDiff, shareDifficulty, LinkedBackends_, foundBlockMask, shareHash);
     }
 
     return shareAccepted;
@@ -781,6 +895,11 @@ private:
     stream.write('\n');
     send(connection, stream);
 
+    if (result && VarDiffCfg_.Enabled) {
+      connection->VarDiff.addShare();
+      varDiffUpdate(connection, CVarDiff::now());
+    }
+
     if (!result) {
       // Calculate invalid shares percentage
       uint32_t invalidSharedPercent = 0;
@@ -846,6 +965,20 @@ private:
     send(connection, stream);
   }
 
+  // Returns true if share difficulty changed, new target sent only if 'sendTarget' is set
+  bool varDiffUpdate(Connection *connection, int64_t time, bool sendTarget = true) {
+    double previousDifficulty = connection->ShareDifficulty;
+    if (connection->VarDiff.update(VarDiffCfg_, time, connection->MinShareDifficulty, &connection->ShareDifficulty)) {
+      if (isDebugInstanceStratumConnections())
+        LOG_F(1, "%s(%s): vardiff %lg -> %lg", Name_.c_str(), connection->AddressHr.c_str(), previousDifficulty, connection->ShareDifficulty);
+      if (sendTarget)
+        stratumSendTarget(connection);
+      return true;
+    }
+
+    return false;
+  }
+
   void stratumSendWork(Connection *connection, CWork *work, int64_t currentTime) {
     connection->LastUpdateTime = currentTime;
     send(connection, work->notifyMessage());
@@ -876,7 +1009,7 @@ private:
     while (p != e && (nextMsgPos = static_cast<const char*>(memchr(p, '\n', e - p)))) {
       // parse stratum message
       bool result = true;
-      typename X::Stratum::StratumMessage msg;
+      typename X::Stratum::StratumMessage &msg = connection->Msg;
       size_t stratumMsgSize = nextMsgPos - p;
       if (isDebugInstanceStratumMessages()) {
         std::string msg(p, stratumMsgSize);
@@ -990,6 +1123,17 @@ private:
     }
   }
 
+  static bool readDifficulty(rapidjson::Value &config, const char *name, double *out) {
+    rapidjson::Value &value = config[name];
+    if (value.IsUint64())
+      *out = static_cast<double>(value.GetUint64());
+    else if (value.IsDouble())
+      *out = value.GetDouble();
+    else
+      return false;
+    return true;
+  }
+
   std::string workName(CWork *work) {
     std::string name;
     for (size_t i = 0; i < work->backendsNum(); i++) {
@@ -1008,7 +1152,9 @@ private:
   std::unique_ptr<ThreadData[]> Data_;
   std::string Name_ = "stratum";
   typename X::Stratum::MiningConfig MiningCfg_;
-  double ConstantShareDiff_;
+  // Constant share difficulty or start difficulty for vardiff
+  double InitialShareDiff_;
+  CVarDiffConfig VarDiffCfg_;
 
   // Profit switcher section
   bool ProfitSwitcherEnabled_ = false;
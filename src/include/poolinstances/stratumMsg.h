@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
+#include <string.h>
 #include <vector>
 #include "poolcommon/utils.h"
 #include "p2putils/strExtras.h"
@@ -65,3 +67,201 @@ struct StratumMiningConfigure {
 struct StratumMiningSuggestDifficulty {
   double Difficulty;
 };
+
+// Allocation-free scanner for flat stratum requests like
+//   {"id": 4, "method": "mining.submit", "params": ["user.worker", "1f", "00000001", "5f5e1000", "1a2b3c4d"]}
+// Tokens point into source buffer. Scanner accepts only scalar params and strings without escape sequences,
+// all other messages must be decoded with DOM parser.
+struct CStratumToken {
+  enum EType {
+    ENone = 0,
+    EString,
+    ENumber,
+    ELiteral
+  };
+
+  EType Type = ENone;
+  const char *Data = nullptr;
+  size_t Size = 0;
+
+  bool isString() const { return Type == EString; }
+  bool isNull() const { return Type == ELiteral && Size == 4 && memcmp(Data, "null", 4) == 0; }
+  bool equal(const char *s, size_t size) const { return Type == EString && Size == size && memcmp(Data, s, size) == 0; }
+  template<size_t N> bool equal(const char (&s)[N]) const { return equal(s, N-1); }
+  void assign(std::string &out) const { out.assign(Data, Size); }
+
+  bool getUint64(uint64_t &out) const {
+    if (Type != ENumber || Size == 0 || Size > 20)
+      return false;
+    uint64_t value = 0;
+    for (size_t i = 0; i < Size; i++) {
+      if (Data[i] < '0' || Data[i] > '9')
+        return false;
+      uint64_t digit = static_cast<uint64_t>(Data[i] - '0');
+      if (value > (UINT64_MAX - digit) / 10)
+        return false;
+      value = value*10 + digit;
+    }
+    out = value;
+    return true;
+  }
+};
+
+struct CStratumRawMessage {
+  static constexpr unsigned MaxParams = 8;
+  CStratumToken Id;
+  CStratumToken Method;
+  CStratumToken Params[MaxParams];
+  unsigned ParamsNum = 0;
+  bool HasParams = false;
+
+  // Returns false if message can't be processed without DOM parser; it's not always a protocol error
+  bool scan(const char *in, size_t size) {
+    const char *p = in;
+    const char *end = in + size;
+    Id.Type = CStratumToken::ENone;
+    Method.Type = CStratumToken::ENone;
+    ParamsNum = 0;
+    HasParams = false;
+
+    skipSpaces(p, end);
+    if (p == end || *p++ != '{')
+      return false;
+    for (;;) {
+      CStratumToken key;
+      skipSpaces(p, end);
+      if (!scanString(p, end, key))
+        return false;
+      skipSpaces(p, end);
+      if (p == end || *p++ != ':')
+        return false;
+      skipSpaces(p, end);
+
+      if (key.equal("params")) {
+        if (p != end && *p == '[') {
+          p++;
+          if (!scanParams(p, end))
+            return false;
+        } else {
+          // Some clients put null to 'params' field
+          CStratumToken value;
+          if (!scanScalar(p, end, value) || !value.isNull())
+            return false;
+        }
+        HasParams = true;
+      } else {
+        CStratumToken value;
+        if (!scanScalar(p, end, value))
+          return false;
+        if (key.equal("id"))
+          Id = value;
+        else if (key.equal("method"))
+          Method = value;
+      }
+
+      skipSpaces(p, end);
+      if (p == end)
+        return false;
+      char c = *p++;
+      if (c == '}')
+        break;
+      if (c != ',')
+        return false;
+    }
+
+    skipSpaces(p, end);
+    return p == end && Id.Type != CStratumToken::ENone && Method.isString() && HasParams;
+  }
+
+private:
+  static void skipSpaces(const char *&p, const char *end) {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      p++;
+  }
+
+  static bool scanString(const char *&p, const char *end, CStratumToken &token) {
+    if (p == end || *p != '"')
+      return false;
+    const char *begin = ++p;
+    while (p != end && *p != '"') {
+      if (*p == '\\' || static_cast<unsigned char>(*p) < 0x20)
+        return false;
+      p++;
+    }
+    if (p == end)
+      return false;
+    token.Type = CStratumToken::EString;
+    token.Data = begin;
+    token.Size = static_cast<size_t>(p - begin);
+    p++;
+    return true;
+  }
+
+  static bool scanScalar(const char *&p, const char *end, CStratumToken &token) {
+    if (p == end)
+      return false;
+    if (*p == '"')
+      return scanString(p, end, token);
+
+    const char *begin = p;
+    bool isNumber = (*p >= '0' && *p <= '9') || *p == '-';
+    while (p != end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+      char c = *p;
+      if (c == '[' || c == '{' || c == '"')
+        return false;
+      p++;
+    }
+
+    token.Data = begin;
+    token.Size = static_cast<size_t>(p - begin);
+    if (isNumber) {
+      token.Type = CStratumToken::ENumber;
+    } else if ((token.Size == 4 && (memcmp(begin, "null", 4) == 0 || memcmp(begin, "true", 4) == 0)) ||
+               (token.Size == 5 && memcmp(begin, "false", 5) == 0)) {
+      token.Type = CStratumToken::ELiteral;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  bool scanParams(const char *&p, const char *end) {
+    skipSpaces(p, end);
+    if (p != end && *p == ']') {
+      p++;
+      return true;
+    }
+
+    for (;;) {
+      if (ParamsNum == MaxParams)
+        return false;
+      skipSpaces(p, end);
+      if (!scanScalar(p, end, Params[ParamsNum++]))
+        return false;
+      skipSpaces(p, end);
+      if (p == end)
+        return false;
+      char c = *p++;
+      if (c == ']')
+        return true;
+      if (c != ',')
+        return false;
+    }
+  }
+};
+
+// Id decoding compatible with DOM parser: unsigned integer or string
+static inline bool decodeStratumId(const CStratumToken &token, int64_t &integerId, std::string &stringId)
+{
+  uint64_t id;
+  if (token.getUint64(id)) {
+    integerId = static_cast<int64_t>(id);
+    stringId.clear();
+    return true;
+  } else if (token.isString()) {
+    token.assign(stringId);
+    return true;
+  } else {
+    return false;
+  }
+}
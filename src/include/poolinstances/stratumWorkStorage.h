@@ -1,14 +1,103 @@
 #pragma once
 
 #include "blockmaker/stratumWork.h"
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "loguru.hpp"
 
+// Accepted shares of one work generation: open addressing table of 64-bit share hash fingerprints with linear probing
+class CAcceptedShareFilter {
+public:
+  CAcceptedShareFilter() { allocate(MinCapacity); }
+
+  bool contains(uint64_t fingerprint) const {
+    fingerprint |= !fingerprint;
+    for (size_t i = slot(fingerprint);; i = (i + 1) & (Capacity_ - 1)) {
+      if (Table_[i] == fingerprint)
+        return true;
+      if (Table_[i] == 0)
+        return false;
+    }
+  }
+
+  /// Returns false if share with same fingerprint already accepted
+  bool insert(uint64_t fingerprint) {
+    // Zero marks empty slot
+    fingerprint |= !fingerprint;
+    if ((Size_ + 1) * 2 > Capacity_)
+      rehash(Capacity_ * 2);
+
+    for (size_t i = slot(fingerprint);; i = (i + 1) & (Capacity_ - 1)) {
+      if (Table_[i] == fingerprint)
+        return false;
+      if (Table_[i] == 0) {
+        Table_[i] = fingerprint;
+        Size_++;
+        return true;
+      }
+    }
+  }
+
+  size_t size() const { return Size_; }
+
+  /// Removes all fingerprints, table grown by share burst shrinks to base capacity
+  void clear() {
+    if (Capacity_ > MinCapacity)
+      allocate(MinCapacity);
+    else
+      std::fill(Table_.get(), Table_.get() + Capacity_, 0);
+    Size_ = 0;
+  }
+
+  template<typename HashTy>
+  static uint64_t fingerprint(const HashTy &hash) {
+    // Proof of work hash has zero bits at one end, mix all words
+    uint64_t result = 0;
+    for (unsigned i = 0; i < sizeof(HashTy) / sizeof(uint64_t); i++)
+      result ^= hash.GetUint64(i);
+    return result;
+  }
+
+private:
+  static constexpr size_t MinCapacity = 256;
+
+  size_t slot(uint64_t fingerprint) const { return (fingerprint * 0x9E3779B97F4A7C15ULL) >> Shift_; }
+
+  void allocate(size_t capacity) {
+    Table_.reset(new uint64_t[capacity]());
+    Capacity_ = capacity;
+    Shift_ = 64;
+    while (capacity > 1) {
+      capacity >>= 1;
+      Shift_--;
+    }
+  }
+
+  void rehash(size_t capacity) {
+    std::unique_ptr<uint64_t[]> oldTable = std::move(Table_);
+    size_t oldCapacity = Capacity_;
+    allocate(capacity);
+    for (size_t i = 0; i < oldCapacity; i++) {
+      if (!oldTable[i])
+        continue;
+      size_t j = slot(oldTable[i]);
+      while (Table_[j])
+        j = (j + 1) & (Capacity_ - 1);
+      Table_[j] = oldTable[i];
+    }
+  }
+
+private:
+  std::unique_ptr<uint64_t[]> Table_;
+  size_t Capacity_ = 0;
+  size_t Size_ = 0;
+  unsigned Shift_ = 64;
+};
+
 template<typename X>
 class StratumWorkStorage {
 public:
@@ -29,7 +118,6 @@ public:
   using CMergedWork = StratumMergedWork<typename X::Proto::BlockHashTy, typename X::Stratum::MiningConfig, typename X::Stratum::WorkerConfig, typename X::Stratum::StratumMessage>;
   using CSingleWorkSequence = std::deque<std::unique_ptr<CSingleWork>>;
   using CMergedWorkSequence = std::deque<std::unique_ptr<CMergedWork>>;
-  using CAcceptedShareSet = std::unordered_set<typename X::Proto::BlockHashTy>;
   using CWorkIndex = std::pair<size_t, size_t>;
 
 private:
@@ -47,7 +135,7 @@ public:
     BackendsNum_ = backends.size();
     WorkStorage_.reset(new CSingleWorkSequence[BackendsNum_]);
     MergedWorkStorage_.reset(new CMergedWorkSequence[BackendsNum_ * BackendsNum_]);
-    AcceptedShares_.reset(new CAcceptedShareSet[BackendsNum_]);
+    AcceptedShares_.reset(new std::deque<CAcceptedShareFilter>[BackendsNum_]);
     PendingShares_.reset(new CPendingShare[BackendsNum_]);
     FirstBackends_.reset(new bool[BackendsNum_]);
 
@@ -79,23 +167,34 @@ public:
     return !sequence.empty() ? sequence.back().get() : nullptr;
   }
 
+  /// Build block template data shared by works of all threads
+  /// Returns nullptr on error
+  CPreparedWork *prepareWork(CBlockTemplate &blockTemplate, PoolBackend *backend, const std::string &ticker, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMsg, const typename X::Stratum::MiningConfig &miningConfig, std::string &error) {
+    auto It = BackendMap_.find(backend);
+    if (It == BackendMap_.end()) {
+      error = "unknown backend";
+      return nullptr;
+    }
+
+    if (FirstBackends_[It->second])
+      return X::Stratum::Work::prepare(blockTemplate, ticker, miningConfig, miningAddress, coinbaseMsg, error);
+    else
+      return X::Stratum::SecondWork::prepare(blockTemplate, ticker, miningConfig, miningAddress, coinbaseMsg, error);
+  }
+
   /// Add work
-  bool createWork(CBlockTemplate &blockTemplate, PoolBackend *backend, const std::string &ticker, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMsg, typename X::Stratum::MiningConfig &miningConfig, const std::string &stratumInstanceName, bool *isNewBlock) {
+  bool createWork(const intrusive_ptr<CPreparedWork> &prepared, uint64_t uniqueWorkId, PoolBackend *backend, const std::string &ticker, const std::vector<uint8_t> &miningAddress, const std::string &coinbaseMsg, typename X::Stratum::MiningConfig &miningConfig, const std::string &stratumInstanceName, bool *isNewBlock) {
     auto It = BackendMap_.find(backend);
     if (It == BackendMap_.end())
       return false;
     size_t backendIdx = It->second;
 
-    std::string error;
-    CSingleWork *work = newSingleWork(backend, backendIdx, blockTemplate.UniqueWorkId, miningConfig, miningAddress, coinbaseMsg);
+    CSingleWork *work = newSingleWork(backend, backendIdx, uniqueWorkId, miningConfig, miningAddress, coinbaseMsg);
     if (!work->initialized()) {
       LOG_F(ERROR, "%s: work create impossible for %s", stratumInstanceName.c_str(), ticker.c_str());
       return false;
     }
-    if (!work->loadFromTemplate(blockTemplate, ticker, error)) {
-      LOG_F(ERROR, "%s: can't process block template; error: %s", stratumInstanceName.c_str(), error.c_str());
-      return false;
-    }
+    work->loadFromPrepared(prepared);
 
     // Create merged work if need
     if (X::Stratum::MergedMiningSupport) {
@@ -130,10 +229,22 @@ public:
   }
 
   bool isDuplicate(CWork *work, const typename X::Proto::BlockHashTy &shareHash) {
-    bool duplicate = false;
-    for (size_t i = 0, ie = work->backendsNum(); i != ie; ++i)
-      duplicate |= !AcceptedShares_[work->backendId(i)].insert(shareHash).second;
-    return duplicate;
+    // Works built from same template have same headers, so share checked against all live generations of backend
+    uint64_t fingerprint = CAcceptedShareFilter::fingerprint(shareHash);
+    for (size_t i = 0, ie = work->backendsNum(); i != ie; ++i) {
+      for (const auto &filter: AcceptedShares_[work->backendId(i)]) {
+        if (filter.contains(fingerprint))
+          return true;
+      }
+    }
+
+    for (size_t i = 0, ie = work->backendsNum(); i != ie; ++i) {
+      std::deque<CAcceptedShareFilter> &generations = AcceptedShares_[work->backendId(i)];
+      if (!generations.empty())
+        generations.back().insert(fingerprint);
+    }
+
+    return false;
   }
 
   bool updatePending(size_t index,
@@ -169,7 +280,8 @@ private:
 
   std::unique_ptr<CSingleWorkSequence[]> WorkStorage_;
   std::unique_ptr<CMergedWorkSequence[]> MergedWorkStorage_;
-  std::unique_ptr<CAcceptedShareSet[]> AcceptedShares_;
+  // Accepted shares by work generation, share kept while any work live at its acceptance time exists
+  std::unique_ptr<std::deque<CAcceptedShareFilter>[]> AcceptedShares_;
   std::unique_ptr<CPendingShare[]> PendingShares_;
   std::unordered_map<int64_t, CWork*> WorkIdMap_;
 
@@ -196,6 +308,17 @@ private:
     while (sequence.size() > WorksetSizeLimit)
       eraseFirst(sequence);
 
+    // New generation of accepted shares, oldest table reused
+    std::deque<CAcceptedShareFilter> &generations = AcceptedShares_[backendIdx];
+    if (generations.size() >= WorksetSizeLimit) {
+      CAcceptedShareFilter filter = std::move(generations.front());
+      generations.pop_front();
+      filter.clear();
+      generations.push_back(std::move(filter));
+    } else {
+      generations.emplace_back();
+    }
+
     return work;
   }
 
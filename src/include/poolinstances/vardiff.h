@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+
+struct CVarDiffConfig {
+  bool Enabled = false;
+  // Target share rate for one connection (shares per minute)
+  double TargetSharesPerMinute = 20.0;
+  double MinDifficulty = 0.0;
+  // 0 means no upper limit
+  double MaxDifficulty = 0.0;
+  double StartDifficulty = 0.0;
+  // Share rate measurement window (microseconds)
+  int64_t RetargetWindow = 60000000;
+
+  // Don't touch difficulty if real share rate differs from target less than this factor
+  static constexpr double Hysteresis = 1.5;
+  // Limits of difficulty change for one retarget
+  static constexpr double MaxDecreaseFactor = 0.25;
+  static constexpr double MaxIncreaseFactor = 16.0;
+  // Early retarget if window already contains FloodFactor times more shares than expected for full window
+  static constexpr double FloodFactor = 4.0;
+
+  double expectedShares(int64_t interval) const { return TargetSharesPerMinute * static_cast<double>(interval) / 60000000.0; }
+  double clamp(double difficulty, double connectionMinDifficulty) const {
+    difficulty = std::max(difficulty, std::max(MinDifficulty, connectionMinDifficulty));
+    if (MaxDifficulty > 0.0)
+      difficulty = std::min(difficulty, MaxDifficulty);
+    return difficulty;
+  }
+};
+
+class CVarDiff {
+public:
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void reset(int64_t time) {
+    WindowBegin_ = time;
+    SharesNum_ = 0;
+  }
+
+  void addShare() { SharesNum_++; }
+
+  /// Recalculates difficulty if measurement window closed or connection floods shares
+  /// Returns true if difficulty changed
+  bool update(const CVarDiffConfig &cfg, int64_t time, double connectionMinDifficulty, double *difficulty) {
+    int64_t elapsed = time - WindowBegin_;
+    if (elapsed <= 0)
+      return false;
+
+    bool windowClosed = elapsed >= cfg.RetargetWindow;
+    bool flood = SharesNum_ >= cfg.FloodFactor * cfg.expectedShares(cfg.RetargetWindow);
+    if (!windowClosed && !flood)
+      return false;
+
+    double ratio = SharesNum_ / cfg.expectedShares(elapsed);
+    reset(time);
+    if (ratio < cfg.Hysteresis && ratio > 1.0/cfg.Hysteresis)
+      return false;
+
+    ratio = std::clamp(ratio, cfg.MaxDecreaseFactor, cfg.MaxIncreaseFactor);
+    double newDifficulty = cfg.clamp(*difficulty * ratio, connectionMinDifficulty);
+    if (newDifficulty == *difficulty)
+      return false;
+
+    // Shares for jobs received before difficulty change still accepted with previous difficulty
+    PreviousDifficulty_ = *difficulty;
+    PreviousDifficultyDeadline_ = time + cfg.RetargetWindow;
+    *difficulty = newDifficulty;
+    return true;
+  }
+
+  /// Check share against difficulty active before last retarget
+  bool acceptPrevious(double shareDiff, int64_t time, double *acceptedDifficulty) const {
+    if (time >= PreviousDifficultyDeadline_ || shareDiff < PreviousDifficulty_)
+      return false;
+    *acceptedDifficulty = PreviousDifficulty_;
+    return true;
+  }
+
+private:
+  int64_t WindowBegin_ = 0;
+  unsigned SharesNum_ = 0;
+  double PreviousDifficulty_ = 0.0;
+  int64_t PreviousDifficultyDeadline_ = 0;
+};
@@ -4,6 +4,7 @@
 #include "poolcore/backend.h"
 #include "poolcore/poolCore.h"
 #include "poolcore/poolInstance.h"
+#include "poolcore/sharePool.h"
 #include "poolcore/thread.h"
 #include "poolcore/usermgr.h"
 #include "blockmaker/merkleTree.h"
@@ -278,7 +279,7 @@ private:
           LOG_F(INFO, "* block %s (%" PRIu64 ") accepted by %s", blockHash.ToString().c_str(), height, hostName.c_str());
           if (successNum == 1) {
             // Send share with block to backend
-            CShare *backendShare = new CShare;
+            CShare *backendShare = CSharePool::alloc();
             backendShare->Time = time(nullptr);
             backendShare->userId = user;
             backendShare->workerId = workerId;
@@ -305,7 +306,7 @@ private:
       }
     } else {
       // Send share to backend
-      CShare *backendShare = new CShare;
+      CShare *backendShare = CSharePool::alloc();
       backendShare->Time = time(nullptr);
       backendShare->userId = share.addr();
       backendShare->workerId = workerId;
@@ -317,18 +318,19 @@ private:
       backend->sendShare(backendShare);
     }
 
-    if (shareAccepted && (AlgoMetaStatistic_ || true)) {
-      CShare *backendShare = new CShare;
-      backendShare->Time = time(nullptr);
-      backendShare->userId = share.addr();
-      backendShare->workerId = workerId;
-      backendShare->height = height;
-      backendShare->WorkValue = shareWork;
-      backendShare->isBlock = false;
-      backendShare->ChainLength = shareDiff;
-      backendShare->PrimePOWTarget = primePOWTarget;
-      if (AlgoMetaStatistic_)
+    if (shareAccepted) {
+      if (AlgoMetaStatistic_) {
+        CShare *backendShare = CSharePool::alloc();
+        backendShare->Time = time(nullptr);
+        backendShare->userId = share.addr();
+        backendShare->workerId = workerId;
+        backendShare->height = height;
+        backendShare->WorkValue = shareWork;
+        backendShare->isBlock = false;
+        backendShare->ChainLength = shareDiff;
+        backendShare->PrimePOWTarget = primePOWTarget;
         AlgoMetaStatistic_->sendShare(backendShare);
+      }
 
       // Disabled now
       // Share
@@ -0,0 +1,328 @@
+#include "fakeNode.h"
+#include "latency.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "loguru.hpp"
+#include <fstream>
+#include <inttypes.h>
+#include <random>
+#include <sstream>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct CFakeNode::CConnection {
+  CFakeNode *Node;
+  aioObject *Socket;
+  std::string In;
+  // Long poll request waiting for new block
+  std::string LongPollRequest;
+  char Buffer[65536];
+};
+
+static std::string randomHash()
+{
+  static std::mt19937_64 random(std::random_device{}());
+  static const char hex[] = "0123456789abcdef";
+  std::string result(64, '0');
+  for (size_t i = 0; i < 64; i += 16) {
+    uint64_t value = random();
+    for (size_t j = 0; j < 16; j++)
+      result[i+j] = hex[(value >> (j*4)) & 0xF];
+  }
+  return result;
+}
+
+static std::string serializeJson(const rapidjson::Value &value)
+{
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  value.Accept(writer);
+  return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+static void setMember(rapidjson::Document &document, const char *name, rapidjson::Value value)
+{
+  if (document.HasMember(name)) {
+    document[name] = value;
+  } else {
+    rapidjson::Value key(name, document.GetAllocator());
+    document.AddMember(key, value, document.GetAllocator());
+  }
+}
+
+static bool findContentLength(const char *header, size_t size, size_t *contentLength)
+{
+  static const char name[] = "content-length:";
+  const size_t nameSize = sizeof(name) - 1;
+  for (size_t i = 0; i + nameSize <= size; i++) {
+    if (strncasecmp(header + i, name, nameSize) == 0) {
+      *contentLength = strtoul(header + i + nameSize, nullptr, 10);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool CFakeNode::loadFixtures(const std::filesystem::path &path)
+{
+  std::error_code error;
+  for (const auto &entry: std::filesystem::directory_iterator(path, error)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".json")
+      continue;
+
+    std::ifstream file(entry.path());
+    std::stringstream data;
+    data << file.rdbuf();
+
+    CFixture &fixture = Fixtures_[entry.path().stem().u8string()];
+    fixture.Document.Parse(data.str().c_str());
+    if (fixture.Document.HasParseError()) {
+      LOG_F(ERROR, "fake node: invalid fixture %s", entry.path().u8string().c_str());
+      return false;
+    }
+
+    fixture.Serialized = serializeJson(fixture.Document);
+    LOG_F(INFO, "fake node: loaded fixture %s", entry.path().u8string().c_str());
+  }
+
+  if (error) {
+    LOG_F(ERROR, "fake node: can't read fixtures directory %s: %s", path.u8string().c_str(), error.message().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool CFakeNode::start(uint16_t port)
+{
+  // Initial block from recorded template
+  auto gbt = Fixtures_.find("getblocktemplate");
+  if (gbt != Fixtures_.end() && gbt->second.Document.IsObject() && gbt->second.Document.HasMember("height") && gbt->second.Document["height"].IsUint64())
+    Height_ = gbt->second.Document["height"].GetUint64();
+  else
+    Height_ = 1;
+  PrevBlockHash_ = randomHash();
+  LongPollId_ = PrevBlockHash_ + std::to_string(Height_);
+  updateFixtures();
+  LastBlockTime_ = steadyTimeUs();
+
+  HostAddress address;
+  address.family = AF_INET;
+  address.ipv4 = htonl(INADDR_LOOPBACK);
+  address.port = htons(port);
+  socketTy hSocket = socketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1);
+  socketReuseAddr(hSocket);
+  if (socketBind(hSocket, &address) != 0) {
+    LOG_F(ERROR, "fake node: cannot bind port: %u", static_cast<unsigned>(port));
+    return false;
+  }
+
+  if (socketListen(hSocket) != 0) {
+    LOG_F(ERROR, "fake node: listen error: %u", static_cast<unsigned>(port));
+    return false;
+  }
+
+  aioAccept(newSocketIo(Base_, hSocket), 0, acceptCb, this);
+
+  BlockTimer_ = newUserEvent(Base_, 0, [](aioUserEvent*, void *arg) {
+    static_cast<CFakeNode*>(arg)->newBlock();
+  }, this);
+  userEventStartTimer(BlockTimer_, BlockIntervalUs_, 1);
+  return true;
+}
+
+void CFakeNode::acceptCb(AsyncOpStatus status, aioObject *object, HostAddress, socketTy socket, void *arg)
+{
+  CFakeNode *node = static_cast<CFakeNode*>(arg);
+  if (status == aosSuccess)
+    node->onConnection(socket);
+  aioAccept(object, 0, acceptCb, arg);
+}
+
+void CFakeNode::readCb(AsyncOpStatus status, aioObject *object, size_t size, void *arg)
+{
+  CConnection *connection = static_cast<CConnection*>(arg);
+  if (status != aosSuccess) {
+    deleteAioObject(object);
+    return;
+  }
+
+  connection->Node->onData(connection, size);
+}
+
+void CFakeNode::onConnection(socketTy socket)
+{
+  CConnection *connection = new CConnection;
+  connection->Node = this;
+  connection->Socket = newSocketIo(Base_, socket);
+  objectSetDestructorCb(aioObjectHandle(connection->Socket), [](aioObjectRoot*, void *arg) {
+    CConnection *connection = static_cast<CConnection*>(arg);
+    connection->Node->LongPollConnections_.erase(connection);
+    delete connection;
+  }, connection);
+
+  aioRead(connection->Socket, connection->Buffer, sizeof(connection->Buffer), afNone, 0, readCb, connection);
+}
+
+void CFakeNode::onData(CConnection *connection, size_t size)
+{
+  connection->In.append(connection->Buffer, size);
+  for (;;) {
+    size_t headerEnd = connection->In.find("\r\n\r\n");
+    if (headerEnd == std::string::npos)
+      break;
+
+    size_t contentLength = 0;
+    findContentLength(connection->In.data(), headerEnd, &contentLength);
+    size_t requestSize = headerEnd + 4 + contentLength;
+    if (connection->In.size() < requestSize)
+      break;
+
+    std::string body = connection->In.substr(headerEnd + 4, contentLength);
+    connection->In.erase(0, requestSize);
+    if (!processRequest(connection, body.data(), body.size())) {
+      // Long poll: stop reading until new block
+      connection->LongPollRequest = std::move(body);
+      LongPollConnections_.insert(connection);
+      return;
+    }
+  }
+
+  aioRead(connection->Socket, connection->Buffer, sizeof(connection->Buffer), afNone, 0, readCb, connection);
+}
+
+bool CFakeNode::processRequest(CConnection *connection, const char *body, size_t size)
+{
+  rapidjson::Document document;
+  document.Parse(body, size);
+  if (document.HasParseError() || !(document.IsObject() || document.IsArray())) {
+    sendResponse(connection, R"({"result":null,"error":{"code":-32700,"message":"Parse error"},"id":null})");
+    return true;
+  }
+
+  std::string response;
+  if (document.IsArray()) {
+    // JSON-RPC batch
+    response.push_back('[');
+    for (rapidjson::SizeType i = 0, ie = document.Size(); i != ie; ++i) {
+      if (i)
+        response.push_back(',');
+      processCall(document[i], response, nullptr);
+    }
+    response.push_back(']');
+  } else {
+    bool isLongPoll = false;
+    processCall(document, response, &isLongPoll);
+    if (isLongPoll)
+      return false;
+  }
+
+  sendResponse(connection, response);
+  return true;
+}
+
+void CFakeNode::processCall(const rapidjson::Value &call, std::string &out, bool *isLongPoll)
+{
+  RequestsNum_.fetch_add(1, std::memory_order_relaxed);
+  std::string id = call.IsObject() && call.HasMember("id") ? serializeJson(call["id"]) : "null";
+  if (!call.IsObject() || !call.HasMember("method") || !call["method"].IsString()) {
+    out.append(R"({"result":null,"error":{"code":-32600,"message":"Invalid request"},"id":)");
+    out.append(id);
+    out.push_back('}');
+    return;
+  }
+
+  std::string method = call["method"].GetString();
+  if (method == "getblocktemplate" && isLongPoll) {
+    // Hold request with current long poll id until next block
+    const rapidjson::Value *params = call.HasMember("params") && call["params"].IsArray() && !call["params"].Empty() ? &call["params"][0u] : nullptr;
+    if (params && params->IsObject() && params->HasMember("longpollid") && (*params)["longpollid"].IsString() &&
+        LongPollId_ == (*params)["longpollid"].GetString()) {
+      *isLongPoll = true;
+      return;
+    }
+  }
+
+  const char *result = nullptr;
+  if (method == "submitblock" || method == "eth_submitWork") {
+    SubmittedBlocksNum_.fetch_add(1, std::memory_order_relaxed);
+    result = method == "submitblock" ? "null" : "true";
+  }
+
+  auto It = Fixtures_.find(method);
+  if (It != Fixtures_.end())
+    result = It->second.Serialized.c_str();
+
+  if (result) {
+    out.append(R"({"result":)");
+    out.append(result);
+    out.append(R"(,"error":null,"id":)");
+  } else {
+    out.append(R"({"result":null,"error":{"code":-32601,"message":"Method not found"},"id":)");
+  }
+  out.append(id);
+  out.push_back('}');
+}
+
+void CFakeNode::sendResponse(CConnection *connection, const std::string &body)
+{
+  char header[128];
+  int headerSize = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n", body.size());
+  std::string response;
+  response.reserve(headerSize + body.size());
+  response.append(header, headerSize);
+  response.append(body);
+  aioWrite(connection->Socket, response.data(), response.size(), afWaitAll, 0, nullptr, nullptr);
+}
+
+void CFakeNode::newBlock()
+{
+  Height_.fetch_add(1, std::memory_order_relaxed);
+  PrevBlockHash_ = randomHash();
+  LongPollId_ = PrevBlockHash_ + std::to_string(Height_);
+  updateFixtures();
+  LastBlockTime_.store(steadyTimeUs(), std::memory_order_release);
+
+  // Answer to all long poll requests
+  std::vector<CConnection*> connections(LongPollConnections_.begin(), LongPollConnections_.end());
+  LongPollConnections_.clear();
+  for (CConnection *connection: connections) {
+    std::string request = std::move(connection->LongPollRequest);
+    processRequest(connection, request.data(), request.size());
+    onData(connection, 0);
+  }
+
+  userEventStartTimer(BlockTimer_, BlockIntervalUs_, 1);
+}
+
+void CFakeNode::updateFixtures()
+{
+  uint64_t height = Height_;
+  for (auto &It: Fixtures_) {
+    const std::string &method = It.first;
+    rapidjson::Document &document = It.second.Document;
+    auto &allocator = document.GetAllocator();
+    if (method == "getblocktemplate" && document.IsObject()) {
+      setMember(document, "previousblockhash", rapidjson::Value(PrevBlockHash_.c_str(), allocator));
+      setMember(document, "height", rapidjson::Value(height));
+      setMember(document, "curtime", rapidjson::Value(static_cast<uint64_t>(time(nullptr))));
+      setMember(document, "longpollid", rapidjson::Value(LongPollId_.c_str(), allocator));
+    } else if (method == "eth_getWork" && document.IsArray() && document.Size() >= 4) {
+      char heightHex[32];
+      snprintf(heightHex, sizeof(heightHex), "0x%" PRIx64, height);
+      document[0u].SetString(("0x" + randomHash()).c_str(), allocator);
+      document[3u].SetString(heightHex, allocator);
+    } else if (method == "getblockchaininfo" && document.IsObject()) {
+      setMember(document, "blocks", rapidjson::Value(height - 1));
+      setMember(document, "bestblockhash", rapidjson::Value(PrevBlockHash_.c_str(), allocator));
+    } else if (method == "getblockcount" && document.IsNumber()) {
+      document.SetUint64(height - 1);
+    } else {
+      continue;
+    }
+
+    It.second.Serialized = serializeJson(document);
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "asyncio/asyncio.h"
+#include "asyncio/socket.h"
+#include "rapidjson/document.h"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+
+// JSON-RPC node emulator, serves recorded responses from fixtures directory (one <method>.json file per method)
+// and generates new block every BlockInterval:
+//   - getblocktemplate: previousblockhash, height, curtime & longpollid updated; long poll supported
+//   - eth_getWork: header hash & block number updated
+//   - submitblock & eth_submitWork counted
+// Methods without fixture answered with 'method not found' error
+class CFakeNode {
+public:
+  struct CConnection;
+
+public:
+  CFakeNode(asyncBase *base, uint64_t blockIntervalUs) : Base_(base), BlockIntervalUs_(blockIntervalUs) {}
+  bool loadFixtures(const std::filesystem::path &path);
+  bool start(uint16_t port);
+
+  // Time of last block change (steady clock, microseconds), used for notify fan-out measurement
+  int64_t lastBlockTime() const { return LastBlockTime_.load(std::memory_order_acquire); }
+  uint64_t height() const { return Height_.load(std::memory_order_relaxed); }
+  uint64_t requestsNum() const { return RequestsNum_.load(std::memory_order_relaxed); }
+  uint64_t submittedBlocksNum() const { return SubmittedBlocksNum_.load(std::memory_order_relaxed); }
+
+private:
+  struct CFixture {
+    rapidjson::Document Document;
+    std::string Serialized;
+  };
+
+private:
+  static void acceptCb(AsyncOpStatus status, aioObject *object, HostAddress address, socketTy socket, void *arg);
+  static void readCb(AsyncOpStatus status, aioObject *object, size_t size, void *arg);
+  void onConnection(socketTy socket);
+  void onData(CConnection *connection, size_t size);
+  // Returns false for long poll request
+  bool processRequest(CConnection *connection, const char *body, size_t size);
+  void processCall(const rapidjson::Value &call, std::string &out, bool *isLongPoll);
+  void sendResponse(CConnection *connection, const std::string &body);
+  void newBlock();
+  void updateFixtures();
+
+private:
+  asyncBase *Base_;
+  uint64_t BlockIntervalUs_;
+  aioUserEvent *BlockTimer_ = nullptr;
+  std::map<std::string, CFixture> Fixtures_;
+  std::set<CConnection*> LongPollConnections_;
+
+  std::string PrevBlockHash_;
+  std::string LongPollId_;
+  std::atomic<uint64_t> Height_ = 0;
+  std::atomic<int64_t> LastBlockTime_ = 0;
+  std::atomic<uint64_t> RequestsNum_ = 0;
+  std::atomic<uint64_t> SubmittedBlocksNum_ = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <vector>
+
+static inline int64_t steadyTimeUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear latency histogram (microseconds), ~3% relative error
+class CLatencyHistogram {
+public:
+  static constexpr unsigned SubBucketsLog2 = 5;
+  static constexpr unsigned SubBuckets = 1u << SubBucketsLog2;
+  static constexpr unsigned Groups = 40;
+
+  CLatencyHistogram() : Buckets_(Groups*SubBuckets, 0) {}
+
+  void add(uint64_t us) {
+    Buckets_[bucketIndex(us)]++;
+    Count_++;
+    Max_ = std::max(Max_, us);
+  }
+
+  void merge(const CLatencyHistogram &other) {
+    for (size_t i = 0; i < Buckets_.size(); i++)
+      Buckets_[i] += other.Buckets_[i];
+    Count_ += other.Count_;
+    Max_ = std::max(Max_, other.Max_);
+  }
+
+  void reset() {
+    std::fill(Buckets_.begin(), Buckets_.end(), 0);
+    Count_ = 0;
+    Max_ = 0;
+  }
+
+  uint64_t count() const { return Count_; }
+  uint64_t max() const { return Max_; }
+
+  // percentile in range [0, 100]
+  uint64_t percentile(double p) const {
+    if (!Count_)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(Count_));
+    rank = std::min(std::max<uint64_t>(rank, 1), Count_);
+    uint64_t acc = 0;
+    for (size_t i = 0; i < Buckets_.size(); i++) {
+      acc += Buckets_[i];
+      if (acc >= rank)
+        return std::min(bucketUpperBound(i), Max_);
+    }
+    return Max_;
+  }
+
+private:
+  static size_t bucketIndex(uint64_t us) {
+    if (us < SubBuckets)
+      return static_cast<size_t>(us);
+    unsigned log2 = 63 - __builtin_clzll(us);
+    unsigned group = log2 - SubBucketsLog2 + 1;
+    if (group >= Groups)
+      return Groups*SubBuckets - 1;
+    unsigned sub = static_cast<unsigned>((us >> (log2 - SubBucketsLog2)) & (SubBuckets - 1));
+    return group*SubBuckets + sub;
+  }
+
+  static uint64_t bucketUpperBound(size_t index) {
+    unsigned group = static_cast<unsigned>(index / SubBuckets);
+    uint64_t sub = index % SubBuckets;
+    if (group == 0)
+      return sub;
+    unsigned shift = group - 1;
+    return ((SubBuckets + sub + 1) << shift) - 1;
+  }
+
+private:
+  std::vector<uint64_t> Buckets_;
+  uint64_t Count_ = 0;
+  uint64_t Max_ = 0;
+};
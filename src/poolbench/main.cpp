@@ -0,0 +1,276 @@
+// Stratum load generator & fake node benchmark
+//
+// Typical usage:
+//   poolbench --mode=node --fixtures=fixtures/btc --node-port=18332 --block-interval=30
+//     run node emulator only, pool connects to it as to real bitcoind
+//   poolbench --mode=all --fixtures=fixtures/btc --pool=127.0.0.1:3333 --miners=10000 --threads=4 --share-rate=6
+//     run node emulator and miners in one process, notify fan-out time measured
+//   poolbench --mode=load --pool=127.0.0.1:3333 --miners=10000 --invalid=0.01 --duplicate=0.01 --reconnect-interval=60
+//     run miners only
+// Pool share difficulty should be set to minimal value, load generator sends shares with random nonce
+
+#include "fakeNode.h"
+#include "stratumLoad.h"
+#include "asyncio/asyncio.h"
+#include "asyncio/socket.h"
+#include "loguru.hpp"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+enum EMode {
+  EModeAll = 0,
+  EModeNode,
+  EModeLoad
+};
+
+struct CBenchConfig {
+  EMode Mode = EModeAll;
+  std::string Fixtures = "fixtures/btc";
+  uint16_t NodePort = 18332;
+  unsigned BlockInterval = 30;
+  std::string Pool = "127.0.0.1:3333";
+  unsigned Duration = 60;
+  unsigned ReportInterval = 1;
+  CStratumLoadConfig Load;
+};
+
+static void printHelp()
+{
+  printf("Usage: poolbench [options]\n"
+         "  --mode=all|node|load         run node emulator and/or miners (default: all)\n"
+         "  --fixtures=<dir>             node fixtures directory, one <method>.json per RPC method\n"
+         "  --node-port=<port>           node emulator JSON-RPC port (default: 18332)\n"
+         "  --block-interval=<seconds>   new block interval (default: 30)\n"
+         "  --pool=<ipv4:port>           pool stratum address (default: 127.0.0.1:3333)\n"
+         "  --user=<name>                user name, workers authorized as <user>.w<N> (default: bench)\n"
+         "  --miners=<N>                 miners number (default: 1000)\n"
+         "  --threads=<N>                load generator threads (default: 1)\n"
+         "  --share-rate=<N>             shares per minute for one miner (default: 6)\n"
+         "  --invalid=<ratio>            part of shares with unknown job (default: 0)\n"
+         "  --duplicate=<ratio>          part of duplicate shares (default: 0)\n"
+         "  --reconnect-interval=<sec>   reconnect storm interval, 0 for disable (default: 0)\n"
+         "  --reconnect-ratio=<ratio>    part of miners reconnecting at once (default: 0.1)\n"
+         "  --duration=<seconds>         benchmark duration, 0 for infinite (default: 60)\n"
+         "  --report-interval=<seconds>  statistic output interval (default: 1)\n");
+}
+
+static bool parseAddress(const std::string &source, HostAddress &address)
+{
+  size_t colonPos = source.find(':');
+  if (colonPos == std::string::npos)
+    return false;
+
+  std::string host = source.substr(0, colonPos);
+  unsigned long port = strtoul(source.c_str() + colonPos + 1, nullptr, 10);
+  in_addr_t ipv4 = inet_addr(host.c_str());
+  if (ipv4 == INADDR_NONE || port == 0 || port > 65535)
+    return false;
+
+  address.family = AF_INET;
+  address.ipv4 = ipv4;
+  address.port = htons(static_cast<uint16_t>(port));
+  return true;
+}
+
+static bool parseArguments(int argc, char **argv, CBenchConfig &cfg)
+{
+  enum {
+    OptMode = 1,
+    OptFixtures,
+    OptNodePort,
+    OptBlockInterval,
+    OptPool,
+    OptUser,
+    OptMiners,
+    OptThreads,
+    OptShareRate,
+    OptInvalid,
+    OptDuplicate,
+    OptReconnectInterval,
+    OptReconnectRatio,
+    OptDuration,
+    OptReportInterval,
+    OptHelp
+  };
+
+  static option options[] = {
+    {"mode", required_argument, nullptr, OptMode},
+    {"fixtures", required_argument, nullptr, OptFixtures},
+    {"node-port", required_argument, nullptr, OptNodePort},
+    {"block-interval", required_argument, nullptr, OptBlockInterval},
+    {"pool", required_argument, nullptr, OptPool},
+    {"user", required_argument, nullptr, OptUser},
+    {"miners", required_argument, nullptr, OptMiners},
+    {"threads", required_argument, nullptr, OptThreads},
+    {"share-rate", required_argument, nullptr, OptShareRate},
+    {"invalid", required_argument, nullptr, OptInvalid},
+    {"duplicate", required_argument, nullptr, OptDuplicate},
+    {"reconnect-interval", required_argument, nullptr, OptReconnectInterval},
+    {"reconnect-ratio", required_argument, nullptr, OptReconnectRatio},
+    {"duration", required_argument, nullptr, OptDuration},
+    {"report-interval", required_argument, nullptr, OptReportInterval},
+    {"help", no_argument, nullptr, OptHelp},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+    switch (option) {
+      case OptMode :
+        if (strcmp(optarg, "all") == 0) {
+          cfg.Mode = EModeAll;
+        } else if (strcmp(optarg, "node") == 0) {
+          cfg.Mode = EModeNode;
+        } else if (strcmp(optarg, "load") == 0) {
+          cfg.Mode = EModeLoad;
+        } else {
+          fprintf(stderr, "ERROR: invalid mode: %s\n", optarg);
+          return false;
+        }
+        break;
+      case OptFixtures : cfg.Fixtures = optarg; break;
+      case OptNodePort : cfg.NodePort = static_cast<uint16_t>(atoi(optarg)); break;
+      case OptBlockInterval : cfg.BlockInterval = std::max(atoi(optarg), 1); break;
+      case OptPool : cfg.Pool = optarg; break;
+      case OptUser : cfg.Load.User = optarg; break;
+      case OptMiners : cfg.Load.MinersNum = atoi(optarg); break;
+      case OptThreads : cfg.Load.ThreadsNum = std::max(atoi(optarg), 1); break;
+      case OptShareRate : cfg.Load.SharesPerMinute = atof(optarg); break;
+      case OptInvalid : cfg.Load.InvalidRatio = atof(optarg); break;
+      case OptDuplicate : cfg.Load.DuplicateRatio = atof(optarg); break;
+      case OptReconnectInterval : cfg.Load.ReconnectInterval = atoi(optarg); break;
+      case OptReconnectRatio : cfg.Load.ReconnectRatio = atof(optarg); break;
+      case OptDuration : cfg.Duration = atoi(optarg); break;
+      case OptReportInterval : cfg.ReportInterval = std::max(atoi(optarg), 1); break;
+      case OptHelp :
+      default :
+        printHelp();
+        return false;
+    }
+  }
+
+  if (cfg.Mode != EModeNode && !parseAddress(cfg.Pool, cfg.Load.Address)) {
+    fprintf(stderr, "ERROR: invalid pool address: %s\n", cfg.Pool.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+static void printLatency(const char *name, const CLatencyHistogram &histogram, double divisor, const char *unit)
+{
+  printf(" %s %s p50/p90/p99/max: %.1lf/%.1lf/%.1lf/%.1lf",
+         name,
+         unit,
+         histogram.percentile(50.0) / divisor,
+         histogram.percentile(90.0) / divisor,
+         histogram.percentile(99.0) / divisor,
+         histogram.max() / divisor);
+}
+
+int main(int argc, char **argv)
+{
+  CBenchConfig cfg;
+  if (!parseArguments(argc, argv, cfg))
+    return 1;
+
+  loguru::g_preamble_thread = true;
+  loguru::g_preamble_file = true;
+  loguru::g_flush_interval_ms = 100;
+  loguru::g_stderr_verbosity = loguru::Verbosity_INFO;
+  loguru::init(argc, argv);
+
+  initializeSocketSubsystem();
+
+  std::unique_ptr<CFakeNode> node;
+  std::thread nodeThread;
+  asyncBase *nodeBase = nullptr;
+  if (cfg.Mode != EModeLoad) {
+    nodeBase = createAsyncBase(amOSDefault);
+    node.reset(new CFakeNode(nodeBase, static_cast<uint64_t>(cfg.BlockInterval) * 1000000));
+    if (!node->loadFixtures(cfg.Fixtures) || !node->start(cfg.NodePort))
+      return 1;
+    nodeThread = std::thread([nodeBase]() { asyncLoop(nodeBase); });
+    LOG_F(INFO, "fake node listening on 127.0.0.1:%u", static_cast<unsigned>(cfg.NodePort));
+  }
+
+  std::unique_ptr<CStratumLoadGenerator> generator;
+  if (cfg.Mode != EModeNode) {
+    generator.reset(new CStratumLoadGenerator(cfg.Load, node.get()));
+    generator->start();
+    LOG_F(INFO, "started %u miners in %u threads, pool address: %s", cfg.Load.MinersNum, cfg.Load.ThreadsNum, cfg.Pool.c_str());
+  }
+
+  CStratumLoadStats total;
+  uint64_t lastResponses = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  auto reportTime = startTime;
+  for (;;) {
+    reportTime += std::chrono::seconds(cfg.ReportInterval);
+    std::this_thread::sleep_until(reportTime);
+    unsigned elapsed = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::seconds>(reportTime - startTime).count());
+
+    printf("[%5us]", elapsed);
+    if (generator) {
+      CStratumLoadStats stats;
+      generator->collect(stats);
+      total.AcceptLatency.merge(stats.AcceptLatency);
+      total.NotifyLatency.merge(stats.NotifyLatency);
+      total.SharesSent = stats.SharesSent;
+      total.SharesAccepted = stats.SharesAccepted;
+      total.SharesRejected = stats.SharesRejected;
+      total.Reconnects = stats.Reconnects;
+
+      uint64_t responses = stats.SharesAccepted + stats.SharesRejected;
+      printf(" miners: %" PRIu64 "/%u shares/s: %.1lf accepted: %.2lf%%",
+             stats.Connected,
+             cfg.Load.MinersNum,
+             static_cast<double>(responses - lastResponses) / cfg.ReportInterval,
+             responses ? 100.0 * stats.SharesAccepted / responses : 0.0);
+      printLatency("latency", stats.AcceptLatency, 1000.0, "ms");
+      if (stats.NotifyLatency.count())
+        printLatency("notify", stats.NotifyLatency, 1000.0, "ms");
+      lastResponses = responses;
+    }
+
+    if (node)
+      printf(" node: height %" PRIu64 " requests %" PRIu64 " blocks %" PRIu64, node->height(), node->requestsNum(), node->submittedBlocksNum());
+    printf("\n");
+    fflush(stdout);
+
+    if (cfg.Duration && elapsed >= cfg.Duration)
+      break;
+  }
+
+  if (generator) {
+    generator->stop();
+    uint64_t responses = total.SharesAccepted + total.SharesRejected;
+    unsigned elapsed = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - startTime).count());
+    printf("Total: sent %" PRIu64 " accepted %" PRIu64 " rejected %" PRIu64 " reconnects %" PRIu64 " average shares/s: %.1lf\n",
+           total.SharesSent,
+           total.SharesAccepted,
+           total.SharesRejected,
+           total.Reconnects,
+           elapsed ? static_cast<double>(responses) / elapsed : 0.0);
+    printLatency("share accept latency", total.AcceptLatency, 1000.0, "ms");
+    printf("\n");
+    if (total.NotifyLatency.count()) {
+      printLatency("notify fan-out", total.NotifyLatency, 1000.0, "ms");
+      printf("\n");
+    }
+  }
+
+  if (node) {
+    postQuitOperation(nodeBase);
+    nodeThread.join();
+  }
+
+  return 0;
+}
@@ -0,0 +1,304 @@
+#include "stratumLoad.h"
+#include "fakeNode.h"
+#include "rapidjson/document.h"
+#include "loguru.hpp"
+#include <string.h>
+
+// Miners state update interval
+static constexpr uint64_t TimerInterval = 10000;
+// Reconnect delay after connection error
+static constexpr int64_t ReconnectDelay = 1000000;
+
+enum {
+  ESubscribeId = 1,
+  EAuthorizeId = 2
+};
+
+void CStratumLoadGenerator::start()
+{
+  int64_t now = steadyTimeUs();
+  unsigned threadsNum = std::max(Cfg_.ThreadsNum, 1u);
+  for (unsigned i = 0; i < threadsNum; i++) {
+    Threads_.emplace_back(new CThread);
+    CThread &thread = *Threads_.back();
+    thread.Generator = this;
+    thread.Base = createAsyncBase(amOSDefault);
+    thread.Random.seed(i);
+    thread.NextReconnectTime = now + static_cast<int64_t>(Cfg_.ReconnectInterval) * 1000000;
+    thread.Timer = newUserEvent(thread.Base, 0, [](aioUserEvent*, void *arg) {
+      CThread *thread = static_cast<CThread*>(arg);
+      thread->Generator->onTimer(*thread);
+    }, &thread);
+  }
+
+  // Distribute miners between threads, initial connections spread over one second
+  for (unsigned i = 0; i < Cfg_.MinersNum; i++) {
+    CThread &thread = *Threads_[i % threadsNum];
+    CMiner *miner = new CMiner;
+    miner->Thread = &thread;
+    miner->Index = i;
+    miner->WorkerName = Cfg_.User + ".w" + std::to_string(i);
+    miner->ReconnectTime = now + static_cast<int64_t>(i) * 1000000 / std::max(Cfg_.MinersNum, 1u);
+    thread.Miners.emplace_back(miner);
+  }
+
+  for (auto &thread: Threads_) {
+    CThread *threadPtr = thread.get();
+    thread->Thread = std::thread([threadPtr]() {
+      userEventStartTimer(threadPtr->Timer, TimerInterval, 1);
+      asyncLoop(threadPtr->Base);
+    });
+  }
+}
+
+void CStratumLoadGenerator::stop()
+{
+  for (auto &thread: Threads_)
+    postQuitOperation(thread->Base);
+  for (auto &thread: Threads_)
+    thread->Thread.join();
+}
+
+void CStratumLoadGenerator::collect(CStratumLoadStats &stats)
+{
+  stats = CStratumLoadStats();
+  for (auto &thread: Threads_) {
+    stats.Connected += thread->Connected.load(std::memory_order_relaxed);
+    stats.Reconnects += thread->Reconnects.load(std::memory_order_relaxed);
+    stats.SharesSent += thread->SharesSent.load(std::memory_order_relaxed);
+    stats.SharesAccepted += thread->SharesAccepted.load(std::memory_order_relaxed);
+    stats.SharesRejected += thread->SharesRejected.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(thread->StatsMutex);
+    stats.AcceptLatency.merge(thread->AcceptLatency);
+    stats.NotifyLatency.merge(thread->NotifyLatency);
+    thread->AcceptLatency.reset();
+    thread->NotifyLatency.reset();
+  }
+}
+
+void CStratumLoadGenerator::connectCb(AsyncOpStatus status, aioObject *object, void *arg)
+{
+  CMiner &miner = *static_cast<CMiner*>(arg);
+  if (object != miner.Socket)
+    return;
+
+  CStratumLoadGenerator *generator = miner.Thread->Generator;
+  if (status != aosSuccess) {
+    generator->disconnect(miner);
+    return;
+  }
+
+  miner.Connected = true;
+  miner.Thread->Connected.fetch_add(1, std::memory_order_relaxed);
+  generator->send(miner, R"({"id":1,"method":"mining.subscribe","params":["poolbench/1.0"]})" "\n");
+  generator->send(miner, R"({"id":2,"method":"mining.authorize","params":[")" + miner.WorkerName + R"(",""]})" "\n");
+  aioRead(miner.Socket, miner.Buffer, sizeof(miner.Buffer), afNone, 0, readCb, &miner);
+}
+
+void CStratumLoadGenerator::readCb(AsyncOpStatus status, aioObject *object, size_t size, void *arg)
+{
+  CMiner &miner = *static_cast<CMiner*>(arg);
+  if (object != miner.Socket)
+    return;
+
+  CStratumLoadGenerator *generator = miner.Thread->Generator;
+  if (status != aosSuccess) {
+    generator->disconnect(miner);
+    return;
+  }
+
+  int64_t now = steadyTimeUs();
+  const char *nextMsgPos;
+  const char *p = miner.Buffer;
+  const char *e = miner.Buffer + miner.TailSize + size;
+  while (p != e && (nextMsgPos = static_cast<const char*>(memchr(p, '\n', e - p)))) {
+    generator->onMessage(miner, p, nextMsgPos - p, now);
+    p = nextMsgPos + 1;
+  }
+
+  miner.TailSize = e - p;
+  if (miner.TailSize == sizeof(miner.Buffer)) {
+    LOG_F(ERROR, "poolbench: too long stratum message received by %s", miner.WorkerName.c_str());
+    generator->disconnect(miner);
+    return;
+  }
+
+  memmove(miner.Buffer, p, miner.TailSize);
+  aioRead(miner.Socket, miner.Buffer + miner.TailSize, sizeof(miner.Buffer) - miner.TailSize, afNone, 0, readCb, &miner);
+}
+
+void CStratumLoadGenerator::onTimer(CThread &thread)
+{
+  int64_t now = steadyTimeUs();
+
+  // Reconnect storm
+  if (Cfg_.ReconnectInterval && now >= thread.NextReconnectTime) {
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    for (auto &miner: thread.Miners) {
+      if (miner->Socket && distribution(thread.Random) < Cfg_.ReconnectRatio) {
+        disconnect(*miner);
+        miner->ReconnectTime = now;
+        thread.Reconnects.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    thread.NextReconnectTime = now + static_cast<int64_t>(Cfg_.ReconnectInterval) * 1000000;
+  }
+
+  for (auto &minerPtr: thread.Miners) {
+    CMiner &miner = *minerPtr;
+    if (!miner.Socket) {
+      if (now >= miner.ReconnectTime)
+        connect(miner, now);
+      continue;
+    }
+
+    if (miner.Authorized && !miner.JobId.empty() && miner.NextShareTime && now >= miner.NextShareTime) {
+      sendShare(miner, now);
+      miner.NextShareTime += shareInterval(thread);
+      if (miner.NextShareTime < now)
+        miner.NextShareTime = now + shareInterval(thread);
+    }
+  }
+
+  userEventStartTimer(thread.Timer, TimerInterval, 1);
+}
+
+void CStratumLoadGenerator::connect(CMiner &miner, int64_t)
+{
+  socketTy socket = socketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1);
+  miner.Socket = newSocketIo(miner.Thread->Base, socket);
+  miner.TailSize = 0;
+  aioConnect(miner.Socket, &Cfg_.Address, 5000000, connectCb, &miner);
+}
+
+void CStratumLoadGenerator::disconnect(CMiner &miner)
+{
+  if (miner.Socket) {
+    deleteAioObject(miner.Socket);
+    miner.Socket = nullptr;
+  }
+
+  if (miner.Connected) {
+    miner.Connected = false;
+    miner.Thread->Connected.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  miner.Authorized = false;
+  miner.TailSize = 0;
+  miner.JobId.clear();
+  miner.LastShare.clear();
+  miner.NextShareTime = 0;
+  miner.LastBlockTime = 0;
+  miner.PendingShares.clear();
+  miner.ReconnectTime = steadyTimeUs() + ReconnectDelay;
+}
+
+void CStratumLoadGenerator::onMessage(CMiner &miner, const char *data, size_t size, int64_t now)
+{
+  CThread &thread = *miner.Thread;
+  rapidjson::Document document;
+  document.Parse(data, size);
+  if (document.HasParseError() || !document.IsObject())
+    return;
+
+  if (document.HasMember("method") && document["method"].IsString()) {
+    if (strcmp(document["method"].GetString(), "mining.notify") != 0)
+      return;
+    if (!document.HasMember("params") || !document["params"].IsArray())
+      return;
+    const rapidjson::Value &params = document["params"];
+    if (params.Size() < 9 || !params[0u].IsString() || !params[7u].IsString())
+      return;
+
+    miner.JobId = params[0u].GetString();
+    miner.NTime = params[7u].GetString();
+    bool cleanJobs = params[8u].IsBool() && params[8u].GetBool();
+    if (cleanJobs || !miner.LastBlockTime) {
+      // Notify fan-out time: from block change on node to notify receiving
+      int64_t blockTime = Node_ ? Node_->lastBlockTime() : 0;
+      if (blockTime && miner.LastBlockTime && blockTime != miner.LastBlockTime) {
+        std::lock_guard<std::mutex> lock(thread.StatsMutex);
+        thread.NotifyLatency.add(static_cast<uint64_t>(std::max<int64_t>(now - blockTime, 0)));
+      }
+      miner.LastBlockTime = blockTime ? blockTime : now;
+    }
+
+    if (!miner.NextShareTime)
+      miner.NextShareTime = now + shareInterval(thread);
+    return;
+  }
+
+  if (!document.HasMember("id") || !document["id"].IsUint64())
+    return;
+  uint64_t id = document["id"].GetUint64();
+  const rapidjson::Value *result = document.HasMember("result") ? &document["result"] : nullptr;
+  if (id == ESubscribeId) {
+    // [subscriptions, extranonce1, extranonce2 size]
+    if (result && result->IsArray() && result->Size() >= 3 && (*result)[1u].IsString() && (*result)[2u].IsUint()) {
+      miner.ExtraNonce1 = (*result)[1u].GetString();
+      miner.ExtraNonce2Size = (*result)[2u].GetUint();
+    }
+  } else if (id == EAuthorizeId) {
+    miner.Authorized = result && result->IsBool() && result->GetBool();
+    if (!miner.Authorized)
+      LOG_F(WARNING, "poolbench: authorization failed for %s", miner.WorkerName.c_str());
+  } else {
+    while (!miner.PendingShares.empty() && miner.PendingShares.front().first < id)
+      miner.PendingShares.pop_front();
+    if (miner.PendingShares.empty() || miner.PendingShares.front().first != id)
+      return;
+
+    int64_t sendTime = miner.PendingShares.front().second;
+    miner.PendingShares.pop_front();
+    if (result && result->IsBool() && result->GetBool())
+      thread.SharesAccepted.fetch_add(1, std::memory_order_relaxed);
+    else
+      thread.SharesRejected.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(thread.StatsMutex);
+    thread.AcceptLatency.add(static_cast<uint64_t>(std::max<int64_t>(now - sendTime, 0)));
+  }
+}
+
+void CStratumLoadGenerator::sendShare(CMiner &miner, int64_t now)
+{
+  static const char hex[] = "0123456789abcdef";
+  CThread &thread = *miner.Thread;
+  std::uniform_real_distribution<double> distribution(0.0, 1.0);
+  double kind = distribution(thread.Random);
+
+  if (kind >= Cfg_.DuplicateRatio || miner.LastShare.empty()) {
+    // Mutable extra nonce is a counter
+    std::string extraNonce2(miner.ExtraNonce2Size*2, '0');
+    uint64_t counter = miner.ExtraNonce2++;
+    for (size_t i = extraNonce2.size(); i > 0 && counter; i--, counter >>= 4)
+      extraNonce2[i-1] = hex[counter & 0xF];
+
+    char nonce[16];
+    snprintf(nonce, sizeof(nonce), "%08x", static_cast<unsigned>(thread.Random()));
+
+    // Invalid shares refers to unknown job
+    bool invalid = kind < Cfg_.DuplicateRatio + Cfg_.InvalidRatio;
+    miner.LastShare = "\"" + miner.WorkerName + "\",\"" + (invalid ? std::string("ffffffffffff") : miner.JobId) + "\",\"" +
+                      extraNonce2 + "\",\"" + miner.NTime + "\",\"" + nonce + "\"";
+  }
+
+  uint64_t id = miner.NextId++;
+  std::string msg = "{\"id\":" + std::to_string(id) + ",\"method\":\"mining.submit\",\"params\":[" + miner.LastShare + "]}\n";
+  miner.PendingShares.emplace_back(id, now);
+  thread.SharesSent.fetch_add(1, std::memory_order_relaxed);
+  send(miner, msg);
+}
+
+void CStratumLoadGenerator::send(CMiner &miner, const std::string &msg)
+{
+  aioWrite(miner.Socket, msg.data(), msg.size(), afWaitAll, 0, nullptr, nullptr);
+}
+
+int64_t CStratumLoadGenerator::shareInterval(CThread &thread)
+{
+  // Poisson process
+  std::exponential_distribution<double> distribution(std::max(Cfg_.SharesPerMinute, 0.001) / 60000000.0);
+  return std::max<int64_t>(static_cast<int64_t>(distribution(thread.Random)), 1);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "latency.h"
+#include "asyncio/asyncio.h"
+#include "asyncio/socket.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CFakeNode;
+
+struct CStratumLoadConfig {
+  HostAddress Address;
+  unsigned ThreadsNum = 1;
+  unsigned MinersNum = 1000;
+  // Average share rate of one miner
+  double SharesPerMinute = 6.0;
+  // Part of shares with unknown job id
+  double InvalidRatio = 0.0;
+  // Part of shares repeating previous share
+  double DuplicateRatio = 0.0;
+  // Disconnect ReconnectRatio of miners every ReconnectInterval seconds, all of them reconnects immediately
+  unsigned ReconnectInterval = 0;
+  double ReconnectRatio = 0.1;
+  std::string User = "bench";
+};
+
+struct CStratumLoadStats {
+  uint64_t Connected = 0;
+  uint64_t Reconnects = 0;
+  uint64_t SharesSent = 0;
+  uint64_t SharesAccepted = 0;
+  uint64_t SharesRejected = 0;
+  CLatencyHistogram AcceptLatency;
+  CLatencyHistogram NotifyLatency;
+};
+
+// Emulates a lot of BTC-like stratum miners, every worker thread has own event loop
+class CStratumLoadGenerator {
+public:
+  CStratumLoadGenerator(const CStratumLoadConfig &cfg, const CFakeNode *node) : Cfg_(cfg), Node_(node) {}
+  void start();
+  void stop();
+  // Collects statistic from all threads, latency histograms are reset
+  void collect(CStratumLoadStats &stats);
+
+private:
+  struct CThread;
+
+  struct CMiner {
+    CThread *Thread = nullptr;
+    unsigned Index = 0;
+    aioObject *Socket = nullptr;
+    bool Connected = false;
+    bool Authorized = false;
+    int64_t ReconnectTime = 0;
+    // Stratum protocol decoding
+    char Buffer[16384];
+    size_t TailSize = 0;
+    // Mining info
+    std::string WorkerName;
+    std::string ExtraNonce1;
+    unsigned ExtraNonce2Size = 4;
+    std::string JobId;
+    std::string NTime;
+    uint64_t ExtraNonce2 = 0;
+    int64_t NextShareTime = 0;
+    int64_t LastBlockTime = 0;
+    std::string LastShare;
+    uint64_t NextId = 100;
+    std::deque<std::pair<uint64_t, int64_t>> PendingShares;
+  };
+
+  struct CThread {
+    CStratumLoadGenerator *Generator = nullptr;
+    asyncBase *Base = nullptr;
+    aioUserEvent *Timer = nullptr;
+    std::thread Thread;
+    std::vector<std::unique_ptr<CMiner>> Miners;
+    std::mt19937_64 Random;
+    int64_t NextReconnectTime = 0;
+
+    std::atomic<uint64_t> Connected = 0;
+    std::atomic<uint64_t> Reconnects = 0;
+    std::atomic<uint64_t> SharesSent = 0;
+    std::atomic<uint64_t> SharesAccepted = 0;
+    std::atomic<uint64_t> SharesRejected = 0;
+    std::mutex StatsMutex;
+    CLatencyHistogram AcceptLatency;
+    CLatencyHistogram NotifyLatency;
+  };
+
+private:
+  static void connectCb(AsyncOpStatus status, aioObject *object, void *arg);
+  static void readCb(AsyncOpStatus status, aioObject *object, size_t size, void *arg);
+  void onTimer(CThread &thread);
+  void connect(CMiner &miner, int64_t now);
+  void disconnect(CMiner &miner);
+  void onMessage(CMiner &miner, const char *data, size_t size, int64_t now);
+  void sendShare(CMiner &miner, int64_t now);
+  void send(CMiner &miner, const std::string &msg);
+  int64_t shareInterval(CThread &thread);
+
+private:
+  CStratumLoadConfig Cfg_;
+  const CFakeNode *Node_;
+  std::vector<std::unique_ptr<CThread>> Threads_;
+};
@@ -61,6 +61,13 @@ ssize_t FileDescriptor::read(void *data, size_t offset, size_t size)
 }
 
 ssize_t FileDescriptor::write(const void *data, size_t size)
+{
+  ssize_t result = writeNoSync(data, size);
+  fsync(Fd_);
+  return result;
+}
+
+ssize_t FileDescriptor::writeNoSync(const void *data, size_t size)
 {
   const uint8_t *ptr = static_cast<const uint8_t*>(data);
   size_t remaining = size;
@@ -68,16 +75,22 @@ ssize_t FileDescriptor::write(const void *data, size_t size)
   while ( (pread64ReturnValue = ::write(Fd_, ptr, remaining)) > 0) {
     remaining -= pread64ReturnValue;
     ptr += pread64ReturnValue;
-    if (remaining == 0) {
-      fsync(Fd_);
+    if (remaining == 0)
       return ptr - static_cast<const uint8_t*>(data);
-    }
   }
 
-  fsync(Fd_);
   return pread64ReturnValue == 0 ? ptr - static_cast<const uint8_t*>(data) : -1;
 }
 
+bool FileDescriptor::sync()
+{
+#ifdef __linux__
+  return fdatasync(Fd_) == 0;
+#else
+  return fsync(Fd_) == 0;
+#endif
+}
+
 ssize_t FileDescriptor::write(const void *data, size_t offset, size_t size)
 {
   const uint8_t *ptr = static_cast<const uint8_t*>(data);
@@ -234,6 +247,16 @@ ssize_t FileDescriptor::write(const void *data, size_t offset, size_t size)
   return size - remaining;
 }
 
+ssize_t FileDescriptor::writeNoSync(const void *data, size_t size)
+{
+  return write(data, size);
+}
+
+bool FileDescriptor::sync()
+{
+  return FlushFileBuffers(Fd_);
+}
+
 bool FileDescriptor::truncate(size_t size)
 {
   LONG hiWord = size >> 32;
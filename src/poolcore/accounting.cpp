@@ -42,13 +42,15 @@ struct DbIo<CStatsExportDataOld> {
 
 void AccountingDb::printRecentStatistic()
 {
-  if (RecentStats_.empty()) {
+  std::vector<StatisticDb::CStatsExportData> recentStats;
+  PPLNSWindow_.exportRecent(recentStats);
+  if (recentStats.empty()) {
     LOG_F(INFO, "[%s] Recent statistic: empty", CoinInfo_.Name.c_str());
     return;
   }
 
   LOG_F(INFO, "[%s] Recent statistic:", CoinInfo_.Name.c_str());
-  for (const auto &user: RecentStats_) {
+  for (const auto &user: recentStats) {
     std::string line = user.UserId;
     line.append(": ");
     bool firstIter = true;
@@ -67,8 +69,7 @@ bool AccountingDb::parseAccoutingStorageFile(CAccountingFile &file)
 {
   LastKnownShareId_ = 0;
   LastBlockTime_ = 0;
-  RecentStats_.clear();
-  CurrentScores_.clear();
+  PPLNSWindow_.clear();
 
   FileDescriptor fd;
   if (!fd.open(file.Path.u8string().c_str())) {
@@ -129,14 +130,12 @@ bool AccountingDb::parseAccoutingStorageFile(CAccountingFile &file)
   if (!stream.remaining() && !stream.eof()) {
     LastKnownShareId_ = fileData.LastShareId;
     LastBlockTime_ = fileData.LastBlockTime;
-    RecentStats_ = std::move(fileData.Recent);
-    CurrentScores_ = std::move(fileData.CurrentScores);
+    PPLNSWindow_.load(fileData.Recent, fileData.CurrentScores, file.TimeLabel);
     return true;
   } else {
     LastKnownShareId_ = 0;
     LastBlockTime_ = 0;
-    RecentStats_.clear();
-    CurrentScores_.clear();
+    PPLNSWindow_.clear();
     LOG_F(ERROR, "AccountingDb: file %s is corrupted", file.Path.generic_string().c_str());
     return false;
   }
@@ -155,14 +154,18 @@ void AccountingDb::flushAccountingStorageFile(int64_t timeLabel)
     return;
   }
 
+  CAccountingFileData fileData;
+  PPLNSWindow_.exportRecent(fileData.Recent);
+  PPLNSWindow_.exportRound(fileData.CurrentScores);
+
   xmstream stream;
   DbIo<uint32_t>::serialize(stream, CAccountingFileData::CurrentRecordVersion);
   DbIo<decltype(LastKnownShareId_)>::serialize(stream, LastKnownShareId_);
   DbIo<decltype(LastBlockTime_)>::serialize(stream, LastBlockTime_);
   // Statistics
-  DbIo<decltype(RecentStats_)>::serialize(stream, RecentStats_);
+  DbIo<decltype(fileData.Recent)>::serialize(stream, fileData.Recent);
   // Current round aggregated data
-  DbIo<decltype(CurrentScores_)>::serialize(stream, CurrentScores_);
+  DbIo<decltype(fileData.CurrentScores)>::serialize(stream, fileData.CurrentScores);
 
   fd.write(stream.data(), stream.sizeOf());
   fd.close();
@@ -184,11 +187,14 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
   UserManager_(userMgr),
   ClientDispatcher_(clientDispatcher),
   StatisticDb_(statisticDb),
+  // PPLNS window: 30 minutes, 1 minute buckets
+  PPLNSWindow_(1800, 60),
   _roundsDb(config.dbPath / "rounds.v2"),
   _balanceDb(config.dbPath / "balance"),
   _foundBlocksDb(config.dbPath / "foundBlocks"),
   _poolBalanceDb(config.dbPath / "poolBalance"),
   _payoutDb(config.dbPath / "payouts"),
+  _poolTotalsDb(config.dbPath / "poolTotals"),
   TaskHandler_(this, base)
 {
   FlushTimerEvent_ = newUserEvent(base, 1, nullptr, nullptr);
@@ -274,6 +280,97 @@ AccountingDb::AccountingDb(asyncBase *base, const PoolBackendConfig &config, con
 
     LOG_F(INFO, "loaded %u user balance data from db", (unsigned)_balanceMap.size());
   }
+
+  loadTotals();
+}
+
+void AccountingDb::loadTotals()
+{
+  // Luck prefix sums stored by previous runs
+  LuckPrefix_.clear();
+  {
+    std::unique_ptr<rocksdbBase::IteratorType> It(_poolTotalsDb.iterator());
+    for (It->seek(PoolLuckPrefixRecord()); It->valid(); It->next()) {
+      PoolLuckPrefixRecord record;
+      RawData data = It->value();
+      if (!record.deserializeValue(data.data, data.size) || record.Index != LuckPrefix_.size())
+        break;
+      LuckPrefix_.push_back({record.Time, record.AccumulatedWork, record.ExpectedWork});
+      LuckPrefixHeight_ = record.Height;
+    }
+  }
+
+  bool hasTotals = false;
+  {
+    std::unique_ptr<rocksdbBase::IteratorType> It(_poolTotalsDb.iterator());
+    It->seek(Totals_);
+    if (It->valid() && It->id == Totals_.getPartitionId()) {
+      RawData data = It->value();
+      hasTotals = Totals_.deserializeValue(data.data, data.size);
+    }
+  }
+
+  // Replay blocks found after last stored prefix, scan all blocks only if totals not stored yet
+  PoolTotalsRecord foundBlocksTotals;
+  {
+    std::unique_ptr<rocksdbBase::IteratorType> It(_foundBlocksDb.iterator());
+    if (hasTotals && !LuckPrefix_.empty()) {
+      FoundBlockRecord next;
+      next.Height = LuckPrefixHeight_ + 1;
+      It->seek(next);
+    } else {
+      It->seekFirst();
+    }
+
+    for (; It->valid(); It->next()) {
+      FoundBlockRecord blk;
+      RawData data = It->value();
+      if (!blk.deserializeValue(data.data, data.size))
+        continue;
+      foundBlocksTotals.BlocksFound++;
+      foundBlocksTotals.AccumulatedWork += blk.AccumulatedWork;
+      if (LuckPrefix_.empty() || blk.Height > LuckPrefixHeight_)
+        addLuckPrefix(blk.Height, blk.Time, blk.ExpectedWork != 0.0 ? blk.AccumulatedWork : 0.0, blk.ExpectedWork);
+    }
+  }
+
+  if (hasTotals) {
+    LOG_F(INFO, "loaded pool totals: %" PRIu64 " blocks, paid out %s", Totals_.BlocksFound, FormatMoney(Totals_.PaidOut, CoinInfo_.RationalPartSize).c_str());
+    return;
+  }
+
+  // No totals in database, calculate them once
+  Totals_ = foundBlocksTotals;
+  std::unique_ptr<rocksdbBase::IteratorType> payoutIt(_payoutDb.iterator());
+  for (payoutIt->seekFirst(); payoutIt->valid(); payoutIt->next()) {
+    PayoutDbRecord payout;
+    RawData data = payoutIt->value();
+    if (payout.deserializeValue(data.data, data.size) && payout.Status == PayoutDbRecord::ETxConfirmed)
+      Totals_.PaidOut += payout.Value;
+  }
+
+  _poolTotalsDb.put(Totals_);
+  LOG_F(INFO, "pool totals rebuilt: %" PRIu64 " blocks, paid out %s", Totals_.BlocksFound, FormatMoney(Totals_.PaidOut, CoinInfo_.RationalPartSize).c_str());
+}
+
+void AccountingDb::addLuckPrefix(uint64_t height, int64_t time, double accumulatedWork, double expectedWork)
+{
+  CLuckPrefix prefix = LuckPrefix_.empty() ? CLuckPrefix{0, 0.0, 0.0} : LuckPrefix_.back();
+  // Keep prefix ordered by time for binary search
+  prefix.Time = std::max(prefix.Time, time);
+  prefix.AccumulatedWork += accumulatedWork;
+  prefix.ExpectedWork += expectedWork;
+
+  PoolLuckPrefixRecord record;
+  record.Index = LuckPrefix_.size();
+  record.Height = height;
+  record.Time = prefix.Time;
+  record.AccumulatedWork = prefix.AccumulatedWork;
+  record.ExpectedWork = prefix.ExpectedWork;
+  _poolTotalsDb.put(record);
+
+  LuckPrefix_.push_back(prefix);
+  LuckPrefixHeight_ = height;
 }
 
 void AccountingDb::enumerateStatsFiles(std::deque<CAccountingFile> &cache, const std::filesystem::path &directory, bool isOldFormat)
@@ -410,6 +507,9 @@ void AccountingDb::calculatePayments(MiningRound *R, int64_t generatedCoins)
     LOG_F(INFO, " * %s %s -> %sremaining %s", record.userId.c_str(), FormatMoney(payoutValue+feeValuesSum, rationalPartSize).c_str(), debugString.c_str(), FormatMoney(payoutValue, rationalPartSize).c_str());
   }
 
+  // Round shares are not ordered by user
+  std::sort(payouts.begin(), payouts.end(), [](const PayoutDbRecord &l, const PayoutDbRecord &r) { return l.UserId < r.UserId; });
+
   mergeSorted(payouts.begin(), payouts.end(), feePayouts.begin(), feePayouts.end(),
     [](const PayoutDbRecord &l, const std::pair<std::string, int64_t> &r) { return l.UserId < r.first; },
     [](const std::pair<std::string, int64_t> &l, const PayoutDbRecord &r) { return l.first < r.UserId; },
@@ -448,14 +548,12 @@ void AccountingDb::calculatePayments(MiningRound *R, int64_t generatedCoins)
 void AccountingDb::addShare(const CShare &share)
 {
   // increment score
-  CurrentScores_[share.userId] += share.WorkValue;
+  PPLNSWindow_.addShare(share);
   LastKnownShareId_ = share.UniqueShareId;
 
   if (share.isBlock) {
     LastBlockTime_ = time(nullptr);
-    double accumulatedWork = 0.0;
-    for (const auto &score: CurrentScores_)
-      accumulatedWork += score.second;
+    double accumulatedWork = PPLNSWindow_.roundWork();
 
     {
       // save to database
@@ -470,6 +568,12 @@ void AccountingDb::addShare(const CShare &share)
       if (hasUnknownReward())
         blk.PublicHash = "?";
       _foundBlocksDb.put(blk);
+
+      Totals_.BlocksFound++;
+      Totals_.AccumulatedWork += accumulatedWork;
+      _poolTotalsDb.put(Totals_);
+      // Blocks without expected work don't affect luck
+      addLuckPrefix(blk.Height, blk.Time, blk.ExpectedWork != 0.0 ? accumulatedWork : 0.0, blk.ExpectedWork);
     }
 
     MiningRound *R = new MiningRound;
@@ -486,28 +590,8 @@ void AccountingDb::addShare(const CShare &share)
     R->AccumulatedWork = accumulatedWork;
     R->TotalShareValue = 0;
 
-    // Merge shares for current block with older shares (PPLNS)
-    {
-      int64_t acceptSharesTime = share.Time - 1800;
-      mergeSorted(RecentStats_.begin(), RecentStats_.end(), CurrentScores_.begin(), CurrentScores_.end(),
-        [](const StatisticDb::CStatsExportData &stats, const std::pair<std::string, double> &scores) { return stats.UserId < scores.first; },
-        [](const std::pair<std::string, double> &scores, const StatisticDb::CStatsExportData &stats) { return scores.first < stats.UserId; },
-        [&](const StatisticDb::CStatsExportData &stats) {
-          // User disconnected recently, no new shares
-          double shareValue = stats.recentShareValue(acceptSharesTime);
-          if (shareValue != 0.0) {
-            R->UserShares.emplace_back(stats.UserId, shareValue);
-          }
-        }, [&](const std::pair<std::string, double> &scores) {
-          // User joined recently, no extra shares in statistic
-          R->UserShares.emplace_back(scores.first, scores.second);
-        }, [&](const StatisticDb::CStatsExportData &stats, const std::pair<std::string, double> &scores) {
-          // Need merge new shares and recent share statistics
-          R->UserShares.emplace_back(stats.UserId, scores.second + stats.recentShareValue(acceptSharesTime));
-        });
-    }
-
-    CurrentScores_.clear();
+    // Current round shares with older shares (PPLNS)
+    PPLNSWindow_.closeRound(share.Time, R->UserShares);
 
     // Calculate total share value
     for (const auto &element: R->UserShares)
@@ -522,13 +606,8 @@ void AccountingDb::addShare(const CShare &share)
     _roundsDb.put(*R);
     UnpayedRounds_.insert(R);
 
-    // Query statistics
-    StatisticDb_.exportRecentStats(RecentStats_);
     printRecentStatistic();
 
-    // Reset aggregated data
-    CurrentScores_.clear();
-
     // Remove old data
     for (const auto &file: AccountingDiskStorage_)
       std::filesystem::remove(file.Path);
@@ -543,7 +622,7 @@ void AccountingDb::replayShare(const CShare &share)
 {
   if (share.UniqueShareId > FlushInfo_.ShareId) {
     // increment score
-    CurrentScores_[share.userId] += share.WorkValue;
+    PPLNSWindow_.addShare(share);
   }
 
   LastKnownShareId_ = std::max(LastKnownShareId_, share.UniqueShareId);
@@ -559,9 +638,11 @@ void AccountingDb::initializationFinish(int64_t timeLabel)
 {
   printRecentStatistic();
 
-  if (!CurrentScores_.empty()) {
+  std::map<std::string, double> currentScores;
+  PPLNSWindow_.exportRound(currentScores);
+  if (!currentScores.empty()) {
     LOG_F(INFO, "[%s] current scores:", CoinInfo_.Name.c_str());
-    for (const auto &It: CurrentScores_) {
+    for (const auto &It: currentScores) {
       LOG_F(INFO, " * %s: %.3lf", It.first.c_str(), It.second);
     }
   } else {
@@ -681,9 +762,8 @@ void AccountingDb::checkBlockExtraInfo()
   updatePayoutFile();
 }
 
-void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout)
+bool AccountingDb::checkPayoutRecipient(const PayoutDbRecord &payout, unsigned index, std::string &recipient)
 {
-  *needSkipPayout = false;
   if (payout.Value < _cfg.MinimalAllowedPayout) {
     LOG_F(INFO,
           "[%u] Accounting: ignore this payout to %s, value is %s, minimal is %s",
@@ -691,8 +771,7 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
           payout.UserId.c_str(),
           FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(),
           FormatMoney(_cfg.MinimalAllowedPayout, CoinInfo_.RationalPartSize).c_str());
-    *needSkipPayout = true;
-    return;
+    return false;
   }
 
   // Get address for payment
@@ -700,50 +779,64 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   bool hasSettings = UserManager_.getUserCoinSettings(payout.UserId, CoinInfo_.Name, settings);
   if (!hasSettings || settings.Address.empty()) {
     LOG_F(WARNING, "user %s did not setup payout address, ignoring", payout.UserId.c_str());
-    *needSkipPayout = true;
-    return;
+    return false;
   }
 
   recipient = settings.Address;
   if (!CoinInfo_.checkAddress(settings.Address, CoinInfo_.PayoutAddressType)) {
     LOG_F(ERROR, "Invalid payment address %s for %s", settings.Address.c_str(), payout.UserId.c_str());
-    *needSkipPayout = true;
-    return;
+    return false;
+  }
+
+  return true;
+}
+
+bool AccountingDb::correctPayoutValue(PayoutDbRecord &payout, int64_t delta)
+{
+  // Correct payout value and request balance
+  payout.Value -= delta;
+
+  // Update user balance
+  auto It = _balanceMap.find(payout.UserId);
+  if (It == _balanceMap.end()) {
+    LOG_F(ERROR, "payout to unknown address %s", payout.UserId.c_str());
+    return false;
   }
 
+  LOG_F(INFO, "   * correct requested balance for %s by %s", payout.UserId.c_str(), FormatMoney(delta, CoinInfo_.RationalPartSize).c_str());
+  UserBalanceRecord &balance = It->second;
+  balance.Requested -= delta;
+  _balanceDb.put(balance);
+  return true;
+}
+
+void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std::string &recipient, bool *needSkipPayout)
+{
+  *needSkipPayout = !checkPayoutRecipient(payout, index, recipient);
+  if (*needSkipPayout)
+    return;
+
   // Build transaction
   // For bitcoin-based API it's sequential call of createrawtransaction, fundrawtransaction and signrawtransaction
   CNetworkClient::BuildTransactionResult transaction;
   CNetworkClient::EOperationStatus status =
-    ClientDispatcher_.ioBuildTransaction(Base_, settings.Address.c_str(), _cfg.MiningAddresses.get().MiningAddress, payout.Value, transaction);
+    ClientDispatcher_.ioBuildTransaction(Base_, recipient, _cfg.MiningAddresses.get().MiningAddress, payout.Value, transaction);
   if (status == CNetworkClient::EStatusOk) {
     // Nothing to do
   } else if (status == CNetworkClient::EStatusInsufficientFunds) {
     LOG_F(INFO, "No money left to pay");
     return;
   } else {
-    LOG_F(ERROR, "Payment %s to %s failed with error \"%s\"", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), settings.Address.c_str(), transaction.Error.c_str());
+    LOG_F(ERROR, "Payment %s to %s failed with error \"%s\"", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), recipient.c_str(), transaction.Error.c_str());
     return;
   }
 
   int64_t delta = payout.Value - (transaction.Value + transaction.Fee);
   if (delta > 0) {
-    // Correct payout value and request balance
-    payout.Value -= delta;
-
-    // Update user balance
-    auto It = _balanceMap.find(payout.UserId);
-    if (It == _balanceMap.end()) {
-      LOG_F(ERROR, "payout to unknown address %s", payout.UserId.c_str());
+    if (!correctPayoutValue(payout, delta))
       return;
-    }
-
-    LOG_F(INFO, "   * correct requested balance for %s by %s", payout.UserId.c_str(), FormatMoney(delta, CoinInfo_.RationalPartSize).c_str());
-    UserBalanceRecord &balance = It->second;
-    balance.Requested -= delta;
-    _balanceDb.put(balance);
   } else if (delta < 0) {
-    LOG_F(ERROR, "Payment %s to %s failed: too big transaction amount", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), settings.Address.c_str());
+    LOG_F(ERROR, "Payment %s to %s failed: too big transaction amount", FormatMoney(payout.Value, CoinInfo_.RationalPartSize).c_str(), recipient.c_str());
     return;
   }
 
@@ -760,44 +853,133 @@ void AccountingDb::buildTransaction(PayoutDbRecord &payout, unsigned index, std:
   _payoutDb.put(payout);
 }
 
+AccountingDb::EBatchBuildResult AccountingDb::buildBatchTransaction(PayoutDbRecord **batch, const std::string *recipients, size_t size)
+{
+  // Build one transaction for all payouts, fee is split between recipients
+  std::vector<CNetworkClient::BuildTransactionOutput> outputs(size);
+  for (size_t i = 0; i < size; i++) {
+    outputs[i].Address = recipients[i];
+    outputs[i].Value = batch[i]->Value;
+  }
+
+  CNetworkClient::BuildBatchTransactionResult transaction;
+  CNetworkClient::EOperationStatus status =
+    ClientDispatcher_.ioBuildTransactionBatch(Base_, outputs, _cfg.MiningAddresses.get().MiningAddress, transaction);
+  if (status == CNetworkClient::EStatusOk) {
+    // Nothing to do
+  } else if (status == CNetworkClient::EStatusMethodNotFound) {
+    return EBatchUnsupported;
+  } else if (status == CNetworkClient::EStatusInsufficientFunds) {
+    LOG_F(INFO, "No money left to pay");
+    return EBatchFailed;
+  } else {
+    LOG_F(ERROR, "Batch payment to %zu recipients failed with error \"%s\"", size, transaction.Error.c_str());
+    return EBatchFailed;
+  }
+
+  // Check transaction size, split batch if it's too big
+  if (size > 1 && transaction.TxData.size() / 2 > _cfg.PayoutBatchMaxSize) {
+    size_t half = size / 2;
+    EBatchBuildResult result = buildBatchTransaction(batch, recipients, half);
+    if (result != EBatchOk)
+      return result;
+    return buildBatchTransaction(batch + half, recipients + half, size - half);
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    if (transaction.Values[i] + transaction.Fees[i] > batch[i]->Value) {
+      LOG_F(ERROR, "Payment %s to %s failed: too big transaction amount", FormatMoney(batch[i]->Value, CoinInfo_.RationalPartSize).c_str(), recipients[i].c_str());
+      return EBatchFailed;
+    }
+  }
+
+  // Save transaction to database
+  if (!KnownTransactions_.insert(transaction.TxId).second) {
+    LOG_F(ERROR, "Node generated duplicate for transaction %s !!!", transaction.TxId.c_str());
+    return EBatchFailed;
+  }
+
+  int64_t currentTime = time(nullptr);
+  for (size_t i = 0; i < size; i++) {
+    PayoutDbRecord &payout = *batch[i];
+    int64_t delta = payout.Value - (transaction.Values[i] + transaction.Fees[i]);
+    if (delta > 0)
+      correctPayoutValue(payout, delta);
+
+    if (i == 0)
+      payout.TransactionData = transaction.TxData;
+    payout.TransactionId = transaction.TxId;
+    payout.Time = currentTime;
+    payout.BatchSize = static_cast<uint32_t>(size);
+    payout.Status = PayoutDbRecord::ETxCreated;
+    _payoutDb.put(payout);
+  }
+
+  // Send transaction and change status of all batch payouts to 'Sent'
+  if (sendTransaction(*batch[0]))
+    LOG_F(INFO, " * sent batch of %zu payouts, fee %s with txid %s", size, FormatMoney(transaction.Fee, CoinInfo_.RationalPartSize).c_str(), transaction.TxId.c_str());
+  return EBatchOk;
+}
+
 bool AccountingDb::sendTransaction(PayoutDbRecord &payout)
 {
   // Send transaction and change it status to 'Sent'
   // For bitcoin-based API it's 'sendrawtransaction'
   std::string error;
+  std::string txId = payout.TransactionId;
   CNetworkClient::EOperationStatus status = ClientDispatcher_.ioSendTransaction(Base_, payout.TransactionData, payout.TransactionId, error);
+
+  // All payouts of batch have the same status
+  auto forEachPayout = [this, &payout, &txId](auto update) {
+    if (payout.BatchSize > 1) {
+      for (auto &batchPayout: _payoutQueue) {
+        if (batchPayout.TransactionId == txId)
+          update(batchPayout);
+      }
+    } else {
+      update(payout);
+    }
+  };
+
   if (status == CNetworkClient::EStatusOk) {
     // Nothing to do
   } else if (status == CNetworkClient::EStatusVerifyRejected) {
     // Sending failed, transaction is rejected
-    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", payout.TransactionId.c_str(), payout.UserId.c_str());
-
-    // Update transaction in database
-    payout.Status = PayoutDbRecord::ETxRejected;
-    _payoutDb.put(payout);
-
-    // Clear all data and re-schedule payout
-    payout.TransactionId.clear();
-    payout.TransactionData.clear();
-    payout.Status = PayoutDbRecord::EInitialized;
+    LOG_F(ERROR, "Transaction %s to %s marked as rejected, removing from database...", txId.c_str(), payout.UserId.c_str());
+
+    forEachPayout([this](PayoutDbRecord &rejected) {
+      // Update transaction in database
+      rejected.Status = PayoutDbRecord::ETxRejected;
+      _payoutDb.put(rejected);
+
+      // Clear all data and re-schedule payout
+      rejected.TransactionId.clear();
+      rejected.TransactionData.clear();
+      rejected.BatchSize = 0;
+      rejected.Status = PayoutDbRecord::EInitialized;
+    });
     return false;
   } else {
-    LOG_F(WARNING, "Sending transaction %s to %s error \"%s\", will try send later...", payout.TransactionId.c_str(), payout.UserId.c_str(), error.c_str());
+    LOG_F(WARNING, "Sending transaction %s to %s error \"%s\", will try send later...", txId.c_str(), payout.UserId.c_str(), error.c_str());
     return false;
   }
 
-  payout.Status = PayoutDbRecord::ETxSent;
-  _payoutDb.put(payout);
+  forEachPayout([this](PayoutDbRecord &sent) {
+    sent.Status = PayoutDbRecord::ETxSent;
+    _payoutDb.put(sent);
+  });
   return true;
 }
 
-bool AccountingDb::checkTxConfirmations(PayoutDbRecord &payout)
+bool AccountingDb::checkTxConfirmations(PayoutDbRecord &payout, const CNetworkClient::GetTxConfirmationsQuery &tx)
 {
-  int64_t confirmations = 0;
-  std::string error;
-  CNetworkClient::EOperationStatus status = ClientDispatcher_.ioGetTxConfirmations(Base_, payout.TransactionId, &confirmations, &payout.TxFee, error);
+  CNetworkClient::EOperationStatus status = tx.Status;
+  int64_t confirmations = tx.Confirmations;
+  const std::string &error = tx.Error;
   if (status == CNetworkClient::EStatusOk) {
-    // Nothing to do
+    // Batch fee is already included into payout value
+    if (payout.BatchSize <= 1)
+      payout.TxFee = tx.TxFee;
   } else if (status == CNetworkClient::EStatusInvalidAddressOrKey) {
     // Wallet don't know about this transaction
     payout.Status = PayoutDbRecord::ETxCreated;
@@ -812,6 +994,7 @@ bool AccountingDb::checkTxConfirmations(PayoutDbRecord &payout)
     // Clear all data and re-schedule payout
     payout.TransactionId.clear();
     payout.TransactionData.clear();
+    payout.BatchSize = 0;
     payout.Status = PayoutDbRecord::EInitialized;
     return false;
   } else {
@@ -823,6 +1006,8 @@ bool AccountingDb::checkTxConfirmations(PayoutDbRecord &payout)
   if (confirmations > _cfg.RequiredConfirmations) {
     payout.Status = PayoutDbRecord::ETxConfirmed;
     _payoutDb.put(payout);
+    Totals_.PaidOut += payout.Value;
+    _poolTotalsDb.put(Totals_);
 
     // Update user balance
     auto It = _balanceMap.find(payout.UserId);
@@ -873,9 +1058,27 @@ void AccountingDb::makePayout()
         _payoutQueue.push_back(PayoutDbRecord(I.first, I.second));
     }
 
+    // Confirmations of sent transactions checked with one batched request after main loop
+    std::vector<PayoutDbRecord*> sentPayouts;
+    for (auto &payout: _payoutQueue) {
+      if (payout.Status == PayoutDbRecord::ETxSent)
+        sentPayouts.push_back(&payout);
+    }
+
+    bool batchPayouts = _cfg.PayoutBatchMaxOutputs > 1 && !BatchPayoutsUnsupported_;
+    std::vector<PayoutDbRecord*> batch;
+    std::vector<std::string> batchRecipients;
+    std::unordered_set<std::string> batchAddresses;
     unsigned index = 0;
     for (auto &payout: _payoutQueue) {
-      if (payout.Status == PayoutDbRecord::EInitialized) {
+      if (payout.Status == PayoutDbRecord::EInitialized && batchPayouts) {
+        // Collect payouts to batch, one output per address in transaction
+        std::string recipientAddress;
+        if (!checkPayoutRecipient(payout, index, recipientAddress) || !batchAddresses.insert(recipientAddress).second)
+          continue;
+        batch.push_back(&payout);
+        batchRecipients.push_back(recipientAddress);
+      } else if (payout.Status == PayoutDbRecord::EInitialized) {
         // Build transaction
         // For bitcoin-based API it's sequential call of createrawtransaction, fundrawtransaction and signrawtransaction
         bool needSkipPayout;
@@ -893,18 +1096,54 @@ void AccountingDb::makePayout()
           break;
         }
       } else if (payout.Status == PayoutDbRecord::ETxCreated) {
+        // Batch transaction sent with its first payout
+        if (payout.BatchSize > 1 && payout.TransactionData.empty())
+          continue;
         // Resend transaction
         if (sendTransaction(payout))
           LOG_F(INFO, " * retry send txid %s to %s", payout.TransactionId.c_str(), payout.UserId.c_str());
       } else if (payout.Status == PayoutDbRecord::ETxSent) {
-        // Check confirmations
-        if (checkTxConfirmations(payout))
-          LOG_F(INFO, " * transaction txid %s to %s confirmed", payout.TransactionId.c_str(), payout.UserId.c_str());
+        // Check confirmations later
       } else {
         // Invalid status
       }
     }
 
+    for (size_t offset = 0; offset < batch.size(); offset += _cfg.PayoutBatchMaxOutputs) {
+      size_t size = std::min<size_t>(batch.size() - offset, _cfg.PayoutBatchMaxOutputs);
+      EBatchBuildResult result = buildBatchTransaction(&batch[offset], &batchRecipients[offset], size);
+      if (result == EBatchUnsupported) {
+        LOG_F(WARNING, "%s: batch payouts not supported by node client, using one transaction per payout", CoinInfo_.Name.c_str());
+        BatchPayoutsUnsupported_ = true;
+        break;
+      } else if (result == EBatchFailed) {
+        break;
+      }
+    }
+
+    if (!sentPayouts.empty()) {
+      // One query per transaction, batch payouts share it
+      std::vector<CNetworkClient::GetTxConfirmationsQuery> txQuery;
+      std::vector<size_t> txQueryIndex;
+      std::unordered_map<std::string, size_t> txIndexMap;
+      for (const PayoutDbRecord *payout: sentPayouts) {
+        auto It = txIndexMap.emplace(payout->TransactionId, txQuery.size());
+        if (It.second)
+          txQuery.emplace_back(payout->TransactionId);
+        txQueryIndex.push_back(It.first->second);
+      }
+
+      CNetworkClient::EOperationStatus status = ClientDispatcher_.ioGetTxConfirmationsBatch(Base_, txQuery);
+      for (size_t i = 0, ie = sentPayouts.size(); i != ie; ++i) {
+        PayoutDbRecord &payout = *sentPayouts[i];
+        CNetworkClient::GetTxConfirmationsQuery &tx = txQuery[txQueryIndex[i]];
+        if (status != CNetworkClient::EStatusOk)
+          tx.Status = status;
+        if (checkTxConfirmations(payout, tx))
+          LOG_F(INFO, " * transaction txid %s to %s confirmed", payout.TransactionId.c_str(), payout.UserId.c_str());
+      }
+    }
+
     // Cleanup confirmed payouts
     for (auto I = _payoutQueue.begin(), IE = _payoutQueue.end(); I != IE;) {
       if (I->Status == PayoutDbRecord::ETxConfirmed) {
@@ -1159,49 +1398,23 @@ void AccountingDb::poolLuckImpl(const std::vector<int64_t> &intervals, PoolLuckC
 {
   int64_t currentTime = time(nullptr);
   std::vector<double> result;
-
-  auto &db = getFoundBlocksDb();
-  std::unique_ptr<rocksdbBase::IteratorType> It(db.iterator());
-  It->seekLast();
-
-  auto intervalIt = intervals.begin();
-  if (intervalIt == intervals.end()) {
-    callback(result);
-    return;
-  }
-
-  double acceptedWork = 0.0;
-  double expectedWork = 0.0;
-  for (const auto &score: CurrentScores_)
-    acceptedWork += score.second;
-
-  int64_t currentTimePoint = currentTime - *intervalIt;
-  while (It->valid()) {
-    FoundBlockRecord dbBlock;
-    RawData data = It->value();
-    if (!dbBlock.deserializeValue(data.data, data.size))
-      break;
-
-    while (dbBlock.Time < currentTimePoint) {
-      result.push_back(expectedWork != 0.0 ? acceptedWork / expectedWork : 0.0);
-      if (++intervalIt == intervals.end()) {
-        callback(result);
-        return;
-      }
-
-      currentTimePoint = currentTime - *intervalIt;
-    }
-
-    if (dbBlock.ExpectedWork != 0.0) {
-      acceptedWork += dbBlock.AccumulatedWork;
-      expectedWork += dbBlock.ExpectedWork;
+  result.reserve(intervals.size());
+
+  double roundWork = PPLNSWindow_.roundWork();
+  CLuckPrefix last = LuckPrefix_.empty() ? CLuckPrefix{0, 0.0, 0.0} : LuckPrefix_.back();
+  for (int64_t interval: intervals) {
+    // First block found not earlier than interval begin
+    auto It = std::lower_bound(LuckPrefix_.begin(), LuckPrefix_.end(), currentTime - interval, [](const CLuckPrefix &prefix, int64_t time) { return prefix.Time < time; });
+    double acceptedWork = roundWork + last.AccumulatedWork;
+    double expectedWork = last.ExpectedWork;
+    if (It != LuckPrefix_.begin()) {
+      acceptedWork -= std::prev(It)->AccumulatedWork;
+      expectedWork -= std::prev(It)->ExpectedWork;
     }
 
-    It->prev();
+    result.push_back(expectedWork != 0.0 ? acceptedWork / expectedWork : 0.0);
   }
 
-  while (intervalIt++ != intervals.end())
-    result.push_back(expectedWork != 0.0 ? acceptedWork / expectedWork : 0.0);
   callback(result);
 }
 
@@ -1233,44 +1446,6 @@ void AccountingDb::queryBalanceImpl(const std::string &user, QueryBalanceCallbac
   callback(info);
 }
 
-// In accounting.cpp, add the following member function implementations for AccountingDb:
-
-double AccountingDb::getTotalWorkDone() {
-  double total = 0.0;
-  std::unique_ptr<rocksdbBase::IteratorType> it(_foundBlocksDb.iterator());
-  for (it->seekFirst(); it->valid(); it->next()) {
-    FoundBlockRecord blk;
-    RawData data = it->value();
-    if (blk.deserializeValue(data.data, data.size))
-      total += blk.AccumulatedWork;
-  }
-  return total;
-}
-
-int AccountingDb::getTotalBlocksFound() {
-  int count = 0;
-  std::unique_ptr<rocksdbBase::IteratorType> it(_foundBlocksDb.iterator());
-  for (it->seekFirst(); it->valid(); it->next()) {
-    FoundBlockRecord blk;
-    RawData data = it->value();
-    if (blk.deserializeValue(data.data, data.size))
-      count++;
-  }
-  return count;
-}
-
-double AccountingDb::getTotalPaidOut() {
-  double total = 0.0;
-  std::unique_ptr<rocksdbBase::IteratorType> it(_payoutDb.iterator());
-  for (it->seekFirst(); it->valid(); it->next()) {
-    PayoutDbRecord rec;
-    RawData data = it->value();
-    if (rec.deserializeValue(data.data, data.size))
-      total += rec.Value;
-  }
-  return total;
-}
-
 double AccountingDb::getExpectedBlockTime() {
   // For now, return a fixed expected block time (e.g., 600 seconds).
   return 600.0;
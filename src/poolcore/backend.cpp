@@ -52,7 +52,7 @@ PoolBackend::PoolBackend(asyncBase *base, const PoolBackendConfig &cfg, const CC
   _accounting.reset(new AccountingDb(_base, _cfg, CoinInfo_, UserMgr_, ClientDispatcher_, *_statistics.get()));
 
   ShareLogConfig shareLogConfig(_accounting.get(), _statistics.get());
-  ShareLog_.init(cfg.dbPath / "shares.log.v1", cfg.dbPath / "shares.log", info.Name, _base, _cfg.ShareLogFlushInterval, _cfg.ShareLogFileSizeLimit, shareLogConfig);
+  ShareLog_.init(cfg.dbPath / "shares.log.v1", cfg.dbPath / "shares.log", info.Name, _base, _cfg.ShareLogFlushInterval, _cfg.ShareLogSyncInterval, _cfg.ShareLogFileSizeLimit, _cfg.ShareLogBacklogLimit, shareLogConfig);
 
   ProfitSwitchCoeff_ = CoinInfo_.ProfitSwitchDefaultCoeff;
 
@@ -81,7 +81,7 @@ void PoolBackend::stop()
 
   postQuitOperation(_base);
   _thread.join();
-  ShareLog_.flush();
+  ShareLog_.stop();
 }
 
 void PoolBackend::backendMain()
@@ -155,19 +155,25 @@ void PoolBackend::onUpdateDag(unsigned epochNumber, bool bigEpoch)
   if (EthDagFiles_[epochNumber].get() != nullptr && EthDagFiles_[epochNumber+1].get() != nullptr)
     return;
 
+  std::filesystem::path fullDatasetDirectory = _cfg.dbPath / "ethash";
   if (epochNumber != 0 && EthDagFiles_[epochNumber-1].get() != nullptr) {
     LOG_F(INFO, "%s: remove DAG for epoch %u", CoinInfo_.Name.c_str(), epochNumber-1);
+    // Full dataset file removed by wrapper itself after its generator finished
+    if (_cfg.EthashFullDataset)
+      EthDagFiles_[epochNumber-1].get()->releaseFullDataset();
     EthDagFiles_[epochNumber-1].reset();
   }
 
-  if (EthDagFiles_[epochNumber].get() == nullptr) {
-    LOG_F(INFO, "%s: generate DAG for epoch %u", CoinInfo_.Name.c_str(), epochNumber);
-    EthDagFiles_[epochNumber].reset(new EthashDagWrapper(epochNumber, bigEpoch));
-  }
+  for (unsigned epoch = epochNumber; epoch <= epochNumber+1; epoch++) {
+    if (EthDagFiles_[epoch].get() != nullptr)
+      continue;
 
-  if (EthDagFiles_[epochNumber+1].get() == nullptr) {
-    LOG_F(INFO, "%s: generate DAG for epoch %u", CoinInfo_.Name.c_str(), epochNumber+1);
-    EthDagFiles_[epochNumber+1].reset(new EthashDagWrapper(epochNumber+1, bigEpoch));
+    LOG_F(INFO, "%s: generate DAG for epoch %u", CoinInfo_.Name.c_str(), epoch);
+    EthashDagWrapper *dag = new EthashDagWrapper(epoch, bigEpoch);
+    EthDagFiles_[epoch].reset(dag);
+    // Light cache used until full dataset is ready
+    if (_cfg.EthashFullDataset)
+      dag->startFullDataset(fullDatasetDirectory, _cfg.EthashFullDatasetThreads);
   }
 }
 
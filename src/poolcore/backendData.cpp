@@ -40,6 +40,7 @@ struct DbIo<PayoutDbRecord> {
     dbIoSerialize(stream, data.TransactionData);
     dbIoSerialize(stream, data.Status);
     dbIoSerialize(stream, data.TxFee);
+    dbIoSerialize(stream, data.BatchSize);
   }
 
   static inline void unserialize(xmstream &stream, PayoutDbRecord &data) {
@@ -55,6 +56,9 @@ struct DbIo<PayoutDbRecord> {
       if (version >= 2) {
         dbIoUnserialize(stream, data.TxFee);
       }
+      if (version >= 3) {
+        dbIoUnserialize(stream, data.BatchSize);
+      }
     }
   }
 };
@@ -477,6 +481,69 @@ void PoolBalanceRecord::serializeValue(xmstream &stream) const
   dbIoSerialize(stream, Net);
 }
 
+// ====================== PoolTotalsRecord ======================
+
+bool PoolTotalsRecord::deserializeValue(const void *data, size_t size)
+{
+  xmstream stream((void*)data, size);
+  uint32_t version;
+  dbIoUnserialize(stream, version);
+  if (version >= 1) {
+    dbIoUnserialize(stream, BlocksFound);
+    dbIoUnserialize(stream, AccumulatedWork);
+    dbIoUnserialize(stream, PaidOut);
+  }
+
+  return !stream.eof();
+}
+
+void PoolTotalsRecord::serializeKey(xmstream &stream) const
+{
+  // Single record
+  dbKeyIoSerialize(stream, std::string("totals"));
+}
+
+void PoolTotalsRecord::serializeValue(xmstream &stream) const
+{
+  dbIoSerialize(stream, static_cast<uint32_t>(CurrentRecordVersion));
+  dbIoSerialize(stream, BlocksFound);
+  dbIoSerialize(stream, AccumulatedWork);
+  dbIoSerialize(stream, PaidOut);
+}
+
+// ====================== PoolLuckPrefixRecord ======================
+
+bool PoolLuckPrefixRecord::deserializeValue(const void *data, size_t size)
+{
+  xmstream stream((void*)data, size);
+  uint32_t version;
+  dbIoUnserialize(stream, version);
+  if (version >= 1) {
+    dbIoUnserialize(stream, Index);
+    dbIoUnserialize(stream, Height);
+    dbIoUnserialize(stream, Time);
+    dbIoUnserialize(stream, AccumulatedWork);
+    dbIoUnserialize(stream, ExpectedWork);
+  }
+
+  return !stream.eof();
+}
+
+void PoolLuckPrefixRecord::serializeKey(xmstream &stream) const
+{
+  dbKeyIoSerialize(stream, Index);
+}
+
+void PoolLuckPrefixRecord::serializeValue(xmstream &stream) const
+{
+  dbIoSerialize(stream, static_cast<uint32_t>(CurrentRecordVersion));
+  dbIoSerialize(stream, Index);
+  dbIoSerialize(stream, Height);
+  dbIoSerialize(stream, Time);
+  dbIoSerialize(stream, AccumulatedWork);
+  dbIoSerialize(stream, ExpectedWork);
+}
+
 // ====================== ClientStatsRecord ======================
 
 bool StatsRecord::deserializeValue(xmstream &stream)
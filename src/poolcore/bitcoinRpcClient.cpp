@@ -13,6 +13,7 @@
 #include "p2putils/uriParse.h"
 #include "rapidjson/document.h"
 #include "loguru.hpp"
+#include <errno.h>
 #include <string.h>
 #include <chrono>
 
@@ -25,11 +26,11 @@
 #include <netdb.h>
 #endif
 
-static const std::string gBalanceQuery = R"json({"method": "getbalance", "params": [] })json";
-static const std::string gBalanceQueryWithImmatured = R"json({"method": "getbalance", "params": ["*", 1] })json";
 static const std::string gGetWalletInfoQuery = R"json({"method": "getwalletinfo", "params": [] })json";
-static const std::string gGetBlockChainInfoQuery = R"json({"method": "getblockchaininfo", "params": [] })json";
-static const std::string gGetInfoQuery = R"json({"method": "getinfo", "params": []})json";
+
+// Node closes idle connections after -rpcservertimeout (30 seconds by default)
+static constexpr std::chrono::seconds gKeepAliveIdleTimeout = std::chrono::seconds(15);
+static constexpr size_t gKeepAliveMaxIdleConnections = 4;
 
 static inline void jsonParseInt(const rapidjson::Value &value, const char *name, int64_t *out, bool *validAcc) {
   if (value.HasMember(name)) {
@@ -94,6 +95,44 @@ static void buildPostQuery(const char *data, size_t size, const std::string &hos
     out.write(data, size);
 }
 
+// Checks that idle keep-alive connection was not closed by node
+static bool socketIsAlive(socketTy socket)
+{
+  char byte;
+#ifndef WIN32
+  ssize_t result = recv(socket, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#else
+  int result = recv(socket, &byte, 1, MSG_PEEK);
+  return result < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#endif
+}
+
+// Accepts host:port and tcp://host:port
+static bool parseZmqAddress(const char *address, HostAddress &result)
+{
+  std::string uriAddress = address;
+  if (uriAddress.compare(0, 6, "tcp://") == 0)
+    uriAddress.erase(0, 6);
+
+  URI uri;
+  if (!uriParse(("http://" + uriAddress).c_str(), &uri) || !uri.port)
+    return false;
+
+  result.family = AF_INET;
+  result.port = htons(uri.port);
+  if (!uri.domain.empty()) {
+    struct hostent *host = gethostbyname(uri.domain.c_str());
+    if (!host || !host->h_addr_list[0])
+      return false;
+    result.ipv4 = reinterpret_cast<struct in_addr*>(host->h_addr_list[0])->s_addr;
+  } else {
+    result.ipv4 = uri.ipv4;
+  }
+
+  return true;
+}
+
 static std::string buildGetBlockTemplate(const std::string &longPollId, bool segwitEnabled, bool mwebEnabled)
 {
   char buffer[2048];
@@ -136,6 +175,30 @@ static std::string buildGetBlockTemplate(const std::string &longPollId, bool seg
   return std::string(stream.data<char>(), stream.sizeOf());
 }
 
+std::string CBitcoinRpcClient::buildHttpQuery(const std::string &data)
+{
+  return ::buildPostQuery(data.data(), data.size(), HostName_, BasicAuth_);
+}
+
+std::string CBitcoinRpcClient::buildBatchQuery(const std::vector<CRpcCall> &calls)
+{
+  std::string query = "[";
+  for (size_t i = 0, ie = calls.size(); i != ie; ++i) {
+    if (i)
+      query.append(", ");
+    // String id: batch response can be parsed with kParseNumbersAsStringsFlag
+    query.append(R"_({"id": ")_");
+    query.append(std::to_string(i));
+    query.append(R"_(", "method": ")_");
+    query.append(calls[i].Method);
+    query.append(R"_(", "params": )_");
+    query.append(calls[i].Params);
+    query.push_back('}');
+  }
+  query.push_back(']');
+  return query;
+}
+
 std::string CBitcoinRpcClient::buildSendToAddress(const std::string &destination, int64_t amount)
 {
   std::string result = "{";
@@ -160,6 +223,37 @@ std::string CBitcoinRpcClient::buildGetTransaction(const std::string &txId)
   return result;
 }
 
+CNetworkClient::EOperationStatus CBitcoinRpcClient::decodeTransactionId(CConnection *connection, const std::string &txData, std::string &txId, std::string &error)
+{
+  xmstream postData;
+  {
+    JSON::Object object(postData);
+    object.addString("method", "decoderawtransaction");
+    object.addField("params");
+    {
+      JSON::Array params(postData);
+      params.addString(txData);
+    }
+  }
+
+  rapidjson::Document document;
+  CNetworkClient::EOperationStatus status = ioQueryJson(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
+  if (status != CNetworkClient::EStatusOk) {
+    error = connection->LastError;
+    return status;
+  }
+
+  if (!document.HasMember("result") || !document["result"].IsObject())
+    return CNetworkClient::EStatusProtocolError;
+
+  rapidjson::Value &decodeResult = document["result"];
+  if (!decodeResult.HasMember("txid") || !decodeResult["txid"].IsString())
+    return CNetworkClient::EStatusProtocolError;
+
+  txId = decodeResult["txid"].GetString();
+  return CNetworkClient::EStatusOk;
+}
+
 CNetworkClient::EOperationStatus CBitcoinRpcClient::signRawTransaction(CConnection *connection, const std::string &fundedTransaction, std::string &signedTransaction, std::string &error)
 {
   xmstream postData;
@@ -212,10 +306,11 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::signRawTransaction(CConnecti
   return EStatusOk;
 }
 
-CBitcoinRpcClient::CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const CCoinInfo &coinInfo, const char *address, const char *login, const char *password, bool longPollEnabled) :
+CBitcoinRpcClient::CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const CCoinInfo &coinInfo, const char *address, const char *login, const char *password, bool longPollEnabled, const char *zmqAddress, bool emptyWorkEnabled) :
   CNetworkClient(threadsNum),
-  WorkFetcherBase_(base), ThreadsNum_(threadsNum), CoinInfo_(coinInfo), HasLongPoll_(longPollEnabled)
+  WorkFetcherBase_(base), ThreadsNum_(threadsNum), CoinInfo_(coinInfo), HasLongPoll_(longPollEnabled), EmptyWorkEnabled_(emptyWorkEnabled)
 {
+  ConnectionPools_.reset(new std::vector<std::unique_ptr<CConnection>>[threadsNum]);
   WorkFetcher_.Client = nullptr;
   httpParseDefaultInit(&WorkFetcher_.ParseCtx);
   WorkFetcher_.TimerEvent = newUserEvent(base, 0, [](aioUserEvent*, void *arg) {
@@ -269,9 +364,20 @@ CBitcoinRpcClient::CBitcoinRpcClient(asyncBase *base, unsigned threadsNum, const
   BasicAuth_.resize(base64getEncodeLength(basicAuth.size()));
   base64Encode(BasicAuth_.data(), reinterpret_cast<uint8_t*>(basicAuth.data()), basicAuth.size());
 
-  BalanceQuery_ = buildPostQuery(gBalanceQuery.data(), gBalanceQuery.size(), HostName_, BasicAuth_);
-  BalanceQueryWithImmatured_ = buildPostQuery(gBalanceQueryWithImmatured.data(), gBalanceQueryWithImmatured.size(), HostName_, BasicAuth_);
-  GetWalletInfoQuery_ = buildPostQuery(gGetWalletInfoQuery.data(), gGetWalletInfoQuery.size(), HostName_, BasicAuth_);
+  GetWalletInfoQuery_ = buildHttpQuery(gGetWalletInfoQuery);
+
+  if (zmqAddress && *zmqAddress) {
+    if (!parseZmqAddress(zmqAddress, Zmq_.Address)) {
+      LOG_F(ERROR, "%s: can't parse zmq address %s", coinInfo.Name.c_str(), zmqAddress);
+      exit(1);
+    }
+
+    Zmq_.Enabled = true;
+    httpParseDefaultInit(&Zmq_.ParseCtx);
+    Zmq_.ReconnectEvent = newUserEvent(base, 0, [](aioUserEvent*, void *arg) {
+      static_cast<CBitcoinRpcClient*>(arg)->zmqConnect();
+    }, this);
+  }
 }
 
 CPreparedQuery *CBitcoinRpcClient::prepareBlock(const void *data, size_t size)
@@ -296,11 +402,9 @@ CPreparedQuery *CBitcoinRpcClient::prepareBlock(const void *data, size_t size)
 
 bool CBitcoinRpcClient::ioGetBalance(asyncBase *base, CNetworkClient::GetBalanceResult &result)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return false;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return false;
 
 
   if (HasGetWalletInfo_) {
@@ -323,11 +427,6 @@ bool CBitcoinRpcClient::ioGetBalance(asyncBase *base, CNetworkClient::GetBalance
       }
     } else if (connection->ParseCtx.resultCode == 404) {
       LOG_F(WARNING, "%s %s: doesn't support getwalletinfo api; recommended update your node", CoinInfo_.Name.c_str(), FullHostName_.c_str());
-      connection.reset(getConnection(base));
-      if (!connection)
-        return false;
-      if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-        return false;
       HasGetWalletInfo_ = false;
     } else {
       return false;
@@ -335,16 +434,18 @@ bool CBitcoinRpcClient::ioGetBalance(asyncBase *base, CNetworkClient::GetBalance
   }
 
   if (!HasGetWalletInfo_) {
-    rapidjson::Document balanceValue;
-    rapidjson::Document fullBalanceValue;
-    if (ioQueryJson<rapidjson::kParseNumbersAsStringsFlag>(*connection, BalanceQuery_, balanceValue, 10000000) == EStatusOk &&
-        ioQueryJson<rapidjson::kParseNumbersAsStringsFlag>(*connection, BalanceQueryWithImmatured_, fullBalanceValue, 10000000) == EStatusOk) {
+    std::vector<CRpcCall> calls;
+    calls.emplace_back("getbalance", "[]");
+    calls.emplace_back("getbalance", R"_(["*", 1])_");
+    rapidjson::Document document;
+    std::vector<rapidjson::Value*> responses;
+    if (ioQueryBatch<rapidjson::kParseNumbersAsStringsFlag>(*connection, calls, document, responses, 10000000) == EStatusOk) {
       std::string balanceS;
       std::string balanceFullS;
       int64_t balanceFull;
       bool errorAcc = true;
-      jsonParseString(balanceValue, "result", balanceS, true, &errorAcc);
-      jsonParseString(fullBalanceValue, "result", balanceFullS, true, &errorAcc);
+      jsonParseString(*responses[0], "result", balanceS, true, &errorAcc);
+      jsonParseString(*responses[1], "result", balanceFullS, true, &errorAcc);
       if (errorAcc &&
           parseMoneyValue(balanceS.c_str(), CoinInfo_.RationalPartSize, &result.Balance) &&
           parseMoneyValue(balanceFullS.c_str(), CoinInfo_.RationalPartSize, &balanceFull)) {
@@ -365,39 +466,24 @@ bool CBitcoinRpcClient::ioGetBlockConfirmations(asyncBase *base, int64_t orphanA
   for (auto &It: query)
     It.Confirmations = -2;
 
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return false;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return false;
 
-  std::string jsonQuery = "[";
-  if (HasGetBlockChainInfo_)
-    jsonQuery.append(gGetBlockChainInfoQuery);
-  else
-    jsonQuery.append(gGetInfoQuery);
-  for (auto &block: query) {
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), ", {\"method\": \"getblockhash\", \"params\": [%" PRIu64 "]}", block.Height);
-    jsonQuery.append(buffer);
-  }
-  jsonQuery.push_back(']');
+  std::vector<CRpcCall> calls;
+  calls.emplace_back(HasGetBlockChainInfo_ ? "getblockchaininfo" : "getinfo", "[]");
+  for (auto &block: query)
+    calls.emplace_back("getblockhash", "[" + std::to_string(block.Height) + "]");
 
   rapidjson::Document document;
-  if (ioQueryJson(*connection, buildPostQuery(jsonQuery.data(), jsonQuery.size(), HostName_, BasicAuth_), document, 5*1000000) != EStatusOk) {
+  std::vector<rapidjson::Value*> responses;
+  if (ioQueryBatch(*connection, calls, document, responses, 5*1000000) != EStatusOk)
     return false;
-  }
-
-  if (!document.IsArray() ||
-      document.GetArray().Size() != query.size() + 1) {
-    LOG_F(WARNING, "%s %s: response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
-    return false;
-  }
 
   // Check response to getinfo query
   uint64_t bestBlockHeight = 0;
   {
-    rapidjson::Value &value = document.GetArray()[0];
+    rapidjson::Value &value = *responses[0];
     if (!value.HasMember("result") || !(value["result"].IsObject() || value["result"].IsNull())) {
       LOG_F(WARNING, "%s %s: response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
       return false;
@@ -418,8 +504,8 @@ bool CBitcoinRpcClient::ioGetBlockConfirmations(asyncBase *base, int64_t orphanA
   }
 
   // Check getblockhash responses
-  for (rapidjson::SizeType i = 1, ie = document.GetArray().Size(); i != ie; ++i) {
-    rapidjson::Value &value = document.GetArray()[i];
+  for (size_t i = 1, ie = responses.size(); i != ie; ++i) {
+    rapidjson::Value &value = *responses[i];
     if (!value.IsObject() || !value.HasMember("result") || !value["result"].IsString()) {
       LOG_F(WARNING, "%s %s: response invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
       return false;
@@ -433,11 +519,9 @@ bool CBitcoinRpcClient::ioGetBlockConfirmations(asyncBase *base, int64_t orphanA
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildTransaction(asyncBase *base, const std::string &address, const std::string &changeAddress, const int64_t value, BuildTransactionResult &result)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   std::string rawTransaction;
   std::string fundedTransaction;
@@ -541,45 +625,155 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildTransaction(asyncBase
   }
 
   // get transaction id
-  postData.reset();
-  {
-    JSON::Object object(postData);
-    object.addString("method", "decoderawtransaction");
-    object.addField("params");
+  return decodeTransactionId(connection.get(), result.TxData, result.TxId, result.Error);
+}
+
+// Batch transaction fee is split between outputs, first (fee % outputs) recipients pay one unit more
+static inline int64_t outputFeeShare(int64_t fee, size_t index, size_t outputsNum)
+{
+  return fee / static_cast<int64_t>(outputsNum) + (index < static_cast<size_t>(fee % static_cast<int64_t>(outputsNum)) ? 1 : 0);
+}
+
+CNetworkClient::EOperationStatus CBitcoinRpcClient::ioBuildTransactionBatch(asyncBase *base, const std::vector<BuildTransactionOutput> &outputs, const std::string &changeAddress, BuildBatchTransactionResult &result)
+{
+  // Fee estimation can't converge in more iterations
+  static constexpr unsigned MaxFundIterations = 8;
+
+  if (outputs.empty())
+    return CNetworkClient::EStatusUnknownError;
+
+  CConnectionPtr connection = acquireConnection(base);
+  if (!connection)
+    return CNetworkClient::EStatusNetworkError;
+
+  std::string rawTransaction;
+  std::string fundedTransaction;
+  size_t outputsNum = outputs.size();
+  int64_t totalValue = 0;
+  for (const auto &output: outputs)
+    totalValue += output.Value;
+
+  result.Values.resize(outputsNum);
+  result.Fees.resize(outputsNum);
+  int64_t subtractedFee = 0;
+  xmstream postData;
+  for (unsigned iteration = 0; ; iteration++) {
+    // Subtract fee estimated at previous iteration from outputs
+    int64_t outputsValue = 0;
+    for (size_t i = 0; i < outputsNum; i++) {
+      result.Values[i] = outputs[i].Value - outputFeeShare(subtractedFee, i, outputsNum);
+      if (result.Values[i] <= 0) {
+        result.Error = "too big fee";
+        return CNetworkClient::EStatusUnknownError;
+      }
+      outputsValue += result.Values[i];
+    }
+
+    // createrawtransaction
+    postData.reset();
     {
-      JSON::Array params(postData);
-      params.addString(result.TxData);
+      JSON::Object object(postData);
+      object.addString("method", "createrawtransaction");
+      object.addField("params");
+      {
+        JSON::Array params(postData);
+        params.addField();
+        {
+          JSON::Array inputs(postData);
+        }
+
+        params.addField();
+        {
+          JSON::Object outputsObject(postData);
+          for (size_t i = 0; i < outputsNum; i++)
+            outputsObject.addCustom(outputs[i].Address.c_str(), FormatMoney(result.Values[i], CoinInfo_.RationalPartSize));
+        }
+      }
     }
-  }
 
-  {
-    rapidjson::Document document;
-    CNetworkClient::EOperationStatus status = ioQueryJson(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
-    if (status != CNetworkClient::EStatusOk) {
-      result.Error = connection->LastError;
-      return status;
+    {
+      rapidjson::Document document;
+      CNetworkClient::EOperationStatus status = ioQueryJson(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
+      if (status != CNetworkClient::EStatusOk) {
+        result.Error = connection->LastError;
+        return status;
+      }
+      if (!document.HasMember("result") || !document["result"].IsString())
+        return CNetworkClient::EStatusProtocolError;
+      rawTransaction = document["result"].GetString();
     }
 
-    if (!document.HasMember("result") || !document["result"].IsObject())
-      return CNetworkClient::EStatusProtocolError;
+    // fundrawtransaction, wallet estimates fee for whole batch
+    postData.reset();
+    {
+      JSON::Object object(postData);
+      object.addString("method", "fundrawtransaction");
+      object.addField("params");
+      {
+        JSON::Array params(postData);
+        params.addString(rawTransaction);
+        if (CoinInfo_.HasExtendedFundRawTransaction) {
+          params.addField();
+          {
+            JSON::Object options(postData);
+            options.addString("changeAddress", changeAddress);
+          }
+        }
+      }
+    }
 
-    rapidjson::Value &decodeResult = document["result"];
-    if (!decodeResult.HasMember("txid") || !decodeResult["txid"].IsString())
-      return CNetworkClient::EStatusProtocolError;
+    {
+      rapidjson::Document document;
+      CNetworkClient::EOperationStatus status = ioQueryJson<rapidjson::kParseNumbersAsStringsFlag>(*connection, buildPostQuery(postData.data<const char>(), postData.sizeOf(), HostName_, BasicAuth_), document, 180*1000000);
+      if (status != CNetworkClient::EStatusOk) {
+        static constexpr int RPC_WALLET_INSUFFICIENT_FUNDS = -6;
+        result.Error = connection->LastError;
+        return connection->LastErrorCode == RPC_WALLET_INSUFFICIENT_FUNDS ? EStatusInsufficientFunds : status;
+      }
+
+      if (!document.HasMember("result") || !document["result"].IsObject())
+        return CNetworkClient::EStatusProtocolError;
+
+      rapidjson::Value &fundTxResult = document["result"];
+      if (!fundTxResult.HasMember("hex") || !fundTxResult["hex"].IsString() ||
+          !fundTxResult.HasMember("fee") || !fundTxResult["fee"].IsString())
+        return CNetworkClient::EStatusProtocolError;
+
+      fundedTransaction = fundTxResult["hex"].GetString();
+      if (!parseMoneyValue(fundTxResult["fee"].GetString(), CoinInfo_.RationalPartSize, &result.Fee))
+        return CNetworkClient::EStatusProtocolError;
+    }
+
+    if (outputsValue + result.Fee <= totalValue)
+      break;
 
-    result.TxId = decodeResult["txid"].GetString();
+    if (iteration + 1 == MaxFundIterations) {
+      result.Error = "can't estimate fee";
+      return CNetworkClient::EStatusUnknownError;
+    }
+
+    subtractedFee = result.Fee;
   }
 
-  return EStatusOk;
+  for (size_t i = 0; i < outputsNum; i++)
+    result.Fees[i] = outputFeeShare(result.Fee, i, outputsNum);
+
+  // signrawtransaction
+  {
+    EOperationStatus status = signRawTransaction(connection.get(), fundedTransaction, result.TxData, result.Error);
+    if (status != EStatusOk)
+      return status;
+  }
+
+  // get transaction id
+  return decodeTransactionId(connection.get(), result.TxData, result.TxId, result.Error);
 }
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioSendTransaction(asyncBase *base, const std::string &txData, const std::string&, std::string &error)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   xmstream postData;
   {
@@ -620,11 +814,9 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioGetTxConfirmations(asyncBa
   // Not used here
   *txFee = 0;
 
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   xmstream postData;
   {
@@ -661,6 +853,54 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioGetTxConfirmations(asyncBa
   return EStatusOk;
 }
 
+CNetworkClient::EOperationStatus CBitcoinRpcClient::ioGetTxConfirmationsBatch(asyncBase *base, std::vector<GetTxConfirmationsQuery> &query)
+{
+  if (query.empty())
+    return EStatusOk;
+
+  CConnectionPtr connection = acquireConnection(base);
+  if (!connection)
+    return CNetworkClient::EStatusNetworkError;
+
+  std::vector<CRpcCall> calls;
+  for (const auto &tx: query)
+    calls.emplace_back("gettransaction", "[\"" + tx.TxId + "\"]");
+
+  rapidjson::Document document;
+  std::vector<rapidjson::Value*> responses;
+  CNetworkClient::EOperationStatus status = ioQueryBatch(*connection, calls, document, responses, 180*1000000);
+  if (status != CNetworkClient::EStatusOk)
+    return status;
+
+  for (size_t i = 0, ie = query.size(); i != ie; ++i) {
+    GetTxConfirmationsQuery &tx = query[i];
+    rapidjson::Value &value = *responses[i];
+    // Not used here
+    tx.TxFee = 0;
+    if (value.HasMember("error") && value["error"].IsObject()) {
+      constexpr int RPC_INVALID_ADDRESS_OR_KEY = -5;
+      rapidjson::Value &error = value["error"];
+      if (error.HasMember("message") && error["message"].IsString())
+        tx.Error = error["message"].GetString();
+      tx.Status = error.HasMember("code") && error["code"].IsInt() && error["code"].GetInt() == RPC_INVALID_ADDRESS_OR_KEY ?
+        EStatusInvalidAddressOrKey :
+        EStatusProtocolError;
+      continue;
+    }
+
+    if (!value.HasMember("result") || !value["result"].IsObject() ||
+        !value["result"].HasMember("confirmations") || !value["result"]["confirmations"].IsInt64()) {
+      tx.Status = EStatusProtocolError;
+      continue;
+    }
+
+    tx.Confirmations = value["result"]["confirmations"].GetInt64();
+    tx.Status = EStatusOk;
+  }
+
+  return EStatusOk;
+}
+
 void CBitcoinRpcClient::aioSubmitBlock(asyncBase *base, CPreparedQuery *queryPtr, CSubmitBlockOperation *operation)
 {
   CPreparedSubmitBlock *query = static_cast<CPreparedSubmitBlock*>(queryPtr);
@@ -694,11 +934,9 @@ void CBitcoinRpcClient::aioSubmitBlock(asyncBase *base, CPreparedQuery *queryPtr
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioListUnspent(asyncBase *base, ListUnspentResult &result)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   xmstream postData;
   {
@@ -739,11 +977,9 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioListUnspent(asyncBase *bas
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioZSendMany(asyncBase *base, const std::string &source, const std::string &destination, int64_t amount, const std::string &memo, uint64_t minConf, int64_t fee, CNetworkClient::ZSendMoneyResult &result)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   xmstream postData;
   {
@@ -795,11 +1031,9 @@ CNetworkClient::EOperationStatus CBitcoinRpcClient::ioZSendMany(asyncBase *base,
 
 CNetworkClient::EOperationStatus CBitcoinRpcClient::ioZGetBalance(asyncBase *base, const std::string &address, int64_t *balance)
 {
-  std::unique_ptr<CConnection> connection(getConnection(base));
+  CConnectionPtr connection = acquireConnection(base);
   if (!connection)
     return CNetworkClient::EStatusNetworkError;
-  if (ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
-    return CNetworkClient::EStatusNetworkError;
 
   xmstream postData;
   {
@@ -842,6 +1076,104 @@ void CBitcoinRpcClient::poll()
   aioHttpConnect(WorkFetcher_.Client, &Address_, nullptr, 3000000, [](AsyncOpStatus status, HTTPClient*, void *arg){
     static_cast<CBitcoinRpcClient*>(arg)->onWorkFetcherConnect(status);
   }, this);
+
+  if (Zmq_.Enabled && !Zmq_.Started) {
+    Zmq_.Started = true;
+    zmqConnect();
+  }
+}
+
+CBlockTemplate *CBitcoinRpcClient::parseBlockTemplate(HTTPParseDefaultContext &parseCtx, std::string &prevBlockHash, int64_t *height)
+{
+  std::unique_ptr<CBlockTemplate> blockTemplate(new CBlockTemplate);
+  blockTemplate->Document.Parse(parseCtx.body.data);
+  if (blockTemplate->Document.HasParseError()) {
+    LOG_F(WARNING, "%s %s: JSON parse error", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+    return nullptr;
+  }
+
+  if (!blockTemplate->Document["result"].IsObject()) {
+    LOG_F(WARNING, "%s %s: JSON invalid format: no result object", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+    return nullptr;
+  }
+
+  std::string bits;
+  bool validAcc = true;
+  rapidjson::Value &resultObject = blockTemplate->Document["result"];
+  jsonParseString(resultObject, "previousblockhash", prevBlockHash, true, &validAcc);
+  jsonParseInt(resultObject, "height", height, &validAcc);
+  jsonParseString(resultObject, "bits", bits, true, &validAcc);
+  if (!validAcc || prevBlockHash.size() < 16) {
+    LOG_F(WARNING, "%s %s: getblocktemplate invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+    return nullptr;
+  }
+
+  // Get unique work id
+  blockTemplate->UniqueWorkId = readHexBE<uint64_t>(prevBlockHash.c_str(), 16);
+
+  arith_uint256 powLimit = UintToArith256(CoinInfo_.PowLimit);
+  arith_uint256 target;
+  target.SetCompact(strtoul(bits.c_str(), nullptr, 16));
+  powLimit /= target;
+  double difficulty = powLimit.getdouble();
+
+//  double difficulty = BTC::getDifficulty(strtoul(bits.c_str(), nullptr, 16)) * 4294967296.0 / CoinInfo_.WorkMultiplier;
+  blockTemplate->Difficulty = difficulty;
+  return blockTemplate.release();
+}
+
+CBlockTemplate *CBitcoinRpcClient::buildEmptyBlockTemplate(CBlockTemplate &blockTemplate)
+{
+  rapidjson::Value &resultObject = blockTemplate.Document["result"];
+  if (!resultObject.HasMember("transactions") || !resultObject["transactions"].IsArray() ||
+      !resultObject.HasMember("coinbasevalue") || !resultObject["coinbasevalue"].IsInt64() ||
+      resultObject.HasMember("mweb"))
+    return nullptr;
+
+  // Node provided coinbase transaction includes fees
+  if (resultObject.HasMember("coinbasetxn") && resultObject["coinbasetxn"].IsObject() && resultObject["coinbasetxn"].HasMember("data"))
+    return nullptr;
+
+  int64_t coinbaseValue = resultObject["coinbasevalue"].GetInt64();
+  for (const rapidjson::Value &tx: resultObject["transactions"].GetArray()) {
+    if (!tx.IsObject() || !tx.HasMember("fee") || !tx["fee"].IsInt64())
+      return nullptr;
+    coinbaseValue -= tx["fee"].GetInt64();
+  }
+
+  std::unique_ptr<CBlockTemplate> emptyTemplate(new CBlockTemplate);
+  rapidjson::Document &document = emptyTemplate->Document;
+  rapidjson::Document::AllocatorType &allocator = document.GetAllocator();
+  document.SetObject();
+
+  // Witness commitment not needed for block without transactions
+  rapidjson::Value emptyResult(rapidjson::kObjectType);
+  for (const auto &member: resultObject.GetObject()) {
+    const char *name = member.name.GetString();
+    if (strcmp(name, "transactions") == 0 || strcmp(name, "coinbasevalue") == 0 || strcmp(name, "default_witness_commitment") == 0)
+      continue;
+    emptyResult.AddMember(rapidjson::Value(member.name, allocator), rapidjson::Value(member.value, allocator), allocator);
+  }
+
+  emptyResult.AddMember("transactions", rapidjson::Value(rapidjson::kArrayType), allocator);
+  emptyResult.AddMember("coinbasevalue", rapidjson::Value(coinbaseValue), allocator);
+  document.AddMember("result", emptyResult, allocator);
+
+  emptyTemplate->UniqueWorkId = blockTemplate.UniqueWorkId;
+  emptyTemplate->Difficulty = blockTemplate.Difficulty;
+  return emptyTemplate.release();
+}
+
+void CBitcoinRpcClient::sendBlockTemplate(CBlockTemplate *blockTemplate, bool isNewBlock)
+{
+  // Miners switch to new block without waiting for transactions processing, full work replaces empty one
+  if (isNewBlock && EmptyWorkEnabled_) {
+    CBlockTemplate *emptyTemplate = buildEmptyBlockTemplate(*blockTemplate);
+    if (emptyTemplate)
+      Dispatcher_->onWorkFetcherNewWork(emptyTemplate);
+  }
+
+  Dispatcher_->onWorkFetcherNewWork(blockTemplate);
 }
 
 void CBitcoinRpcClient::onWorkFetcherConnect(AsyncOpStatus status)
@@ -853,6 +1185,7 @@ void CBitcoinRpcClient::onWorkFetcherConnect(AsyncOpStatus status)
     return;
   }
 
+  WorkFetcher_.Active = true;
   std::string gbtQuery = buildGetBlockTemplate(WorkFetcher_.LongPollId, CoinInfo_.SegwitEnabled, CoinInfo_.MWebEnabled);
   std::string query = buildPostQuery(gbtQuery.data(), gbtQuery.size(), HostName_, BasicAuth_);
   aioHttpRequest(WorkFetcher_.Client, query.c_str(), query.size(), 60000000, httpParseDefault, &WorkFetcher_.ParseCtx, [](AsyncOpStatus status, HTTPClient*, void *arg){
@@ -869,77 +1202,52 @@ void CBitcoinRpcClient::onWorkFetcherIncomingData(AsyncOpStatus status)
           static_cast<unsigned>(status),
           WorkFetcher_.ParseCtx.resultCode,
           WorkFetcher_.ParseCtx.body.data ? WorkFetcher_.ParseCtx.body.data : "<null>");
+    WorkFetcher_.Active = false;
     httpClientDelete(WorkFetcher_.Client);
     Dispatcher_->onWorkFetcherConnectionLost();
     return;
   }
 
-  std::unique_ptr<CBlockTemplate> blockTemplate(new CBlockTemplate);
-  blockTemplate->Document.Parse(WorkFetcher_.ParseCtx.body.data);
-  if (blockTemplate->Document.HasParseError()) {
-    LOG_F(WARNING, "%s %s: JSON parse error", CoinInfo_.Name.c_str(), FullHostName_.c_str());
-    httpClientDelete(WorkFetcher_.Client);
-    Dispatcher_->onWorkFetcherConnectionLost();
-    return;
-  }
-
-  if (!blockTemplate->Document["result"].IsObject()) {
-    LOG_F(WARNING, "%s %s: JSON invalid format: no result object", CoinInfo_.Name.c_str(), FullHostName_.c_str());
-    httpClientDelete(WorkFetcher_.Client);
-    Dispatcher_->onWorkFetcherConnectionLost();
-    return;
-  }
-
-  auto now = std::chrono::steady_clock::now();
-
   int64_t height = 0;
   std::string prevBlockHash;
-  std::string bits;
-  bool validAcc = true;
-  rapidjson::Value &resultObject = blockTemplate->Document["result"];
-  jsonParseString(resultObject, "previousblockhash", prevBlockHash, true, &validAcc);
-  jsonParseInt(resultObject, "height", &height, &validAcc);
-  jsonParseString(resultObject, "bits", bits, true, &validAcc);
-  if (!validAcc || prevBlockHash.size() < 16) {
-    LOG_F(WARNING, "%s %s: getblocktemplate invalid format", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+  std::unique_ptr<CBlockTemplate> blockTemplate(parseBlockTemplate(WorkFetcher_.ParseCtx, prevBlockHash, &height));
+  if (!blockTemplate) {
+    WorkFetcher_.Active = false;
     httpClientDelete(WorkFetcher_.Client);
     Dispatcher_->onWorkFetcherConnectionLost();
     return;
   }
 
+  auto now = std::chrono::steady_clock::now();
   if (!WorkFetcher_.LongPollId.empty()) {
-    jsonParseString(resultObject, "longpollid", WorkFetcher_.LongPollId, true, &validAcc);
+    bool validAcc = true;
+    jsonParseString(blockTemplate->Document["result"], "longpollid", WorkFetcher_.LongPollId, true, &validAcc);
     if (!validAcc) {
       LOG_F(WARNING, "%s %s: does not support long poll, strongly recommended update your node", CoinInfo_.Name.c_str(), FullHostName_.c_str());
       WorkFetcher_.LongPollId.clear();
     }
   }
 
-  // Get unique work id
-  uint64_t workId = blockTemplate->UniqueWorkId = readHexBE<uint64_t>(prevBlockHash.c_str(), 16);
-
-  arith_uint256 powLimit = UintToArith256(CoinInfo_.PowLimit);
-  arith_uint256 target;
-  target.SetCompact(strtoul(bits.c_str(), nullptr, 16));
-  powLimit /= target;
-  double difficulty = powLimit.getdouble();
-
-//  double difficulty = BTC::getDifficulty(strtoul(bits.c_str(), nullptr, 16)) * 4294967296.0 / CoinInfo_.WorkMultiplier;
-  blockTemplate->Difficulty = difficulty;
+  uint64_t workId = blockTemplate->UniqueWorkId;
+  double difficulty = blockTemplate->Difficulty;
 
   // Check new work available
   if (!WorkFetcher_.LongPollId.empty()) {
     // With long polling enabled now we check time since last response
+    // Template fetched after zmq notification also updates last response time
+    // Long poll started before notification returns template already sent, drop it
     uint64_t timeInterval = std::chrono::duration_cast<std::chrono::seconds>(now - WorkFetcher_.LastTemplateTime).count();
-    if (timeInterval) {
+    bool sentByZmq = WorkFetcher_.WorkId == workId && WorkFetcher_.LongPollId == Zmq_.LongPollId;
+    Zmq_.LongPollId.clear();
+    if (timeInterval && !sentByZmq) {
       LOG_F(INFO, "%s: new work available; previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), difficulty);
-      Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
+      sendBlockTemplate(blockTemplate.release(), WorkFetcher_.WorkId != workId);
     }
   } else {
     // Without long polling we send new task to miner on new block found
     if (WorkFetcher_.WorkId != workId) {
       LOG_F(INFO, "%s: new work available; previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), difficulty);
-      Dispatcher_->onWorkFetcherNewWork(blockTemplate.release());
+      sendBlockTemplate(blockTemplate.release(), true);
     }
   }
 
@@ -969,6 +1277,139 @@ void CBitcoinRpcClient::onWorkFetchTimeout()
   }, this);
 }
 
+void CBitcoinRpcClient::zmqConnect()
+{
+  socketTy S = socketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1);
+  Zmq_.Socket = zmtpSocketNew(WorkFetcherBase_, newSocketIo(WorkFetcherBase_, S), zmtpSocketSUB);
+  aioZmtpConnect(Zmq_.Socket, &Zmq_.Address, 3000000, [](AsyncOpStatus status, zmtpSocket*, void *arg) {
+    static_cast<CBitcoinRpcClient*>(arg)->onZmqConnect(status);
+  }, this);
+}
+
+void CBitcoinRpcClient::onZmqConnect(AsyncOpStatus status)
+{
+  if (status != aosSuccess) {
+    onZmqDisconnect();
+    return;
+  }
+
+  LOG_F(INFO, "%s %s: subscribed to zmq block notifications", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+
+  // Subscription message: 0x01 and topic
+  static const char topic[] = "hashblock";
+  Zmq_.Stream.reset();
+  Zmq_.Stream.write<uint8_t>(1);
+  Zmq_.Stream.write(topic, sizeof(topic) - 1);
+  aioZmtpSend(Zmq_.Socket, Zmq_.Stream.data(), Zmq_.Stream.sizeOf(), zmtpMessage, afNone, 0, nullptr, nullptr);
+  aioZmtpRecv(Zmq_.Socket, Zmq_.Stream, 65536, afNone, 0, [](AsyncOpStatus status, zmtpSocket*, zmtpUserMsgTy, zmtpStream*, void *arg) {
+    static_cast<CBitcoinRpcClient*>(arg)->onZmqMessage(status);
+  }, this);
+}
+
+void CBitcoinRpcClient::onZmqMessage(AsyncOpStatus status)
+{
+  if (status != aosSuccess) {
+    onZmqDisconnect();
+    return;
+  }
+
+  // Notification consists of topic, block hash and sequence number frames
+  static const char topic[] = "hashblock";
+  const uint8_t *data = static_cast<const uint8_t*>(Zmq_.Stream.data());
+  size_t size = Zmq_.Stream.remaining();
+  if (size >= sizeof(topic) - 1 + 32 && memcmp(data, topic, sizeof(topic) - 1) == 0) {
+    data += sizeof(topic) - 1;
+    size = 32;
+  }
+
+  if (size == 32) {
+    std::string hash(64, '0');
+    bin2hexLowerCase(data, hash.data(), 32);
+    if (hash != Zmq_.LastBlockHash) {
+      LOG_F(INFO, "%s %s: zmq: new block %s", CoinInfo_.Name.c_str(), FullHostName_.c_str(), hash.c_str());
+      Zmq_.LastBlockHash = hash;
+      zmqFetchTemplate();
+    }
+  }
+
+  aioZmtpRecv(Zmq_.Socket, Zmq_.Stream, 65536, afNone, 0, [](AsyncOpStatus status, zmtpSocket*, zmtpUserMsgTy, zmtpStream*, void *arg) {
+    static_cast<CBitcoinRpcClient*>(arg)->onZmqMessage(status);
+  }, this);
+}
+
+void CBitcoinRpcClient::onZmqDisconnect()
+{
+  LOG_F(WARNING, "%s %s: zmq connection lost, reconnecting", CoinInfo_.Name.c_str(), FullHostName_.c_str());
+  zmtpSocketDelete(Zmq_.Socket);
+  Zmq_.Socket = nullptr;
+  // Long polling works while zmq is unavailable
+  userEventStartTimer(Zmq_.ReconnectEvent, 5*1000000, 1);
+}
+
+void CBitcoinRpcClient::zmqFetchTemplate()
+{
+  // Only node used by dispatcher as work source sends templates
+  if (!WorkFetcher_.Active)
+    return;
+
+  if (Zmq_.FetchInProgress) {
+    Zmq_.FetchPending = true;
+    return;
+  }
+
+  Zmq_.FetchInProgress = true;
+  Zmq_.FetchPending = false;
+  socketTy S = socketCreate(AF_INET, SOCK_STREAM, IPPROTO_TCP, 1);
+  Zmq_.Client = httpClientNew(WorkFetcherBase_, newSocketIo(WorkFetcherBase_, S));
+  dynamicBufferClear(&Zmq_.ParseCtx.buffer);
+  aioHttpConnect(Zmq_.Client, &Address_, nullptr, 3000000, [](AsyncOpStatus status, HTTPClient*, void *arg){
+    static_cast<CBitcoinRpcClient*>(arg)->onZmqFetcherConnect(status);
+  }, this);
+}
+
+void CBitcoinRpcClient::onZmqFetcherConnect(AsyncOpStatus status)
+{
+  if (status != aosSuccess) {
+    onZmqFetcherIncomingData(status);
+    return;
+  }
+
+  std::string gbtQuery = buildGetBlockTemplate("", CoinInfo_.SegwitEnabled, CoinInfo_.MWebEnabled);
+  std::string query = buildPostQuery(gbtQuery.data(), gbtQuery.size(), HostName_, BasicAuth_);
+  aioHttpRequest(Zmq_.Client, query.c_str(), query.size(), 10000000, httpParseDefault, &Zmq_.ParseCtx, [](AsyncOpStatus status, HTTPClient*, void *arg){
+    static_cast<CBitcoinRpcClient*>(arg)->onZmqFetcherIncomingData(status);
+  }, this);
+}
+
+void CBitcoinRpcClient::onZmqFetcherIncomingData(AsyncOpStatus status)
+{
+  if (status == aosSuccess && Zmq_.ParseCtx.resultCode == 200) {
+    int64_t height = 0;
+    std::string prevBlockHash;
+    std::unique_ptr<CBlockTemplate> blockTemplate(parseBlockTemplate(Zmq_.ParseCtx, prevBlockHash, &height));
+    // Long poll response can deliver same block earlier
+    if (blockTemplate && WorkFetcher_.Active && blockTemplate->UniqueWorkId != WorkFetcher_.WorkId) {
+      LOG_F(INFO, "%s: new work available (zmq); previous block: %s; height: %u; difficulty: %lf", CoinInfo_.Name.c_str(), prevBlockHash.c_str(), static_cast<unsigned>(height), blockTemplate->Difficulty);
+      WorkFetcher_.LastTemplateTime = std::chrono::steady_clock::now();
+      WorkFetcher_.WorkId = blockTemplate->UniqueWorkId;
+      bool validAcc = true;
+      Zmq_.LongPollId.clear();
+      jsonParseString(blockTemplate->Document["result"], "longpollid", Zmq_.LongPollId, false, &validAcc);
+      if (!validAcc)
+        Zmq_.LongPollId.clear();
+      sendBlockTemplate(blockTemplate.release(), true);
+    }
+  } else {
+    LOG_F(WARNING, "%s %s: getblocktemplate after zmq notification failed, error code: %u (http result code: %u)", CoinInfo_.Name.c_str(), FullHostName_.c_str(), static_cast<unsigned>(status), Zmq_.ParseCtx.resultCode);
+  }
+
+  httpClientDelete(Zmq_.Client);
+  Zmq_.Client = nullptr;
+  Zmq_.FetchInProgress = false;
+  if (Zmq_.FetchPending)
+    zmqFetchTemplate();
+}
+
 
 CBitcoinRpcClient::CConnection *CBitcoinRpcClient::getConnection(asyncBase *base)
 {
@@ -980,5 +1421,44 @@ CBitcoinRpcClient::CConnection *CBitcoinRpcClient::getConnection(asyncBase *base
     return nullptr;
   }
   connection->Client = httpClientNew(base, newSocketIo(base, connection->Socket));
+  connection->Base = base;
   return connection;
 }
+
+CBitcoinRpcClient::CConnectionPtr CBitcoinRpcClient::acquireConnection(asyncBase *base)
+{
+  auto &pool = ConnectionPools_[GetGlobalThreadId()];
+  auto now = std::chrono::steady_clock::now();
+  while (!pool.empty()) {
+    std::unique_ptr<CConnection> connection(pool.back().release());
+    pool.pop_back();
+    if (connection->Base != base)
+      continue;
+    // Most recently used connection is at back, all others are older
+    if (now - connection->LastUsed >= gKeepAliveIdleTimeout) {
+      pool.clear();
+      break;
+    }
+    if (!socketIsAlive(connection->Socket))
+      continue;
+
+    connection->Reusable = false;
+    return CConnectionPtr(connection.release(), CConnectionReleaser{this});
+  }
+
+  std::unique_ptr<CConnection> connection(getConnection(base));
+  if (!connection || ioHttpConnect(connection->Client, &Address_, nullptr, 5000000) != 0)
+    return CConnectionPtr(nullptr, CConnectionReleaser{this});
+  return CConnectionPtr(connection.release(), CConnectionReleaser{this});
+}
+
+void CBitcoinRpcClient::releaseConnection(CConnection *connection)
+{
+  std::unique_ptr<CConnection> holder(connection);
+  auto &pool = ConnectionPools_[GetGlobalThreadId()];
+  if (!connection->Reusable || pool.size() >= gKeepAliveMaxIdleConnections)
+    return;
+
+  connection->LastUsed = std::chrono::steady_clock::now();
+  pool.emplace_back(holder.release());
+}
@@ -0,0 +1,214 @@
+#include "poolcore/blockTemplate.h"
+#include "loguru.hpp"
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Dataset items generated by one task, cancellation checked between tasks
+static constexpr uint32_t DatasetChunkSize = 4096;
+// Items of cached dataset compared with light cache calculation before use
+static constexpr unsigned DatasetCheckItemsNum = 16;
+
+EthashDagWrapper::~EthashDagWrapper()
+{
+  // Generator holds reference to wrapper, so it already finished here
+#ifndef _WIN32
+  if (MappedData_)
+    munmap(MappedData_, MappedSize_);
+#endif
+  if (RemoveOnRelease_) {
+    std::error_code error;
+    std::filesystem::remove(fullDatasetPath(CacheDirectory_, EpochNumber_, BigEpoch_), error);
+  }
+  free(Dag_);
+}
+
+std::filesystem::path EthashDagWrapper::fullDatasetPath(const std::filesystem::path &cacheDirectory, unsigned epochNumber, bool bigEpoch)
+{
+  std::string fileName = "full-" + std::to_string(epochNumber);
+  if (bigEpoch)
+    fileName.append("-big");
+  return cacheDirectory / fileName;
+}
+
+void EthashDagWrapper::startFullDataset(const std::filesystem::path &cacheDirectory, unsigned threadsNum)
+{
+  if (!Dag_ || !CacheDirectory_.empty())
+    return;
+  CacheDirectory_ = cacheDirectory;
+  // Thread is not joined: last reference release (possibly on event loop thread) never waits for generator
+  std::thread([](intrusive_ptr<EthashDagWrapper> self, unsigned threadsNum) {
+    self->loadFullDataset(threadsNum);
+  }, intrusive_ptr<EthashDagWrapper>(this), std::max(threadsNum, 1u)).detach();
+}
+
+void EthashDagWrapper::releaseFullDataset()
+{
+  RemoveOnRelease_ = true;
+  Cancel_ = true;
+}
+
+void EthashDagWrapper::loadFullDataset(unsigned threadsNum)
+{
+#ifndef _WIN32
+  std::error_code error;
+  std::filesystem::create_directories(CacheDirectory_, error);
+  std::filesystem::path path = fullDatasetPath(CacheDirectory_, EpochNumber_, BigEpoch_);
+  uint64_t size = ethashGetFullDatasetSize(Dag_);
+
+  if (mapFullDataset(path, size)) {
+    LOG_F(INFO, "ethash: full dataset for epoch %u loaded from %s", EpochNumber_, path.u8string().c_str());
+    return;
+  }
+
+  auto beginPt = std::chrono::steady_clock::now();
+  if (generateFullDataset(path, size, threadsNum)) {
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - beginPt).count();
+    LOG_F(INFO, "ethash: full dataset for epoch %u generated in %u seconds", EpochNumber_, static_cast<unsigned>(seconds));
+  }
+#else
+  LOG_F(WARNING, "ethash: full dataset not supported on this platform, light cache will be used");
+#endif
+}
+
+#ifndef _WIN32
+// Reads every page of mapping, dataset published with cold page cache stalls share checking on disk reads
+static bool prefaultMapping(const void *data, uint64_t size, const std::atomic<bool> &cancel)
+{
+  constexpr uint64_t CancelCheckInterval = 64 << 20;
+  uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  const volatile uint8_t *bytes = static_cast<const volatile uint8_t*>(data);
+  madvise(const_cast<void*>(data), size, MADV_WILLNEED);
+  for (uint64_t offset = 0; offset < size; offset += pageSize) {
+    if (offset % CancelCheckInterval == 0 && cancel.load(std::memory_order_relaxed))
+      return false;
+    (void)bytes[offset];
+  }
+
+  return true;
+}
+
+bool EthashDagWrapper::mapFullDataset(const std::filesystem::path &path, uint64_t size)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) != size) {
+    close(fd);
+    return false;
+  }
+
+#ifdef MAP_POPULATE
+  int flags = MAP_SHARED | MAP_POPULATE;
+#else
+  int flags = MAP_SHARED;
+#endif
+  void *data = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  if (!prefaultMapping(data, size, Cancel_)) {
+    munmap(data, size);
+    return false;
+  }
+
+  // Protection from damaged or foreign file
+  const uint32_t *dataset = static_cast<const uint32_t*>(data);
+  uint32_t itemsNum = static_cast<uint32_t>(size / 128);
+  uint32_t item[32];
+  for (unsigned i = 0; i < DatasetCheckItemsNum; i++) {
+    uint32_t index = static_cast<uint32_t>(static_cast<uint64_t>(itemsNum - 1) * i / (DatasetCheckItemsNum - 1));
+    ethashCalculateDatasetItems(item, Dag_, index, index+1);
+    if (memcmp(item, dataset + static_cast<size_t>(index)*32, sizeof(item)) != 0) {
+      LOG_F(WARNING, "ethash: full dataset file %s is damaged", path.u8string().c_str());
+      munmap(data, size);
+      return false;
+    }
+  }
+
+  MappedData_ = data;
+  MappedSize_ = size;
+  FullDataset_.store(dataset, std::memory_order_release);
+  return true;
+}
+
+bool EthashDagWrapper::generateFullDataset(const std::filesystem::path &path, uint64_t size, unsigned threadsNum)
+{
+  std::filesystem::path temporaryPath = path;
+  temporaryPath += ".tmp";
+
+  int fd = open(temporaryPath.c_str(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    LOG_F(ERROR, "ethash: can't create file %s", temporaryPath.u8string().c_str());
+    return false;
+  }
+
+  // Allocate disk space now, writing to mapped sparse file on full disk causes SIGBUS
+  int allocateResult = posix_fallocate(fd, 0, size);
+  void *data = allocateResult == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG_F(ERROR, "ethash: can't allocate %" PRIu64 " bytes for full dataset in %s", size, temporaryPath.u8string().c_str());
+    unlink(temporaryPath.c_str());
+    return false;
+  }
+
+  LOG_F(INFO, "ethash: generate full dataset for epoch %u (%" PRIu64 " bytes) using %u threads", EpochNumber_, size, threadsNum);
+  uint32_t *dataset = static_cast<uint32_t*>(data);
+  uint32_t itemsNum = static_cast<uint32_t>(size / 128);
+  std::atomic<uint32_t> nextChunk = 0;
+  auto worker = [this, dataset, itemsNum, &nextChunk]() {
+    uint32_t begin;
+    while (!Cancel_.load(std::memory_order_relaxed) && (begin = nextChunk.fetch_add(DatasetChunkSize)) < itemsNum)
+      ethashCalculateDatasetItems(dataset + static_cast<size_t>(begin)*32, Dag_, begin, std::min(begin + DatasetChunkSize, itemsNum));
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threadsNum; i++)
+    workers.emplace_back(worker);
+  worker();
+  for (auto &thread: workers)
+    thread.join();
+
+  if (Cancel_) {
+    munmap(data, size);
+    unlink(temporaryPath.c_str());
+    return false;
+  }
+
+  // Cached file appears only after complete generation
+  msync(data, size, MS_SYNC);
+  if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+    LOG_F(WARNING, "ethash: can't rename %s, dataset will not be cached", temporaryPath.u8string().c_str());
+
+  MappedData_ = data;
+  MappedSize_ = size;
+  FullDataset_.store(dataset, std::memory_order_release);
+  return true;
+}
+#else
+bool EthashDagWrapper::mapFullDataset(const std::filesystem::path&, uint64_t)
+{
+  return false;
+}
+
+bool EthashDagWrapper::generateFullDataset(const std::filesystem::path&, uint64_t, unsigned)
+{
+  return false;
+}
+#endif
@@ -73,6 +73,21 @@ CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioBuildTransaction(as
   return status;
 }
 
+CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioBuildTransactionBatch(asyncBase *base, const std::vector<CNetworkClient::BuildTransactionOutput> &outputs, const std::string &changeAddress, CNetworkClient::BuildBatchTransactionResult &result)
+{
+  CNetworkClient::EOperationStatus status = CNetworkClient::EStatusUnknownError;
+  unsigned threadId = GetGlobalThreadId();
+  size_t &currentClientIdx = CurrentClientIdx_[threadId];
+  for (size_t i = 0, ie = RPCClients_.size(); i != ie; ++i) {
+    status = RPCClients_[currentClientIdx]->ioBuildTransactionBatch(base, outputs, changeAddress, result);
+    if (status == CNetworkClient::EStatusOk)
+      return CNetworkClient::EStatusOk;
+    currentClientIdx = (currentClientIdx + 1) % RPCClients_.size();
+  }
+
+  return status;
+}
+
 CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioSendTransaction(asyncBase *base, const std::string &txData, const std::string &txId, std::string &error)
 {
   CNetworkClient::EOperationStatus status = CNetworkClient::EStatusUnknownError;
@@ -118,6 +133,48 @@ CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioGetTxConfirmations(
   return status;
 }
 
+CNetworkClient::EOperationStatus CNetworkClientDispatcher::ioGetTxConfirmationsBatch(asyncBase *base, std::vector<CNetworkClient::GetTxConfirmationsQuery> &query)
+{
+  // Transactions not resolved by one node (unknown tx, error) are checked by remaining nodes, like ioGetTxConfirmations does
+  CNetworkClient::EOperationStatus status = CNetworkClient::EStatusUnknownError;
+  unsigned threadId = GetGlobalThreadId();
+  size_t &currentClientIdx = CurrentClientIdx_[threadId];
+  bool hasResponse = false;
+  std::vector<size_t> unresolved(query.size());
+  for (size_t i = 0, ie = query.size(); i != ie; ++i)
+    unresolved[i] = i;
+
+  size_t clientIdx = currentClientIdx;
+  for (size_t i = 0, ie = RPCClients_.size(); i != ie; ++i) {
+    std::vector<CNetworkClient::GetTxConfirmationsQuery> subQuery;
+    subQuery.reserve(unresolved.size());
+    for (size_t index: unresolved)
+      subQuery.emplace_back(query[index].TxId);
+
+    status = RPCClients_[clientIdx]->ioGetTxConfirmationsBatch(base, subQuery);
+    if (status == CNetworkClient::EStatusOk) {
+      hasResponse = true;
+      std::vector<size_t> next;
+      for (size_t j = 0, je = subQuery.size(); j != je; ++j) {
+        query[unresolved[j]] = std::move(subQuery[j]);
+        if (query[unresolved[j]].Status != CNetworkClient::EStatusOk)
+          next.push_back(unresolved[j]);
+      }
+
+      unresolved.swap(next);
+      if (unresolved.empty())
+        return CNetworkClient::EStatusOk;
+    } else if (!hasResponse) {
+      // Switch current node only if it is unavailable
+      currentClientIdx = (currentClientIdx + 1) % RPCClients_.size();
+    }
+
+    clientIdx = (clientIdx + 1) % RPCClients_.size();
+  }
+
+  return hasResponse ? CNetworkClient::EStatusOk : status;
+}
+
 void CNetworkClientDispatcher::aioSubmitBlock(asyncBase *base, const void *data, size_t size, CNetworkClient::SumbitBlockCb callback)
 {
   CNetworkClient::CSubmitBlockOperation *submitOperation = new CNetworkClient::CSubmitBlockOperation(callback, GetWorkClients_.size());
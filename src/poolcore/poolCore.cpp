@@ -101,6 +101,36 @@ uint64_t CCoinInfo::calculateAveragePower(double work, uint64_t timeInterval, un
 }
 
 
+CNetworkClient::EOperationStatus CNetworkClient::ioBuildTransactionBatch(asyncBase *base, const std::vector<BuildTransactionOutput> &outputs, const std::string &changeAddress, BuildBatchTransactionResult &result)
+{
+  if (outputs.size() != 1)
+    return EStatusMethodNotFound;
+
+  BuildTransactionResult transaction;
+  EOperationStatus status = ioBuildTransaction(base, outputs[0].Address, changeAddress, outputs[0].Value, transaction);
+  result.TxId = std::move(transaction.TxId);
+  result.TxData = std::move(transaction.TxData);
+  result.Error = std::move(transaction.Error);
+  if (status == EStatusOk) {
+    result.Values.assign(1, transaction.Value);
+    result.Fees.assign(1, transaction.Fee);
+    result.Fee = transaction.Fee;
+  }
+
+  return status;
+}
+
+CNetworkClient::EOperationStatus CNetworkClient::ioGetTxConfirmationsBatch(asyncBase *base, std::vector<GetTxConfirmationsQuery> &query)
+{
+  for (auto &tx: query) {
+    tx.Status = ioGetTxConfirmations(base, tx.TxId, &tx.Confirmations, &tx.TxFee, tx.Error);
+    if (tx.Status == EStatusNetworkError || tx.Status == EStatusTimeout)
+      return tx.Status;
+  }
+
+  return EStatusOk;
+}
+
 void CNetworkClient::CSubmitBlockOperation::accept(bool result, const std::string &hostName, const std::string &error)
 {
   uint32_t st = 1u + ((result ? 1u : 0) << 16);
@@ -0,0 +1,186 @@
+#include "poolcore/pplnsWindow.h"
+#include "poolcore/sharePool.h"
+#include <algorithm>
+
+uint32_t CPPLNSWindow::userSlot(const std::string &userId)
+{
+  auto It = UserMap_.find(userId);
+  if (It != UserMap_.end())
+    return It->second;
+
+  uint32_t slot;
+  if (!FreeSlots_.empty()) {
+    slot = FreeSlots_.back();
+    FreeSlots_.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(Users_.size());
+    Users_.emplace_back();
+  }
+
+  CUserScore &user = Users_[slot];
+  user.UserId = userId;
+  user.Slot = slot;
+  user.Used = true;
+  UserMap_.emplace(userId, slot);
+  return slot;
+}
+
+void CPPLNSWindow::releaseSlot(uint32_t slot)
+{
+  CUserScore &user = Users_[slot];
+  UserMap_.erase(user.UserId);
+  user = CUserScore();
+  FreeSlots_.push_back(slot);
+  UsersCache_.clear();
+}
+
+void CPPLNSWindow::addWork(CUserScore &user, double work, int64_t time, bool previousRound)
+{
+  if (Buckets_.empty() || Buckets_.back().PreviousRound != previousRound || time >= Buckets_.back().BeginTime + BucketSize_) {
+    CBucket &bucket = Buckets_.emplace_back();
+    bucket.Seq = NextBucketSeq_++;
+    bucket.BeginTime = time;
+    bucket.TimeLabel = time;
+    bucket.PreviousRound = previousRound;
+  }
+
+  CBucket &bucket = Buckets_.back();
+  if (!user.BucketsNum || user.LastBucketSeq != bucket.Seq) {
+    user.BucketsNum++;
+    user.LastBucketSeq = bucket.Seq;
+    user.LastBucketEntry = static_cast<uint32_t>(bucket.Work.size());
+    bucket.Work.emplace_back(user.Slot, 0.0);
+  }
+
+  bucket.Work[user.LastBucketEntry].second += work;
+  bucket.TimeLabel = std::max(bucket.TimeLabel, time);
+  if (previousRound) {
+    user.PreviousRounds += work;
+  } else {
+    user.Round += work;
+    user.RoundInWindow += work;
+    RoundWork_ += work;
+  }
+}
+
+void CPPLNSWindow::expire(int64_t time)
+{
+  int64_t acceptSharesTime = time - WindowSize_;
+  while (!Buckets_.empty() && Buckets_.front().TimeLabel <= acceptSharesTime) {
+    const CBucket &bucket = Buckets_.front();
+    for (const auto &entry: bucket.Work) {
+      CUserScore &user = Users_[entry.first];
+      if (bucket.PreviousRound)
+        user.PreviousRounds -= entry.second;
+      else
+        user.RoundInWindow -= entry.second;
+
+      if (--user.BucketsNum == 0) {
+        // Reset accumulated rounding error
+        user.PreviousRounds = 0.0;
+        user.RoundInWindow = 0.0;
+        if (user.Round == 0.0)
+          releaseSlot(entry.first);
+      }
+    }
+
+    Buckets_.pop_front();
+  }
+}
+
+void CPPLNSWindow::addShare(const CShare &share)
+{
+  expire(share.Time);
+  CUserScore &user = lookupByIndex(UsersCache_, share.UserIndex, [this, &share]() -> CUserScore& {
+    return Users_[userSlot(share.userId)];
+  });
+  addWork(user, share.WorkValue, share.Time, false);
+}
+
+void CPPLNSWindow::closeRound(int64_t time, std::vector<UserShareValue> &scores)
+{
+  expire(time);
+  for (auto &user: Users_) {
+    if (!user.Used)
+      continue;
+
+    double shareValue = user.Round + user.PreviousRounds;
+    if (shareValue != 0.0)
+      scores.emplace_back(user.UserId, shareValue);
+
+    // Current round shares still in window become previous round shares
+    user.PreviousRounds += user.RoundInWindow;
+    user.RoundInWindow = 0.0;
+    user.Round = 0.0;
+    if (!user.BucketsNum)
+      releaseSlot(user.Slot);
+  }
+
+  for (auto It = Buckets_.rbegin(), ItE = Buckets_.rend(); It != ItE && !It->PreviousRound; ++It)
+    It->PreviousRound = true;
+  RoundWork_ = 0.0;
+}
+
+void CPPLNSWindow::clear()
+{
+  Users_.clear();
+  UserMap_.clear();
+  FreeSlots_.clear();
+  UsersCache_.clear();
+  Buckets_.clear();
+  RoundWork_ = 0.0;
+}
+
+void CPPLNSWindow::exportRound(std::map<std::string, double> &scores) const
+{
+  scores.clear();
+  for (const auto &user: Users_) {
+    if (user.Used && user.Round != 0.0)
+      scores[user.UserId] = user.Round;
+  }
+}
+
+void CPPLNSWindow::exportRecent(std::vector<StatisticDb::CStatsExportData> &recent) const
+{
+  recent.clear();
+  std::vector<uint32_t> index(Users_.size(), UINT32_MAX);
+  for (auto It = Buckets_.rbegin(), ItE = Buckets_.rend(); It != ItE; ++It) {
+    if (!It->PreviousRound)
+      continue;
+    for (const auto &entry: It->Work) {
+      if (index[entry.first] == UINT32_MAX) {
+        index[entry.first] = static_cast<uint32_t>(recent.size());
+        recent.emplace_back().UserId = Users_[entry.first].UserId;
+      }
+
+      auto &element = recent[index[entry.first]].Recent.emplace_back();
+      element.TimeLabel = It->TimeLabel;
+      element.SharesWork = entry.second;
+    }
+  }
+}
+
+void CPPLNSWindow::load(const std::vector<StatisticDb::CStatsExportData> &recent, const std::map<std::string, double> &round, int64_t timeLabel)
+{
+  clear();
+
+  struct CRecentElement {
+    int64_t TimeLabel;
+    uint32_t Slot;
+    double SharesWork;
+  };
+
+  std::vector<CRecentElement> elements;
+  for (const auto &user: recent) {
+    uint32_t slot = userSlot(user.UserId);
+    for (const auto &element: user.Recent)
+      elements.push_back({element.TimeLabel, slot, element.SharesWork});
+  }
+
+  std::sort(elements.begin(), elements.end(), [](const CRecentElement &l, const CRecentElement &r) { return l.TimeLabel < r.TimeLabel; });
+  for (const auto &element: elements)
+    addWork(Users_[element.Slot], element.SharesWork, element.TimeLabel, true);
+
+  for (const auto &score: round)
+    addWork(Users_[userSlot(score.first)], score.second, timeLabel, false);
+}
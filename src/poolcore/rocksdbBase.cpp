@@ -331,14 +331,13 @@ rocksdbBase::PartitionBatchType rocksdbBase::batch(const std::string &partitionI
   return batch;
 }
 
-bool rocksdbBase::writeBatch(PartitionBatchType &batch)
+bool rocksdbBase::writeBatch(PartitionBatchType &batch, bool sync)
 {
-  auto partition = getPartition(batch.PartitionId);
+  auto partition = getOrCreatePartition(batch.PartitionId);
   if (partition) {
     rocksdb::WriteOptions options;
-    options.sync = true;
-    partition->Write(options, &batch.Batch);
-    return true;
+    options.sync = sync;
+    return partition->Write(options, &batch.Batch).ok();
   } else {
     return false;
   }
@@ -24,3 +24,33 @@ void ShareLogIo<CShare>::unserialize(xmstream &out, CShare &data)
   DbIo<uint32_t>::unserialize(out, data.ChainLength);
   DbIo<uint32_t>::unserialize(out, data.PrimePOWTarget);
 }
+
+void ShareLogIo<CShareLogIndex>::serialize(xmstream &out, const CShareLogIndex &data)
+{
+  out.writele<uint32_t>(data.CurrentRecordVersion);
+  out.writele<uint64_t>(data.FirstId);
+  out.writele<uint64_t>(data.LastId);
+  out.writele<uint32_t>(static_cast<uint32_t>(data.Checkpoints.size()));
+  for (const auto &checkpoint: data.Checkpoints) {
+    out.writele<uint64_t>(checkpoint.ShareId);
+    out.writele<uint64_t>(checkpoint.Offset);
+  }
+}
+
+void ShareLogIo<CShareLogIndex>::unserialize(xmstream &in, CShareLogIndex &data)
+{
+  uint32_t version = in.readle<uint32_t>();
+  data.FirstId = in.readle<uint64_t>();
+  data.LastId = in.readle<uint64_t>();
+  uint32_t checkpointsNum = in.readle<uint32_t>();
+  if (version != data.CurrentRecordVersion || checkpointsNum > in.remaining() / (2*sizeof(uint64_t))) {
+    in.seekEnd(0, true);
+    return;
+  }
+
+  data.Checkpoints.resize(checkpointsNum);
+  for (auto &checkpoint: data.Checkpoints) {
+    checkpoint.ShareId = in.readle<uint64_t>();
+    checkpoint.Offset = in.readle<uint64_t>();
+  }
+}
@@ -0,0 +1,117 @@
+#include "poolcore/sharePool.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+// Shares moved between threads by batches of this size
+static constexpr size_t BatchSize = 256;
+// Maximum number of batches in global free list, excess shares will be destroyed
+static constexpr size_t MaxGlobalBatches = 256;
+
+struct CFreeList {
+  std::vector<CShare*> Shares;
+  ~CFreeList() {
+    for (CShare *share: Shares)
+      delete share;
+  }
+};
+
+struct CGlobalFreeList {
+  std::mutex Mutex;
+  std::vector<std::vector<CShare*>> Batches;
+  ~CGlobalFreeList() {
+    for (const auto &batch: Batches) {
+      for (CShare *share: batch)
+        delete share;
+    }
+  }
+};
+
+CGlobalFreeList &globalFreeList()
+{
+  static CGlobalFreeList list;
+  return list;
+}
+
+thread_local CFreeList LocalFreeList;
+}
+
+CShare *CSharePool::alloc()
+{
+  std::vector<CShare*> &local = LocalFreeList.Shares;
+  if (local.empty()) {
+    CGlobalFreeList &global = globalFreeList();
+    std::lock_guard<std::mutex> lock(global.Mutex);
+    if (!global.Batches.empty()) {
+      local.swap(global.Batches.back());
+      global.Batches.pop_back();
+    }
+  }
+
+  if (local.empty()) {
+    CShare *share = new CShare;
+    share->reset();
+    return share;
+  }
+
+  CShare *share = local.back();
+  local.pop_back();
+  return share;
+}
+
+void CSharePool::release(CShare *share)
+{
+  if (!share)
+    return;
+
+  share->reset();
+  std::vector<CShare*> &local = LocalFreeList.Shares;
+  local.push_back(share);
+  if (local.size() < 2*BatchSize)
+    return;
+
+  // Keep one batch for local allocations, move other to global list
+  std::vector<CShare*> batch(local.end() - BatchSize, local.end());
+  local.resize(local.size() - BatchSize);
+
+  CGlobalFreeList &global = globalFreeList();
+  {
+    std::lock_guard<std::mutex> lock(global.Mutex);
+    if (global.Batches.size() < MaxGlobalBatches) {
+      global.Batches.emplace_back(std::move(batch));
+      return;
+    }
+  }
+
+  for (CShare *share: batch)
+    delete share;
+}
+
+CUserWorkerTable::CIdentity CUserWorkerTable::intern(const std::string &user, const std::string &worker)
+{
+  static std::mutex mutex;
+  static std::unordered_map<std::string, uint32_t> users;
+  static std::unordered_map<std::string, uint32_t> workers;
+
+  // User name can't contain '.', so it's unique key
+  std::string workerKey = user;
+  workerKey.push_back('.');
+  workerKey.append(worker);
+
+  CIdentity identity;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto userIt = users.find(user);
+  if (userIt != users.end())
+    identity.User = userIt->second;
+  else if (users.size() < MaxSize)
+    identity.User = users.emplace(user, static_cast<uint32_t>(users.size())).first->second;
+
+  auto workerIt = workers.find(workerKey);
+  if (workerIt != workers.end())
+    identity.Worker = workerIt->second;
+  else if (workers.size() < MaxSize)
+    identity.Worker = workers.emplace(std::move(workerKey), static_cast<uint32_t>(workers.size())).first->second;
+
+  return identity;
+}
@@ -5,6 +5,7 @@
 #include "poolcommon/serialize.h"
 #include "loguru.hpp"
 #include <algorithm>
+#include <tuple>
 
 bool StatisticDb::parseStatsCacheFile(CStatsFile &file)
 {
@@ -127,10 +128,40 @@ StatisticDb::StatisticDb(asyncBase *base, const PoolBackendConfig &config, const
   }
 
   LastKnownShareId_ = std::max(WorkersFlushInfo_.ShareId, PoolFlushInfo_.ShareId);
+  WorkersUpdateTime_ = WorkersFlushInfo_.Time;
+  PoolUpdateTime_ = PoolFlushInfo_.Time;
+  initRollups(WorkerRollups_, "workerStats");
+  initRollups(PoolRollups_, "poolstats");
   if (isDebugStatistic())
     LOG_F(1, "%s: last aggregated id: %" PRIu64 " last known id: %" PRIu64 "", coinInfo.Name.c_str(), lastAggregatedShareId(), lastKnownShareId());
 }
 
+void StatisticDb::initRollups(std::deque<CRollupTier> &tiers, const char *name)
+{
+  std::error_code errc;
+  std::filesystem::create_directories(_cfg.dbPath / "stats.rollups", errc);
+  for (const auto &tierCfg: _cfg.StatisticRollupTiers) {
+    int64_t interval = std::chrono::seconds(tierCfg.Interval).count();
+    if (interval <= 0 || (!tiers.empty() && interval % tiers.back().Interval != 0)) {
+      LOG_F(ERROR, "StatisticDb: rollup interval %" PRIi64 " is not a multiple of previous one, ignoring it and coarser intervals", interval);
+      break;
+    }
+
+    std::string tierName = std::string(name) + "." + std::to_string(interval);
+    CRollupTier &tier = tiers.emplace_back();
+    tier.Interval = interval;
+    tier.KeepTime = std::chrono::seconds(tierCfg.KeepTime).count();
+    tier.StatePath = _cfg.dbPath / "stats.rollups" / (tierName + ".dat");
+    tier.Db.reset(new kvdb<rocksdbBase>(_cfg.dbPath / tierName));
+
+    FileDescriptor fd;
+    int64_t startTime = 0;
+    if (fd.open(tier.StatePath) && fd.size() == sizeof(startTime) && fd.read(&startTime, 0, sizeof(startTime)) == sizeof(startTime))
+      tier.StartTime = xletoh(startTime);
+    fd.close();
+  }
+}
+
 void StatisticDb::enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::filesystem::path &directory, bool isOldFormat)
 {
   std::error_code errc;
@@ -154,7 +185,7 @@ void StatisticDb::enumerateStatsFiles(std::deque<CStatsFile> &cache, const std::
   std::sort(cache.begin(), cache.end(), [](const CStatsFile &l, const CStatsFile &r){ return l.TimeLabel < r.TimeLabel; });
 }
 
-void StatisticDb::updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData)
+void StatisticDb::updateAcc(const std::string &login, const std::string &workerId, StatisticDb::CStatsAccumulator &acc, time_t currentTime, xmstream &statsFileData, kvdb<rocksdbBase>::MultiPartitionBatch &batch)
 {
   // Push current accumulated data to ring buffer
   if ((currentTime - acc.LastShareTime) < std::chrono::seconds(_cfg.StatisticKeepWorkerNamesTime).count()) {
@@ -168,7 +199,7 @@ void StatisticDb::updateAcc(const std::string &login, const std::string &workerI
     // Update on-disk data
     // Update [user,worker,time] -> state database
     if (acc.Current.SharesNum)
-      writeStatsToDb(login, workerId, acc.Current);
+      writeStatsToDb(batch, login, workerId, acc.Current);
     writeStatsToCache(login, workerId, acc.Current, acc.LastShareTime, statsFileData);
   }
 
@@ -213,7 +244,7 @@ void StatisticDb::calcAverageMetrics(const StatisticDb::CStatsAccumulator &acc,
   result.LastShareTime = acc.LastShareTime;
 }
 
-void StatisticDb::writeStatsToDb(const std::string &loginId, const std::string &workerId, const CStatsElement &element)
+void StatisticDb::writeStatsToDb(kvdb<rocksdbBase>::MultiPartitionBatch &batch, const std::string &loginId, const std::string &workerId, const CStatsElement &element)
 {
   StatsRecord record;
   record.Login = loginId;
@@ -224,10 +255,7 @@ void StatisticDb::writeStatsToDb(const std::string &loginId, const std::string &
   record.ShareWork = element.SharesWork;
   record.PrimePOWTarget = element.PrimePOWTarget;
   record.PrimePOWShareCount.assign(element.PrimePOWSharesNum.begin(), element.PrimePOWSharesNum.end());
-  if (!loginId.empty())
-    WorkerStatsDb_.put(record);
-  else
-    PoolStatsDb_.put(record);
+  batch.put(record);
 }
 
 void StatisticDb::writeStatsToCache(const std::string &loginId, const std::string &workerId, const CStatsElement &element, int64_t lastShareTime, xmstream &statsFileData)
@@ -251,17 +279,27 @@ void StatisticDb::addShare(const CShare &share, bool updateWorkerAndUserStats, b
 
   if (updateWorkerAndUserStats) {
     // Update worker stats
-    LastWorkerStats_[share.userId][share.workerId].addShare(share.WorkValue,
-                                                            share.Time,
-                                                            share.ChainLength,
-                                                            share.PrimePOWTarget,
-                                                            CoinInfo_.PowerUnitType == CCoinInfo::ECPD);
+    CStatsAccumulator &workerAcc = lookupByIndex(WorkerStatsCache_, share.WorkerIndex, [this, &share]() -> CStatsAccumulator& {
+      return LastWorkerStats_[share.userId][share.workerId];
+    });
+    workerAcc.addShare(share.WorkValue,
+                       share.Time,
+                       share.ChainLength,
+                       share.PrimePOWTarget,
+                       CoinInfo_.PowerUnitType == CCoinInfo::ECPD);
     // Update user stats
-    LastUserStats_[share.userId].addShare(share.WorkValue,
-                                          share.Time,
-                                          share.ChainLength,
-                                          share.PrimePOWTarget,
-                                          CoinInfo_.PowerUnitType == CCoinInfo::ECPD);
+    CStatsAccumulator &userAcc = lookupByIndex(UserStatsCache_, share.UserIndex, [this, &share]() -> CStatsAccumulator& {
+      return LastUserStats_[share.userId];
+    });
+    userAcc.addShare(share.WorkValue,
+                     share.Time,
+                     share.ChainLength,
+                     share.PrimePOWTarget,
+                     CoinInfo_.PowerUnitType == CCoinInfo::ECPD);
+    if (!userAcc.IndexChanged) {
+      userAcc.IndexChanged = true;
+      UserStatsIndex_.Changed.push_back(share.userId);
+    }
   }
   if (updatePoolStats) {
     // Update pool stats
@@ -291,6 +329,24 @@ void StatisticDb::replayShare(const CShare &share)
 
 void StatisticDb::initializationFinish(int64_t timeLabel)
 {
+  // Windows opened before restart, statistic cache contains all workers with shares in last StatisticKeepWorkerNamesTime
+  for (auto &tier: WorkerRollups_) {
+    for (const auto &userIt: LastWorkerStats_) {
+      for (const auto &workerIt: userIt.second)
+        tier.Keys.emplace(userIt.first, workerIt.first);
+    }
+    for (const auto &userIt: LastUserStats_)
+      tier.Keys.emplace(userIt.first, "");
+  }
+
+  // Users loaded from statistic cache
+  for (auto &userIt: LastUserStats_) {
+    if (!userIt.second.IndexChanged) {
+      userIt.second.IndexChanged = true;
+      UserStatsIndex_.Changed.push_back(userIt.first);
+    }
+  }
+
   if (isDebugStatistic()) {
     LOG_F(1, "initializationFinish: timeLabel: %" PRIu64 "", timeLabel);
     LOG_F(1, " * workers interval: %" PRIi64 " diff: %" PRIi64"",
@@ -309,6 +365,8 @@ void StatisticDb::initializationFinish(int64_t timeLabel)
   if (isDebugStatistic()) {
     LOG_F(1, "%s: replayed %" PRIu64 " shares from %" PRIu64 " to %" PRIu64 "", CoinInfo_.Name.c_str(), Dbg_.Count, Dbg_.MinShareId, Dbg_.MaxShareId);
   }
+
+  updateUserStatsIndex(false);
 }
 
 void StatisticDb::start()
@@ -349,31 +407,103 @@ void StatisticDb::stop()
 void StatisticDb::updateWorkersStats(int64_t timeLabel)
 {
   xmstream statsFileData;
+  kvdb<rocksdbBase>::MultiPartitionBatch batch(WorkerStatsDb_);
   std::vector<std::string> userDeleteList;
+  // Records written now belong to rollup window beginning at or before timeLabel
+  std::set<std::pair<std::string, std::string>> rollupKeys;
+  bool hasDeletedWorkers = false;
   for (auto &userIt: LastWorkerStats_) {
     std::vector<std::string> workerDeleteList;
     for (auto &workerIt: userIt.second) {
       CStatsAccumulator &acc = workerIt.second;
-      updateAcc(userIt.first, workerIt.first, acc, timeLabel, statsFileData);
+      if (acc.Current.SharesNum && !WorkerRollups_.empty())
+        rollupKeys.emplace(userIt.first, workerIt.first);
+      updateAcc(userIt.first, workerIt.first, acc, timeLabel, statsFileData, batch);
       if (acc.Recent.empty())
         workerDeleteList.push_back(workerIt.first);
     }
 
     // Cleanup workers table
     std::for_each(workerDeleteList.begin(), workerDeleteList.end(), [&userIt](const std::string &name) { userIt.second.erase(name);});
+    hasDeletedWorkers |= !workerDeleteList.empty();
   }
 
   for (auto &userIt: LastUserStats_) {
     CStatsAccumulator &acc = userIt.second;
-    updateAcc(userIt.first, "", acc, timeLabel, statsFileData);
+    if (acc.Current.SharesNum && !WorkerRollups_.empty())
+      rollupKeys.emplace(userIt.first, "");
+    updateAcc(userIt.first, "", acc, timeLabel, statsFileData, batch);
     if (acc.Recent.empty())
       userDeleteList.push_back(userIt.first);
   }
 
+  if (!batch.write(_cfg.StatisticSyncWrites))
+    LOG_F(ERROR, "%s: can't write workers statistic to database", CoinInfo_.Name.c_str());
   updateWorkersStatsDiskCache(timeLabel, LastKnownShareId_, statsFileData.data(), statsFileData.sizeOf());
+  updateRollups(WorkerStatsDb_, WorkerRollups_, WorkersUpdateTime_, timeLabel, false);
+  WorkersUpdateTime_ = timeLabel;
+  if (!WorkerRollups_.empty())
+    WorkerRollups_.front().Keys.insert(rollupKeys.begin(), rollupKeys.end());
 
   // Cleanup users table
   std::for_each(userDeleteList.begin(), userDeleteList.end(), [this](const std::string &name) { LastWorkerStats_.erase(name);});
+  if (hasDeletedWorkers || !userDeleteList.empty())
+    WorkerStatsCache_.clear();
+
+  updateUserStatsIndex(true);
+}
+
+void StatisticDb::updateUserStatsIndex(bool recalculateActive)
+{
+  CUserStatsIndex &index = UserStatsIndex_;
+  std::vector<std::string> logins;
+  logins.swap(index.Changed);
+  if (recalculateActive) {
+    for (const auto &login: index.Active) {
+      auto It = LastUserStats_.find(login);
+      if (It == LastUserStats_.end() || !It->second.IndexChanged)
+        logins.push_back(login);
+    }
+  }
+
+  for (const auto &login: logins) {
+    auto accIt = LastUserStats_.find(login);
+    auto It = index.Users.find(login);
+    if (It != index.Users.end()) {
+      const CUserStatsValue &value = It->second;
+      index.WorkersNum.erase({value.WorkersNum, login});
+      index.AveragePower.erase({value.AveragePower, login});
+      index.SharesPerSecond.erase({value.SharesPerSecond, login});
+      index.LastShareTime.erase({value.LastShareTime, login});
+    }
+
+    if (accIt == LastUserStats_.end()) {
+      if (It != index.Users.end())
+        index.Users.erase(It);
+      index.Active.erase(login);
+      continue;
+    }
+
+    CStats userStats;
+    accIt->second.IndexChanged = false;
+    calcAverageMetrics(accIt->second, _cfg.StatisticWorkersPowerCalculateInterval, _cfg.StatisticWorkersAggregateTime, userStats);
+    if (It == index.Users.end())
+      It = index.Users.emplace(login, CUserStatsValue()).first;
+
+    CUserStatsValue &value = It->second;
+    value.WorkersNum = userStats.WorkersNum;
+    value.AveragePower = userStats.AveragePower;
+    value.SharesPerSecond = userStats.SharesPerSecond;
+    value.LastShareTime = userStats.LastShareTime;
+    index.WorkersNum.emplace(value.WorkersNum, login);
+    index.AveragePower.emplace(value.AveragePower, login);
+    index.SharesPerSecond.emplace(value.SharesPerSecond, login);
+    index.LastShareTime.emplace(value.LastShareTime, login);
+    if (value.SharesPerSecond != 0.0)
+      index.Active.insert(login);
+    else
+      index.Active.erase(login);
+  }
 }
 
 void StatisticDb::updatePoolStats(int64_t timeLabel)
@@ -401,8 +531,13 @@ void StatisticDb::updatePoolStats(int64_t timeLabel)
   calcAverageMetrics(PoolStatsAcc_, _cfg.StatisticPoolPowerCalculateInterval, _cfg.StatisticPoolAggregateTime, PoolStatsCached_);
 
   xmstream statsFileData;
-  updateAcc("", "", PoolStatsAcc_, timeLabel, statsFileData);
+  kvdb<rocksdbBase>::MultiPartitionBatch batch(PoolStatsDb_);
+  updateAcc("", "", PoolStatsAcc_, timeLabel, statsFileData, batch);
+  if (!batch.write(_cfg.StatisticSyncWrites))
+    LOG_F(ERROR, "%s: can't write pool statistic to database", CoinInfo_.Name.c_str());
   updatePoolStatsDiskCache(timeLabel, LastKnownShareId_, statsFileData.data(), statsFileData.sizeOf());
+  updateRollups(PoolStatsDb_, PoolRollups_, PoolUpdateTime_, timeLabel, true);
+  PoolUpdateTime_ = timeLabel;
 
   LOG_F(INFO,
         "clients: %u, workers: %u, power: %" PRIu64 ", share rate: %.3lf shares/s",
@@ -519,14 +654,115 @@ void StatisticDb::getUserStats(const std::string &user, CStats &userStats, std::
   }
 }
 
-void StatisticDb::getHistory(const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, std::vector<CStats> &history)
+void StatisticDb::updateRollups(kvdb<rocksdbBase> &db, std::deque<CRollupTier> &tiers, int64_t previousTime, int64_t currentTime, bool isPoolStats)
 {
-  if (groupByInterval < 60)
+  if (!previousTime)
+    return;
+
+  // Each tier built from previous one, first tier from raw records
+  kvdb<rocksdbBase> *source = &db;
+  bool isRawSource = true;
+  int64_t sourceStartTime = 0;
+  for (size_t tierIdx = 0, tiersNum = tiers.size(); tierIdx != tiersNum; ++tierIdx) {
+    CRollupTier &tier = tiers[tierIdx];
+    CRollupTier *nextTier = tierIdx + 1 != tiersNum ? &tiers[tierIdx + 1] : nullptr;
+    // Only window with last records can be closed, there are no records between updates
+    int64_t windowBegin = previousTime - previousTime % tier.Interval;
+    if (currentTime - currentTime % tier.Interval == windowBegin)
+      break;
+
+    std::set<std::pair<std::string, std::string>> keys;
+    keys.swap(tier.Keys);
+    if (isRawSource || (sourceStartTime != 0 && windowBegin >= sourceStartTime)) {
+      kvdb<rocksdbBase>::MultiPartitionBatch batch(*tier.Db);
+      std::vector<CStatsElement> stats(1);
+      auto rollup = [&](const std::string &login, const std::string &workerId) {
+        stats[0].reset();
+        stats[0].TimeLabel = windowBegin;
+        accumulateHistory(*source, login, workerId, windowBegin - 1, windowBegin + tier.Interval - 1, tier.Interval, windowBegin + tier.Interval, stats);
+        if (stats[0].SharesNum) {
+          writeStatsToDb(batch, login, workerId, stats[0]);
+          if (nextTier && !isPoolStats)
+            nextTier->Keys.emplace(login, workerId);
+        }
+      };
+
+      if (isPoolStats) {
+        rollup("", "");
+      } else {
+        for (const auto &key: keys)
+          rollup(key.first, key.second);
+      }
+
+      if (!batch.write(_cfg.StatisticSyncWrites))
+        LOG_F(ERROR, "%s: can't write statistic rollup %" PRIi64 " to database", CoinInfo_.Name.c_str(), tier.Interval);
+
+      if (tier.StartTime == 0) {
+        tier.StartTime = windowBegin;
+        FileDescriptor fd;
+        int64_t startTime = xhtole(windowBegin);
+        if (fd.open(tier.StatePath)) {
+          fd.write(&startTime, 0, sizeof(startTime));
+          fd.truncate(sizeof(startTime));
+          fd.close();
+        } else {
+          LOG_F(ERROR, "StatisticDb: can't write file %s", tier.StatePath.u8string().c_str());
+        }
+      }
+
+      cleanupRollup(tier, currentTime);
+    }
+
+    source = tier.Db.get();
+    isRawSource = false;
+    sourceStartTime = tier.StartTime;
+  }
+}
+
+void StatisticDb::cleanupRollup(CRollupTier &tier, int64_t currentTime)
+{
+  if (!tier.KeepTime)
+    return;
+
+  // Retention has partition granularity: all records of partitions before expiration time partition removed
+  // Number of removed rows limited per window, rest of them will be removed with next windows
+  constexpr size_t RollupCleanupRowsLimit = 100000;
+  std::string expiredPartition = partByTime(currentTime - tier.KeepTime);
+  kvdb<rocksdbBase>::MultiPartitionBatch batch(*tier.Db);
+  size_t rowsNum = 0;
+
+  std::unique_ptr<rocksdbBase::IteratorType> It(tier.Db->iterator());
+  {
+    StatsRecord first;
+    first.Time = 0;
+    It->seek(first);
+  }
+
+  for (; It->valid() && It->id < expiredPartition && rowsNum < RollupCleanupRowsLimit; It->next(), rowsNum++) {
+    StatsRecord record;
+    RawData data = It->value();
+    if (record.deserializeValue(data.data, data.size))
+      batch.deleteRow(record);
+  }
+
+  if (rowsNum) {
+    LOG_F(INFO, "%s: removing %zu expired statistic rollup %" PRIi64 " records", CoinInfo_.Name.c_str(), rowsNum, tier.Interval);
+    batch.write(_cfg.StatisticSyncWrites);
+  }
+}
+
+void StatisticDb::accumulateHistory(kvdb<rocksdbBase> &db,
+                                    const std::string &login,
+                                    const std::string &workerId,
+                                    int64_t timeFrom,
+                                    int64_t timeTo,
+                                    int64_t groupByInterval,
+                                    int64_t firstTimeLabel,
+                                    std::vector<CStatsElement> &stats)
+{
+  if (timeTo <= timeFrom)
     return;
 
-  if (isDebugStatistic())
-    LOG_F(1, "getHistory for %s/%s from %" PRIi64 " to % " PRIi64 " group interval %" PRIi64 "", login.c_str(), workerId.c_str(), timeFrom, timeTo, groupByInterval);
-  auto &db = !login.empty() ? WorkerStatsDb_ : PoolStatsDb_;
   std::unique_ptr<rocksdbBase::IteratorType> It(db.iterator());
 
   StatsRecord valueRecord;
@@ -551,6 +787,50 @@ void StatisticDb::getHistory(const std::string &login, const std::string &worker
     It->seekForPrev<StatsRecord>(keyRecord, resumeKey.data<const char>(), resumeKey.sizeOf(), valueRecord, validPredicate);
   }
 
+  while (It->valid()) {
+    if (valueRecord.Time <= timeFrom)
+      break;
+
+    if (isDebugStatistic())
+      LOG_F(1, "getHistory: use row with time=%" PRIi64 " shares=%" PRIu64 " work=%.3lf", valueRecord.Time, valueRecord.ShareCount, valueRecord.ShareWork);
+
+    int64_t alignedTimeLabel = valueRecord.Time + groupByInterval - (valueRecord.Time % groupByInterval);
+    size_t index = (alignedTimeLabel - firstTimeLabel) / groupByInterval;
+    if (index < stats.size()) {
+      CStatsElement &current = stats[index];
+      current.SharesNum += static_cast<uint32_t>(valueRecord.ShareCount);
+      current.SharesWork += valueRecord.ShareWork;
+      current.PrimePOWTarget = std::min(current.PrimePOWTarget, valueRecord.PrimePOWTarget);
+      if (current.PrimePOWSharesNum.size() < valueRecord.PrimePOWShareCount.size())
+        current.PrimePOWSharesNum.resize(valueRecord.PrimePOWShareCount.size() + 1);
+      for (size_t i = 0, ie = valueRecord.PrimePOWShareCount.size(); i != ie; ++i)
+        current.PrimePOWSharesNum[i] += valueRecord.PrimePOWShareCount[i];
+    }
+
+    It->prev<StatsRecord>(resumeKey.data<const char>(), resumeKey.sizeOf(), valueRecord, validPredicate);
+  }
+}
+
+void StatisticDb::getHistory(const std::string &login, const std::string &workerId, int64_t timeFrom, int64_t timeTo, int64_t groupByInterval, std::vector<CStats> &history)
+{
+  constexpr int64_t HistoryMaxPoints = 3200;
+  if (groupByInterval < 60)
+    return;
+
+  if (isDebugStatistic())
+    LOG_F(1, "getHistory for %s/%s from %" PRIi64 " to % " PRIi64 " group interval %" PRIi64 "", login.c_str(), workerId.c_str(), timeFrom, timeTo, groupByInterval);
+  auto &db = !login.empty() ? WorkerStatsDb_ : PoolStatsDb_;
+  auto &tiers = !login.empty() ? WorkerRollups_ : PoolRollups_;
+  int64_t updateTime = !login.empty() ? WorkersUpdateTime_ : PoolUpdateTime_;
+
+  // Long range requested: increase group interval to nearest rollup interval
+  if (timeTo > timeFrom && (timeTo - timeFrom) / groupByInterval + 2 > HistoryMaxPoints) {
+    int64_t minInterval = (timeTo - timeFrom + HistoryMaxPoints - 3) / (HistoryMaxPoints - 2);
+    auto tierIt = std::find_if(tiers.begin(), tiers.end(), [minInterval](const CRollupTier &tier) { return tier.Interval >= minInterval; });
+    int64_t interval = tierIt != tiers.end() ? tierIt->Interval : (!tiers.empty() ? tiers.back().Interval : groupByInterval);
+    groupByInterval = std::max(groupByInterval, interval * ((minInterval + interval - 1) / interval));
+  }
+
   // Fill 'stats' with zero-initialized elements for entire range
   int64_t firstTimeLabel = 0;
   std::vector<CStatsElement> stats;
@@ -559,7 +839,7 @@ void StatisticDb::getHistory(const std::string &login, const std::string &worker
     firstTimeLabel = (timeFrom+1) + groupByInterval - ((timeFrom+1) % groupByInterval);
     int64_t lastTimeLabel = timeTo + groupByInterval - (timeTo % groupByInterval);
     size_t count = (lastTimeLabel - firstTimeLabel) / groupByInterval + 1;
-    if (count > 3200) {
+    if (count > HistoryMaxPoints) {
       LOG_F(WARNING, "statisticDb: too much count %zu", count);
       return;
     }
@@ -573,27 +853,29 @@ void StatisticDb::getHistory(const std::string &login, const std::string &worker
     }
   }
 
-  while (It->valid()) {
-    if (valueRecord.Time <= timeFrom)
+  // Use coarsest rollup with complete and not expired data for requested range
+  int64_t currentTime = time(nullptr);
+  const CRollupTier *tier = nullptr;
+  for (auto It = tiers.rbegin(), ItE = tiers.rend(); It != ItE; ++It) {
+    int64_t startTime = It->StartTime;
+    if (groupByInterval % It->Interval == 0 &&
+        startTime != 0 &&
+        timeFrom >= startTime &&
+        (It->KeepTime == 0 || timeFrom >= currentTime - It->KeepTime)) {
+      tier = &*It;
       break;
-
-    if (isDebugStatistic())
-      LOG_F(1, "getHistory: use row with time=%" PRIi64 " shares=%" PRIu64 " work=%.3lf", valueRecord.Time, valueRecord.ShareCount, valueRecord.ShareWork);
-
-    int64_t alignedTimeLabel = valueRecord.Time + groupByInterval - (valueRecord.Time % groupByInterval);
-    size_t index = (alignedTimeLabel - firstTimeLabel) / groupByInterval;
-    if (index < stats.size()) {
-      CStatsElement &current = stats[index];
-      current.SharesNum += static_cast<uint32_t>(valueRecord.ShareCount);
-      current.SharesWork += valueRecord.ShareWork;
-      current.PrimePOWTarget = std::min(current.PrimePOWTarget, valueRecord.PrimePOWTarget);
-      if (current.PrimePOWSharesNum.size() < valueRecord.PrimePOWShareCount.size())
-        current.PrimePOWSharesNum.resize(valueRecord.PrimePOWShareCount.size() + 1);
-      for (size_t i = 0, ie = valueRecord.PrimePOWShareCount.size(); i != ie; ++i)
-        current.PrimePOWSharesNum[i] += valueRecord.PrimePOWShareCount[i];
     }
+  }
 
-    It->prev<StatsRecord>(resumeKey.data<const char>(), resumeKey.sizeOf(), valueRecord, validPredicate);
+  if (tier) {
+    // Closed windows from rollup, last one from raw records
+    // Rollup record time is a window begin, window containing timeFrom+1 included
+    int64_t rollupEnd = updateTime - updateTime % tier->Interval;
+    int64_t rollupFrom = (timeFrom + 1) - (timeFrom + 1) % tier->Interval - 1;
+    accumulateHistory(*tier->Db, login, workerId, rollupFrom, std::min(timeTo, rollupEnd - 1), groupByInterval, firstTimeLabel, stats);
+    accumulateHistory(db, login, workerId, std::max(timeFrom, rollupEnd - 1), timeTo, groupByInterval, firstTimeLabel, stats);
+  } else {
+    accumulateHistory(db, login, workerId, timeFrom, timeTo, groupByInterval, firstTimeLabel, stats);
   }
 
   history.resize(stats.size());
@@ -605,34 +887,6 @@ void StatisticDb::getHistory(const std::string &login, const std::string &worker
   }
 }
 
-void StatisticDb::exportRecentStats(std::vector<CStatsExportData> &result)
-{
-  result.clear();
-  int64_t timeLabel = time(0);
-  for (const auto &userIt: LastUserStats_) {
-    auto &userRecord = result.emplace_back();
-    userRecord.UserId = userIt.first;
-    // Current share work
-    {
-      auto &current = userRecord.Recent.emplace_back();
-      current.SharesWork = userIt.second.Current.SharesWork;
-      current.TimeLabel = timeLabel;
-    }
-
-    // Recent share work (up to N minutes)
-    int64_t lastAcceptTime = timeLabel - 30*60;
-    for (auto It = userIt.second.Recent.rbegin(), ItE = userIt.second.Recent.rend(); It != ItE; ++It) {
-      if (It->TimeLabel < lastAcceptTime)
-        break;
-      auto &recent = userRecord.Recent.emplace_back();
-      recent.SharesWork = It->SharesWork;
-      recent.TimeLabel = It->TimeLabel;
-    }
-  }
-
-  std::sort(result.begin(), result.end(), [](const CStatsExportData &l, const CStatsExportData &r) { return l.UserId < r.UserId; });
-}
-
 void StatisticDb::queryPoolStatsImpl(QueryPoolStatsCallback callback)
 {
   callback(getPoolStats());
@@ -653,67 +907,128 @@ void StatisticDb::queryAllUserStatsImpl(const std::vector<UserManager::Credentia
                                         CredentialsWithStatistic::EColumns sortBy,
                                         bool sortDescending)
 {
-  std::vector<CredentialsWithStatistic> usersWithStatistic(users.size());
-  for (size_t i = 0, ie = users.size(); i != ie; ++i) {
-    const UserManager::Credentials &src = users[i];
-    CredentialsWithStatistic &dst = usersWithStatistic[i];
-    // TODO: check for std::move
-    dst.Credentials = src;
-
-    auto userIt = LastUserStats_.find(dst.Credentials.Login);
-    if (userIt == LastUserStats_.end())
-      continue;
+  updateUserStatsIndex(false);
 
-    CStats userStats;
-    calcAverageMetrics(userIt->second, _cfg.StatisticWorkersPowerCalculateInterval, _cfg.StatisticWorkersAggregateTime, userStats);
-    dst.WorkersNum = userStats.WorkersNum;
-    dst.AveragePower = userStats.AveragePower;
-    dst.SharesPerSecond = userStats.SharesPerSecond;
-    dst.LastShareTime = userStats.LastShareTime;
+  const CUserStatsIndex &index = UserStatsIndex_;
+  std::vector<CredentialsWithStatistic> result;
+  if (offset >= users.size() || size == 0) {
+    callback(result);
+    return;
   }
 
+  size_t pageEnd = offset + std::min(size, users.size() - offset);
+  result.reserve(pageEnd - offset);
+  auto addUser = [&result, &index](const UserManager::Credentials &credentials) {
+    CredentialsWithStatistic &dst = result.emplace_back();
+    dst.Credentials = credentials;
+    auto It = index.Users.find(credentials.Login);
+    if (It != index.Users.end()) {
+      dst.WorkersNum = It->second.WorkersNum;
+      dst.AveragePower = It->second.AveragePower;
+      dst.SharesPerSecond = It->second.SharesPerSecond;
+      dst.LastShareTime = It->second.LastShareTime;
+    }
+  };
+
+  // Sort by credentials field, ties sorted by login
+  auto makeCredentialsPage = [&](auto less) {
+    std::vector<uint32_t> indexes(users.size());
+    for (uint32_t i = 0, ie = static_cast<uint32_t>(indexes.size()); i != ie; ++i)
+      indexes[i] = i;
+    auto compare = [&users, &less, sortDescending](uint32_t l, uint32_t r) {
+      return !sortDescending ? less(users[l], users[r]) : less(users[r], users[l]);
+    };
+
+    std::nth_element(indexes.begin(), indexes.begin() + offset, indexes.end(), compare);
+    std::partial_sort(indexes.begin() + offset, indexes.begin() + pageEnd, indexes.end(), compare);
+    for (auto It = indexes.begin() + offset, ItE = indexes.begin() + pageEnd; It != ItE; ++It)
+      addUser(users[*It]);
+  };
+
+  // Walk column order of index merged with requested users without statistic, they have zero values
+  auto makeStatisticPage = [&](const auto &order) {
+    using ValueType = typename std::decay_t<decltype(order)>::value_type::first_type;
+    std::unordered_map<std::string, uint32_t> requested;
+    std::vector<uint32_t> inactive;
+    for (uint32_t i = 0, ie = static_cast<uint32_t>(users.size()); i != ie; ++i) {
+      if (index.Users.count(users[i].Login))
+        requested.emplace(users[i].Login, i);
+      else
+        inactive.push_back(i);
+    }
+
+    size_t inactiveNum = std::min(pageEnd, inactive.size());
+    std::partial_sort(inactive.begin(), inactive.begin() + inactiveNum, inactive.end(), [&users, sortDescending](uint32_t l, uint32_t r) {
+      return !sortDescending ? users[l].Login < users[r].Login : users[r].Login < users[l].Login;
+    });
+
+    size_t position = 0;
+    size_t inactiveIdx = 0;
+    auto visit = [&](uint32_t userIdx) {
+      if (position++ >= offset)
+        addUser(users[userIdx]);
+    };
+
+    auto inactiveBefore = [sortDescending](const std::string &login, const std::pair<ValueType, std::string> &entry) {
+      ValueType zero = ValueType();
+      return !sortDescending ?
+        zero < entry.first || (zero == entry.first && login < entry.second) :
+        entry.first < zero || (zero == entry.first && entry.second < login);
+    };
+
+    auto walk = [&](auto begin, auto end) {
+      for (auto It = begin; It != end && position < pageEnd; ++It) {
+        auto requestedIt = requested.find(It->second);
+        if (requestedIt == requested.end())
+          continue;
+        while (inactiveIdx < inactiveNum && position < pageEnd && inactiveBefore(users[inactive[inactiveIdx]].Login, *It))
+          visit(inactive[inactiveIdx++]);
+        if (position < pageEnd)
+          visit(requestedIt->second);
+      }
+
+      while (inactiveIdx < inactiveNum && position < pageEnd)
+        visit(inactive[inactiveIdx++]);
+    };
+
+    if (!sortDescending)
+      walk(order.begin(), order.end());
+    else
+      walk(order.rbegin(), order.rend());
+  };
+
+  using Credentials = UserManager::Credentials;
   switch (sortBy) {
     case CredentialsWithStatistic::ELogin :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.Credentials.Login < r.Credentials.Login; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.Credentials.Login < r.Credentials.Login; });
+      makeCredentialsPage([](const Credentials &l, const Credentials &r) { return l.Login < r.Login; });
+      break;
+    case CredentialsWithStatistic::EName :
+      makeCredentialsPage([](const Credentials &l, const Credentials &r) { return std::tie(l.Name, l.Login) < std::tie(r.Name, r.Login); });
+      break;
+    case CredentialsWithStatistic::EEmail :
+      makeCredentialsPage([](const Credentials &l, const Credentials &r) { return std::tie(l.EMail, l.Login) < std::tie(r.EMail, r.Login); });
+      break;
+    case CredentialsWithStatistic::ERegistrationDate :
+      makeCredentialsPage([](const Credentials &l, const Credentials &r) { return std::tie(l.RegistrationDate, l.Login) < std::tie(r.RegistrationDate, r.Login); });
       break;
     case CredentialsWithStatistic::EWorkersNum :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.WorkersNum < r.WorkersNum; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.WorkersNum < r.WorkersNum; });
+      makeStatisticPage(index.WorkersNum);
       break;
     case CredentialsWithStatistic::EAveragePower :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.AveragePower < r.AveragePower; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.AveragePower < r.AveragePower; });
+      makeStatisticPage(index.AveragePower);
       break;
     case CredentialsWithStatistic::ESharesPerSecord :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.SharesPerSecond < r.SharesPerSecond; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.SharesPerSecond < r.SharesPerSecond; });
+      makeStatisticPage(index.SharesPerSecond);
       break;
     case CredentialsWithStatistic::ELastShareTime :
-      if (!sortDescending)
-        std::sort(usersWithStatistic.begin(), usersWithStatistic.end(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.LastShareTime < r.LastShareTime; });
-      else
-        std::sort(usersWithStatistic.rbegin(), usersWithStatistic.rend(), [](const CredentialsWithStatistic &l, const CredentialsWithStatistic &r) { return l.LastShareTime < r.LastShareTime; });
+      makeStatisticPage(index.LastShareTime);
       break;
     default:
+      for (size_t i = offset; i < pageEnd; i++)
+        addUser(users[i]);
       break;
   }
 
-  // Make page
-  std::vector<CredentialsWithStatistic> result;
-  if (offset < usersWithStatistic.size()) {
-    size_t endIdx = std::min(offset + size, usersWithStatistic.size());
-    result.insert(result.end(), std::make_move_iterator(usersWithStatistic.begin() + offset), std::make_move_iterator(usersWithStatistic.begin() + endIdx));
-  }
-
   callback(result);
 }
 
@@ -722,7 +1037,7 @@ StatisticServer::StatisticServer(asyncBase *base, const PoolBackendConfig &confi
 {
   Statistics_.reset(new StatisticDb(Base_, config, CoinInfo_));
   StatisticShareLogConfig shareLogConfig(Statistics_.get());
-  ShareLog_.init(config.dbPath / "shares.log.v1", config.dbPath / "shares.log", coinInfo.Name, Base_, config.ShareLogFlushInterval, config.ShareLogFileSizeLimit, shareLogConfig);
+  ShareLog_.init(config.dbPath / "shares.log.v1", config.dbPath / "shares.log", coinInfo.Name, Base_, config.ShareLogFlushInterval, config.ShareLogSyncInterval, config.ShareLogFileSizeLimit, config.ShareLogBacklogLimit, shareLogConfig);
 }
 
 void StatisticServer::start()
@@ -736,7 +1051,7 @@ void StatisticServer::stop()
   TaskHandler_.stop(CoinInfo_.Name.c_str(), "StatisticServer task handler");
   postQuitOperation(Base_);
   Thread_.join();
-  ShareLog_.flush();
+  ShareLog_.stop();
 }
 
 void StatisticServer::statisticServerMain()